@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/Demo.dir/example/Demo.cpp.o"
+  "CMakeFiles/Demo.dir/example/Demo.cpp.o.d"
+  "Demo"
+  "Demo.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/Demo.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
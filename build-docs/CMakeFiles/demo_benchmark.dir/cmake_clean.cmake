@@ -0,0 +1,8 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/demo_benchmark"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/demo_benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,8 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/demo_benchmark_matrix"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/demo_benchmark_matrix.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,8 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/docs_refresh"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/docs_refresh.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,8 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/scopetimer_header_coverage"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/scopetimer_header_coverage.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
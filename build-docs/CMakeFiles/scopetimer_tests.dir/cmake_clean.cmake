@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/scopetimer_tests.dir/src/ScopeTimerAllocHooks.cpp.o"
+  "CMakeFiles/scopetimer_tests.dir/src/ScopeTimerAllocHooks.cpp.o.d"
+  "CMakeFiles/scopetimer_tests.dir/test/ScopeTimerTest.cpp.o"
+  "CMakeFiles/scopetimer_tests.dir/test/ScopeTimerTest.cpp.o.d"
+  "scopetimer_tests"
+  "scopetimer_tests.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/scopetimer_tests.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
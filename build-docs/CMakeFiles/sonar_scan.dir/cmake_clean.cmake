@@ -0,0 +1,8 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sonar_scan"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/sonar_scan.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,52 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/build-docs
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(run_demo "/root/repo/build-docs/Demo")
+set_tests_properties(run_demo PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;132;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_demo_iterations "/root/repo/build-docs/Demo" "--iterations=1")
+set_tests_properties(run_demo_iterations PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;133;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_demo_iterations_zero_flag "/root/repo/build-docs/Demo" "--iterations=0")
+set_tests_properties(run_demo_iterations_zero_flag PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;134;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_demo_positional_iterations "/root/repo/build-docs/Demo" "2")
+set_tests_properties(run_demo_positional_iterations PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;135;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_demo_positional_zero "/root/repo/build-docs/Demo" "0")
+set_tests_properties(run_demo_positional_zero PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;136;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_demo_help "/root/repo/build-docs/Demo" "--help")
+set_tests_properties(run_demo_help PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;137;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_default "/root/repo/build-docs/Benchmark" "--iterations=1" "--scenario=hotpath-bench")
+set_tests_properties(run_benchmark_default PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;149;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_iterations_zero "/root/repo/build-docs/Benchmark" "--iterations=0" "--scenario=hotpath-bench")
+set_tests_properties(run_benchmark_iterations_zero PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;150;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_positional_zero "/root/repo/build-docs/Benchmark" "0")
+set_tests_properties(run_benchmark_positional_zero PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;151;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_help "/root/repo/build-docs/Benchmark" "--help")
+set_tests_properties(run_benchmark_help PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;152;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_invalid_scenario "/root/repo/build-docs/Benchmark" "--scenario=bogus")
+set_tests_properties(run_benchmark_invalid_scenario PROPERTIES  WILL_FAIL "TRUE" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;153;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_buffered_hotpath "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_buffered_hotpath PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=BUFFERED;SCOPE_TIMER_BENCH_TIMER=HOTPATH;SCOPE_TIMER_BENCH_THREADS=2" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;154;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_buffered_fast_alias "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_buffered_fast_alias PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=buffered;SCOPE_TIMER_BENCH_TIMER=fast;SCOPE_TIMER_BENCH_THREADS=0;SCOPE_TIMER_BENCH_SINK_BYTES=0" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;155;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_loop "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_loop PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=NULL;SCOPE_TIMER_BENCH_TIMER=LOOP" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;156;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_async "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_async PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=ASYNC" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;157;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_null "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_null PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=NULL;SCOPE_TIMER_BENCH_TIMER=HOTPATH" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;158;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_null_standard_alias "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_null_standard_alias PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=null" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;159;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_noop_alias "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_noop_alias PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=noop" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;160;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_record "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_record PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=RECORD;SCOPE_TIMER_BENCH_THREADS=2" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;161;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_flight "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_flight PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=FLIGHT;SCOPE_TIMER_BENCH_THREADS=2" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;162;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_async_invalid_env "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_async_invalid_env PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_SINK=async;SCOPE_TIMER_BENCH_THREADS=bogus;SCOPE_TIMER_BENCH_SINK_BYTES=bogus" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;163;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_benchmark_out_of_range_env "/root/repo/build-docs/Benchmark" "--iterations=1")
+set_tests_properties(run_benchmark_out_of_range_env PROPERTIES  ENVIRONMENT "SCOPE_TIMER_BENCH_THREADS=9999999999999999999999999999;SCOPE_TIMER_BENCH_SINK_BYTES=9999999999999999999999999999" WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;164;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(run_scopetimer_tests "/root/repo/build-docs/scopetimer_tests")
+set_tests_properties(run_scopetimer_tests PROPERTIES  WORKING_DIRECTORY "/root/repo/build-docs" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;231;add_test;/root/repo/CMakeLists.txt;0;")
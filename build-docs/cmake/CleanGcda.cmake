@@ -0,0 +1,11 @@
+
+file(GLOB_RECURSE gcda "/root/repo/build-docs/*.gcda")
+if(gcda)
+  message(STATUS "Removing stale .gcda files to avoid stamp mismatch")
+  file(REMOVE ${gcda})
+endif()
+file(GLOB_RECURSE gcov_json "/root/repo/build-docs/*.gcov.json.gz")
+if(gcov_json)
+  message(STATUS "Removing stale .gcov.json.gz files to avoid gcovr merge conflicts")
+  file(REMOVE ${gcov_json})
+endif()
@@ -48,11 +48,14 @@ enum class BenchSinkMode {
     Buffered,
     Async,
     Null,
+    Record,
+    Flight,
 };
 
 enum class BenchTimerMode {
     Default,
     HotPath,
+    Loop,
 };
 
 struct BenchmarkOptions {
@@ -83,6 +86,19 @@ static inline void ingestTelemetryRecordHotPath(
     workload::ingestTelemetryRecordBody(event, totals, salt);
 }
 
+static inline void ingestTelemetryBatchLoop(
+    const std::vector<TelemetryEvent>& batch,
+    TelemetryTotals& totals,
+    int round
+) {
+    SCOPE_TIMER_LOOP(loop, 64U, "hotPath:batch");
+    for (const auto& event : batch) {
+        SCOPE_TIMER_ITERATION(loop);
+        const std::uint64_t salt = static_cast<std::uint64_t>(round) + totals.checksum;
+        workload::ingestTelemetryRecordBody(event, totals, salt);
+    }
+}
+
 static int positiveEnvOrDefault(const char* envName, int defaultValue) {
     if (const char* env = std::getenv(envName)) {
         try {
@@ -121,6 +137,12 @@ static BenchSinkMode benchSinkMode() {
         if (value == "NULL" || value == "null" || value == "NOOP" || value == "noop") {
             return BenchSinkMode::Null;
         }
+        if (value == "RECORD" || value == "record") {
+            return BenchSinkMode::Record;
+        }
+        if (value == "FLIGHT" || value == "flight") {
+            return BenchSinkMode::Flight;
+        }
     }
     return BenchSinkMode::Default;
 }
@@ -131,6 +153,9 @@ static BenchTimerMode benchTimerMode() {
         if (value == "HOTPATH" || value == "hotpath" || value == "FAST" || value == "fast") {
             return BenchTimerMode::HotPath;
         }
+        if (value == "LOOP" || value == "loop") {
+            return BenchTimerMode::Loop;
+        }
     }
     return BenchTimerMode::Default;
 }
@@ -147,6 +172,13 @@ public:
         }
     };
 
+    class NullRecordSink final : public ::xyzzy::scopetimer::ScopeTimer::RecordSink {
+    public:
+        void record(const ::xyzzy::scopetimer::ScopeTimer::Record&) noexcept override {
+            // Intentionally drop records so record-sink runs measure capture cost without formatting.
+        }
+    };
+
     BenchSinkScope() {
         const std::size_t sinkBytes = positiveSizeEnvOrDefault("SCOPE_TIMER_BENCH_SINK_BYTES", 256U * 1024U);
         switch (benchSinkMode()) {
@@ -162,6 +194,14 @@ public:
                 ::xyzzy::scopetimer::ScopeTimer::setLogSink(nullSink_);
                 null_ = true;
                 break;
+            case BenchSinkMode::Record:
+                ::xyzzy::scopetimer::ScopeTimer::setRecordSink(nullRecordSink_);
+                record_ = true;
+                break;
+            case BenchSinkMode::Flight:
+                ::xyzzy::scopetimer::ScopeTimer::setRecordSink(flightRecorder_);
+                record_ = true;
+                break;
             case BenchSinkMode::Default:
                 break;
         }
@@ -177,6 +217,9 @@ public:
         if (null_) {
             ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
         }
+        if (record_) {
+            ::xyzzy::scopetimer::ScopeTimer::resetRecordSink();
+        }
     }
 
     BenchSinkScope(const BenchSinkScope&) = delete;
@@ -184,9 +227,12 @@ public:
 
 private:
     NullLogSink nullSink_{};
+    NullRecordSink nullRecordSink_{};
+    ::xyzzy::scopetimer::ScopeTimer::FlightRecorderSink flightRecorder_{};
     bool buffered_{false};
     bool async_{false};
     bool null_{false};
+    bool record_{false};
 };
 
 static void hotPathBenchmarkWorker(int rounds, BenchTimerMode timerMode) {
@@ -195,6 +241,11 @@ static void hotPathBenchmarkWorker(int rounds, BenchTimerMode timerMode) {
     TelemetryTotals totals{};
 
     for (int round = 0; round < rounds; ++round) {
+        if (timerMode == BenchTimerMode::Loop) {
+            ingestTelemetryBatchLoop(batch, totals, round);
+            totals.checksum ^= static_cast<std::uint64_t>(round) * 0x9e3779b97f4a7c15ULL;
+            continue;
+        }
         for (const auto& event : batch) {
             const std::uint64_t salt = static_cast<std::uint64_t>(round) + totals.checksum;
             if (timerMode == BenchTimerMode::HotPath) {
@@ -242,9 +293,9 @@ static BenchmarkOptions parseOptions(int argc, char** argv) {
             std::cout << "Usage: Benchmark [--iterations=N] [--scenario=hotpath-bench]\n"
                          "The dedicated benchmark executable drives a CPU-bound ScopeTimer\n"
                          "stress workload used by the benchmark scripts and CMake targets.\n"
-                         "Benchmark env knobs: SCOPE_TIMER_BENCH_SINK=BUFFERED|ASYNC|NULL,\n"
+                         "Benchmark env knobs: SCOPE_TIMER_BENCH_SINK=BUFFERED|ASYNC|NULL|RECORD|FLIGHT,\n"
                          "SCOPE_TIMER_BENCH_SINK_BYTES=<bytes>, SCOPE_TIMER_BENCH_THREADS=<n>,\n"
-                         "and SCOPE_TIMER_BENCH_TIMER=HOTPATH.\n";
+                         "and SCOPE_TIMER_BENCH_TIMER=HOTPATH|LOOP.\n";
             std::exit(0);
         } else if (arg.rfind("--iterations=", 0) == 0) {
             options.iterations = std::max(1, std::stoi(arg.substr(13)));
@@ -65,6 +65,32 @@
  * - SCOPE_TIMER_WALLTIME:
  *     Controls whether start/end wall-clock timestamps are included in each record.
  *     Set to "OFF", "FALSE", "NO", or "0" (case-insensitive) to log elapsed time only.
+ *
+ * - SCOPE_TIMER_WHERE:
+ *     "SHORT" reports the enclosing function as its qualified name only
+ *     (e.g. "ns::Class::method"), trimmed from the signature at compile time.
+ *     Unset or "FULL" keeps the full signature.
+ *
+ * - SCOPE_TIMER_LINE_FORMAT:
+ *     "COMPACT" writes standard records as tab-separated label, thread number,
+ *     file:line callsite, start epoch nanoseconds and elapsed nanoseconds, with
+ *     no field names. Unset or "STANDARD" keeps the format shown below.
+ *
+ * - SCOPE_TIMER_TIMESTAMP:
+ *     Selects how start/end are written: "LOCAL" (default, local time with
+ *     milliseconds), "UTC" or "UTC_MICROS" (ISO-8601 UTC with microseconds),
+ *     "UTC_NANOS" (ISO-8601 UTC with nanoseconds), or "EPOCH" (integer
+ *     nanoseconds since the Unix epoch). The UTC and epoch modes use integer
+ *     arithmetic only, with no libc time zone calls.
+ *
+ * - SCOPE_TIMER_CPU_TIME:
+ *     Adds thread CPU time (cpu=) and the remainder of elapsed (offcpu=) to each
+ *     standard record. Off by default because the thread CPU clock is a syscall.
+ *
+ * - SCOPE_TIMER_PERF_COUNTERS:
+ *     Linux only. Adds per-scope perf_event_open counter deltas (instructions,
+ *     cycles, cache and branch misses, context switches, page faults) to each
+ *     standard record. Falls back to the software events without a PMU.
  * 
  * Usage Example 1:
  * ---------------
@@ -96,9 +122,11 @@
 #include <algorithm>  // for std::transform
 #include <array>
 #include <cctype>     // for std::toupper
+#include <cerrno>
 #include <chrono>
 #include <charconv>
 #include <condition_variable>
+#include <csignal>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -109,6 +137,7 @@
 #include <fcntl.h>
 #include <functional>
 #include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <new>
@@ -118,11 +147,41 @@
 #include <sys/stat.h>
 #if defined(_WIN32)
 #include <io.h>
+#include <process.h>
 #else
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
 #include <sys/uio.h>
 #include <unistd.h>
 #endif
+// The coroutine helpers also use requires-expressions and std::remove_cvref_t,
+// so -fcoroutines under an older language mode is not enough. MSVC only
+// reports the real language level in _MSVC_LANG.
+#if defined(__cpp_impl_coroutine) && defined(__has_include) \
+    && (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define SCOPE_TIMER_HAS_COROUTINES 1
+#endif
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#define SCOPE_TIMER_HAS_PERF_EVENTS 1
+#endif
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define SCOPE_TIMER_HAS_TSC_CLOCK 1
+#endif
 #include <thread>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -137,6 +196,15 @@
 namespace xyzzy::scopetimer {
 
     class ScopeTimer_TestFriend; // Forward declaration
+    class AsyncScopeTimer;
+    class ScopeSpan;
+    class LapScopeTimer;
+    class LoopScopeTimer;
+    class CompactScopeTimer;
+    struct SteadyClockPolicy;
+    struct ScopeTimerSinkPolicy;
+    template <typename ClockPolicy = SteadyClockPolicy, typename SinkPolicy = ScopeTimerSinkPolicy>
+    class BasicScopeTimer;
 
 #ifndef NDEBUG // Debug build only
 
@@ -183,8 +251,21 @@ namespace xyzzy::scopetimer {
         struct CustomSinkWriteStorageTag {};
         struct CustomSinkFlushStorageTag {};
         struct CustomLogSinkStorageTag {};
+        struct CustomReservingSinkStorageTag {};
+        struct RecordSinkStorageTag {};
+        struct RecordSinkExclusiveStorageTag {};
+        struct WallClockAnchorTag {};
+        struct SinkPipelineStorageTag {};
+        struct SinkPipelineGenerationTag {};
+        struct RetiredSinkPipelinesTag {};
+        struct InstalledSinkPipelineTag {};
+        struct SinkPipelineReadersTag {};
         struct BufferedTestSinkWriteStorageTag {};
         struct AsyncSinkStateTag {};
+        struct LiveScopeRegistryMutexTag {};
+        struct LiveScopeRegistryTag {};
+        struct WatchdogStateTag {};
+        struct WatchdogRunningTag {};
         struct LocaltimeMutexTag {};
     } // namespace detail
 
@@ -334,6 +415,123 @@ namespace xyzzy::scopetimer {
         inline LabelData makeLabelData(std::string&& s) noexcept {
             return LabelArg{std::move(s)}.toLabelData();
         }
+
+        /// Bytes of inline label storage in each timer; SCOPE_TIMER_FMT arguments share it.
+        inline constexpr std::size_t InlineLabelCapacity = 128U;
+
+        /**
+         * @brief SCOPE_TIMER_FMT label: a printf format literal and its arguments captured by value.
+         *
+         * The timer packs the arguments into its inline label storage and only
+         * runs snprintf() when the record is delivered, so disabled, sampled-out
+         * or filtered timers never format. Pointer arguments (e.g. for %s) must
+         * stay valid until the scope ends.
+         */
+        template <typename... Args>
+        struct FormattedLabel {
+            static_assert(((std::is_arithmetic_v<Args> || std::is_pointer_v<Args>) && ...),
+                          "SCOPE_TIMER_FMT arguments must be arithmetic values or pointers");
+            static constexpr std::size_t PackedSize = (std::size_t{0} + ... + sizeof(Args));
+            static_assert(PackedSize <= InlineLabelCapacity, "SCOPE_TIMER_FMT arguments exceed the inline label storage");
+
+            const char* format;
+            std::tuple<Args...> args;
+
+            void pack(unsigned char* out) const noexcept {
+                std::apply([out](const Args&... values) noexcept {
+                    std::size_t offset = 0U;
+                    ((std::memcpy(out + offset, &values, sizeof(Args)), offset += sizeof(Args)), ...);
+                }, args);
+            }
+
+            /**
+             * @brief Unpacks arguments stored by pack() and formats them; @p packed may alias @p out.
+             */
+            static std::size_t formatPacked(const char* format, const unsigned char* packed, char* out, std::size_t outSz) noexcept {
+                std::tuple<Args...> values{};
+                unpack(values, packed, std::index_sequence_for<Args...>{});
+                const int n = std::apply([&](const Args&... v) noexcept {
+                    return std::snprintf(out, outSz, format, v...);
+                }, values);
+                return ScopeTimerDetail::finalize_snprintf_result(n, out, outSz);
+            }
+
+        private:
+            template <std::size_t... I>
+            static void unpack(std::tuple<Args...>& values, const unsigned char* packed, std::index_sequence<I...>) noexcept {
+                std::size_t offset = 0U;
+                ((std::memcpy(&std::get<I>(values), packed + offset, sizeof(Args)), offset += sizeof(Args)), ...);
+            }
+        };
+
+        template <std::size_t N, typename... Args>
+        inline FormattedLabel<std::decay_t<Args>...> makeFormattedLabel(const char (&format)[N], Args&&... args) noexcept {
+            return FormattedLabel<std::decay_t<Args>...>{format, {std::forward<Args>(args)...}};
+        }
+
+        /**
+         * @brief SCOPE_TIMER_FMT with no arguments: the format is a plain literal label.
+         */
+        template <std::size_t N>
+        inline LabelData makeFormattedLabel(const char (&format)[N]) noexcept {
+            return makeLabelData(format);
+        }
+
+        /**
+         * @brief Qualified function name from a SCOPE_FUNCTION signature, e.g. "ns::Class::method".
+         *
+         * Drops the return type, the parameter list with any trailing qualifiers
+         * and GCC's " [with T = ...]" suffix. Template parameter lists are kept,
+         * so the result is a view into @p signature. Lambdas report the
+         * enclosing function. The callsite macros evaluate this at compile time.
+         */
+        constexpr std::string_view shortFunctionName(std::string_view signature) noexcept {
+            std::string_view name = signature;
+            if (!name.empty() && name.back() == ']') {
+                if (const std::size_t with = name.rfind(" [with "); with != std::string_view::npos) {
+                    name = name.substr(0, with);
+                }
+            }
+
+            // The parameter list is the last parenthesised group outside template brackets.
+            int angle = 0;
+            int paren = 0;
+            for (std::size_t i = name.size(); i-- > 0;) {
+                const char c = name[i];
+                if (c == '>') {
+                    ++angle;
+                } else if (c == '<') {
+                    angle = angle > 0 ? angle - 1 : 0;
+                } else if (angle == 0 && c == ')') {
+                    ++paren;
+                } else if (angle == 0 && c == '(' && paren > 0 && --paren == 0) {
+                    name = name.substr(0, i);
+                    break;
+                }
+            }
+
+            // The name starts after the last space outside brackets, which skips the
+            // return type and specifiers; "operator bool" style names keep their space.
+            std::size_t start = 0U;
+            angle = 0;
+            paren = 0;
+            for (std::size_t i = 0U; i < name.size(); ++i) {
+                const char c = name[i];
+                if (c == '<') {
+                    ++angle;
+                } else if (c == '>') {
+                    angle = angle > 0 ? angle - 1 : 0;
+                } else if (c == '(') {
+                    ++paren;
+                } else if (c == ')') {
+                    paren = paren > 0 ? paren - 1 : 0;
+                } else if (c == ' ' && angle == 0 && paren == 0
+                           && !(i >= 8U && name.substr(i - 8U, 8U) == "operator")) {
+                    start = i + 1U;
+                }
+            }
+            return name.substr(start);
+        }
     } // namespace detail
 
     /**
@@ -348,6 +546,16 @@ namespace xyzzy::scopetimer {
     class ScopeTimer {
     public:
         struct HotPathTag {};
+        struct ResourceUsageTag {};
+        struct CompactTag {};
+
+        /**
+         * @brief One read-only chunk of a batched sink write.
+         */
+        struct SinkSlice {
+            const char* data{nullptr};
+            std::size_t size{0U};
+        };
 
         /**
          * @brief Interface for user-supplied log sinks.
@@ -355,1592 +563,5504 @@ namespace xyzzy::scopetimer {
          * Register an implementation with setLogSink() to redirect ScopeTimer
          * output away from the default logfile. The sink object must outlive the
          * registration and remain valid until resetLogSink() is called.
+         *
+         * The async worker and cross-thread buffer flushes hand over everything
+         * they have pending through a single writeBatch() call. Each slice holds
+         * whole lines; the default forwards every slice to write().
          */
         class LogSink {
         public:
             virtual ~LogSink() = default;
             virtual void write(const char* data, std::size_t len) noexcept = 0;
+            virtual void writeBatch(const SinkSlice* slices, std::size_t count) noexcept {
+                for (std::size_t i = 0U; i < count; ++i) {
+                    write(slices[i].data, slices[i].size);
+                }
+            }
             virtual void flush() noexcept {
                 // Default sinks may be purely streaming and need no flush hook.
             }
         };
 
         /**
-         * @brief Constructs a ScopeTimer instance and records the start time.
-         *
-         * @param where A std::string_view describing the scope or function being timed.
-         * @param labelData A helper struct conveying the label string and any owned storage.
+         * @brief Writable region handed out by a ReservingLogSink.
          */
-        inline explicit ScopeTimer(std::string_view where, detail::LabelData labelData = detail::LabelData{}) noexcept {
-            if(isDisabled()) {
-                disabled_ = true;
-                return;
-            }
-
-            where_ = where;
-            assignLabel(std::move(labelData));
-            threadNum_ = getThreadIdNumber();
-            startSteady_ = std::chrono::steady_clock::now();
-            if (includeWallTime()) {
-                startWall_ = std::chrono::system_clock::now();
-                startWallFormattedLen_ = static_cast<std::uint8_t>(formatTime(startWall_, startWallFormatted_, sizeof(startWallFormatted_)));
-            }
-        }
+        struct SinkSpan {
+            char* data{nullptr};
+            std::size_t size{0U};
+        };
 
         /**
-         * @brief Convenience overload that accepts a plain string_view label.
+         * @brief Optional zero-copy sink interface.
+         *
+         * Direct timers format each record straight into the span returned by
+         * reserve() and then call commit() with the number of bytes produced,
+         * skipping the per-thread line buffer and the copy inside write().
+         * reserve() and commit() are called under the same lock as write(),
+         * and ScopeTimer may use the byte after the committed length as
+         * scratch for a terminator. A span shorter than requested declines
+         * the slot, as an empty one does: the record is rendered into the
+         * line buffer and handed to write(). The default write() reserves
+         * exactly the line's length; when that is declined too the record is
+         * dropped and counted in dropped(), so sinks that can decline should
+         * override write() to keep it some other way. Every non-empty span is
+         * followed by exactly one commit(), with zero when nothing was written
+         * into it. Buffered and async modes still hand over finished batches;
+         * the default writeBatch() copies them with one reservation.
          */
-        inline explicit ScopeTimer(std::string_view where, std::string_view label) noexcept
-            : ScopeTimer(where, detail::LabelData{label}) {}
-
-        template <std::size_t N>
-        inline explicit ScopeTimer(std::string_view where, const char (&label)[N]) noexcept
-            : ScopeTimer(where, detail::LabelData{
-                std::string_view{label, N ? N - 1 : 0},
-                {},
-                detail::LabelStorageKind::Borrowed
-            }) {}
+        class ReservingLogSink : public LogSink {
+        public:
+            virtual SinkSpan reserve(std::size_t maxLen) noexcept = 0;
+            virtual void commit(std::size_t len) noexcept = 0;
 
-        inline explicit ScopeTimer(HotPathTag, detail::LabelData labelData = detail::LabelData{}) noexcept {
-            if (isDisabled()) {
-                disabled_ = true;
-                return;
+            void write(const char* data, std::size_t len) noexcept override {
+                if (len == 0U) {
+                    return;
+                }
+                const SinkSpan span = reserve(len);
+                if (span.data == nullptr || span.size < len) {
+                    if (span.data != nullptr && span.size != 0U) {
+                        commit(0U);
+                    }
+                    dropped_.fetch_add(1U, std::memory_order_relaxed);
+                    return;
+                }
+                std::memcpy(span.data, data, len);
+                commit(len);
             }
 
-            hotPathMode_ = true;
-            assignLabel(std::move(labelData));
-            startSteady_ = std::chrono::steady_clock::now();
-        }
+            // Reserves once for the whole batch; falls back to per-slice writes
+            // when the sink cannot hand out a region that large.
+            void writeBatch(const SinkSlice* slices, std::size_t count) noexcept override {
+                std::size_t total = 0U;
+                for (std::size_t i = 0U; i < count; ++i) {
+                    total += slices[i].size;
+                }
+                if (total == 0U) {
+                    return;
+                }
+                const SinkSpan span = reserve(total);
+                if (span.data == nullptr || span.size < total) {
+                    if (span.data != nullptr && span.size != 0U) {
+                        commit(0U);
+                    }
+                    LogSink::writeBatch(slices, count);
+                    return;
+                }
+                char* out = span.data;
+                for (std::size_t i = 0U; i < count; ++i) {
+                    if (slices[i].size != 0U) {
+                        std::memcpy(out, slices[i].data, slices[i].size);
+                        out += slices[i].size;
+                    }
+                }
+                commit(total);
+            }
 
-        inline explicit ScopeTimer(HotPathTag, std::string_view label) noexcept
-            : ScopeTimer(HotPathTag{}, detail::LabelData{label}) {}
+            /**
+             * @brief Writes the default write() dropped because reserve() declined them.
+             */
+            std::uint64_t dropped() const noexcept {
+                return dropped_.load(std::memory_order_relaxed);
+            }
 
-        template <std::size_t N>
-        inline explicit ScopeTimer(HotPathTag, const char (&label)[N]) noexcept
-            : ScopeTimer(HotPathTag{}, detail::LabelData{
-                std::string_view{label, N ? N - 1 : 0},
-                {},
-                detail::LabelStorageKind::Borrowed
-            }) {}
+        private:
+            std::atomic<std::uint64_t> dropped_{0U};
+        };
 
-        ScopeTimer(const ScopeTimer&) = delete; ///< Deleted copy constructor for safety.
-        ScopeTimer& operator=(const ScopeTimer&) = delete; ///< Deleted copy assignment operator.
+        /**
+         * @brief Static description of one timer macro expansion.
+         *
+         * The SCOPE_TIMER family emits one constant-initialized CallSite per
+         * expansion, so record sinks can key aggregates on its address
+         * instead of hashing function names.
+         */
+        struct CallSite {
+            std::string_view where; ///< Enclosing function signature.
+            const char* file{nullptr};
+            unsigned line{0U};
+            std::string_view shortWhere{}; ///< detail::shortFunctionName(where); used when SCOPE_TIMER_WHERE=SHORT.
+            /// Sink pipeline routing cache: generation in the high word, route mask in the low word.
+            mutable std::atomic<std::uint64_t> routeCache{0U};
+        };
 
         /**
-         * @brief Destructor that records the end time, computes elapsed duration,
-         * formats timing information, and writes a log entry.
+         * @brief Per-callsite sampling decision, made before the timer reads any clock.
          *
-         * Logs include thread ID, scope name, start and end timestamps, and elapsed time.
+         * oneIn(n) admits the first call and then every n-th. withProbability(p)
+         * admits each call independently. perSecond(rate, burst) is a token
+         * bucket that allows @p burst records at once and @p rate per second
+         * over time; it reads a coarse monotonic clock where available.
+         * Rejected calls are counted, and the next admitted record carries the
+         * count as suppressed=, so every record stands for 1 + suppressed calls.
+         * Thread-safe; keep one Sampler per callsite (the sampling macros make
+         * a function-local static). Function-local statics enlist themselves on
+         * their first rejection, so flushSuppressedSamples() can report a count
+         * that no later record took.
          */
-        inline ~ScopeTimer() noexcept {
-            if (disabled_) {
-                return;
+        class Sampler {
+        public:
+            static Sampler oneIn(std::uint32_t n) noexcept {
+                return Sampler(Kind::OneIn, n == 0U ? 1U : n, 0U, 0, 0);
             }
 
-            const auto endSteady = std::chrono::steady_clock::now();
-            const auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(endSteady - startSteady_).count();
+            static Sampler withProbability(double p) noexcept {
+                std::uint64_t threshold = 0U;
+                if (p >= 1.0) {
+                    threshold = std::numeric_limits<std::uint64_t>::max();
+                } else if (p > 0.0) {
+                    threshold = static_cast<std::uint64_t>(p * 18446744073709551616.0); // p * 2^64
+                }
+                return Sampler(Kind::Probability, 0U, threshold, 0, 0);
+            }
 
-            auto& fmtBufs = formatBuffers();
-            std::size_t len = 0;
+            static Sampler perSecond(double recordsPerSecond, std::uint32_t burst = 1U) noexcept {
+                if (!(recordsPerSecond > 0.0)) {
+                    return Sampler(Kind::Probability, 0U, 0U, 0, 0); // admits nothing
+                }
+                const auto intervalNs = static_cast<std::int64_t>(std::max(1.0, 1e9 / recordsPerSecond));
+                const std::int64_t toleranceNs = intervalNs * static_cast<std::int64_t>(burst == 0U ? 0U : burst - 1U);
+                return Sampler(Kind::RateLimit, 0U, 0U, intervalNs, toleranceNs);
+            }
 
-            // Final line buffer reused per thread to avoid repeated stack allocation.
-            auto& lineBuf = lineBuffer();
-            if (hotPathMode_) {
-                fmtBufs.elapsedLen = static_cast<std::uint8_t>(formatElapsedNanos(elapsedNs, fmtBufs.elapsedBuf, sizeof(fmtBufs.elapsedBuf)));
-                len = buildHotPathLogLine(
-                    lineBuf.data,
-                    sizeof(lineBuf.data),
-                    label_,
-                    fmtBufs.elapsedBuf,
-                    fmtBufs.elapsedLen
-                );
-            } else {
-                const bool wallTimeEnabled = includeWallTime();
-                if (wallTimeEnabled) {
-                    const auto endWall = std::chrono::system_clock::now();
-                    fmtBufs.endLen = static_cast<std::uint8_t>(formatTime(endWall, fmtBufs.endBuf, sizeof(fmtBufs.endBuf)));
-                } else {
-                    fmtBufs.endLen = 0;
+            Sampler(const Sampler&) = delete;
+            Sampler& operator=(const Sampler&) = delete;
+
+            /**
+             * @brief Decides one call; a rejected call adds one to the suppressed count.
+             */
+            bool admit() noexcept {
+                bool admitted = false;
+                switch (kind_) {
+                case Kind::OneIn:
+                    admitted = seen_.fetch_add(1U, std::memory_order_relaxed) % every_ == 0U;
+                    break;
+                case Kind::Probability:
+                    admitted = threshold_ == std::numeric_limits<std::uint64_t>::max() || nextRandom() < threshold_;
+                    break;
+                case Kind::RateLimit:
+                    admitted = takeToken();
+                    break;
                 }
-                fmtBufs.elapsedLen = static_cast<std::uint8_t>(formatElapsed(elapsedNs, fmtBufs.elapsedBuf, sizeof(fmtBufs.elapsedBuf)));
+                if (!admitted) {
+                    suppressed_.fetch_add(1U, std::memory_order_relaxed);
+                }
+                return admitted;
+            }
 
-                len = buildLogLine(lineBuf.data, sizeof(lineBuf.data), LogLineFields{
-                    label_,
-                    threadNum_,
-                    where_,
-                    std::string_view{startWallFormatted_, startWallFormattedLen_},
-                    std::string_view{fmtBufs.endBuf, fmtBufs.endLen},
-                    std::string_view{fmtBufs.elapsedBuf, fmtBufs.elapsedLen},
-                    wallTimeEnabled
-                });
+            /**
+             * @brief Calls rejected since the last admitted record took the count.
+             */
+            std::uint64_t suppressed() const noexcept {
+                return suppressed_.load(std::memory_order_relaxed);
             }
 
-            // These sink-state atomics are intentionally acquire/release or relaxed
-            // instead of seq_cst. They publish configuration chosen under
-            // sinkConfigMutex(), and stronger global ordering would add fences on the
-            // steady-state timer path without improving correctness. Sonar's blanket
-            // seq_cst rule is suppressed for this header in sonar-project.properties.
-            const auto activeSink = activeSinkStorage().load(std::memory_order_acquire);
-            if (len) {
-                if (activeSink != ActiveSink::ThreadBuffered) {
-                    std::lock_guard lock(outMutex());
-                    writeToActiveSink(activeSink, lineBuf.data, len);
-                } else {
-                    writeToActiveSink(activeSink, lineBuf.data, len);
+            std::uint64_t takeSuppressed() noexcept {
+                return suppressed_.exchange(0U, std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief admit() that also enlists the sampler, with @p site, on its first rejection.
+             *
+             * Only for samplers with static storage duration: the enlisted list is
+             * walked at exit.
+             */
+            bool admitEnlisting(const CallSite& site) noexcept {
+                const bool admitted = admit();
+                if (!admitted && !enlisted_.load(std::memory_order_relaxed)) {
+                    enlist(site);
                 }
+                return admitted;
             }
 
-            // Thread-buffered sink flushes on size; avoid periodic counters and
-            // interval checks to keep the buffered hot path cheap.
-            if (activeSink != ActiveSink::ThreadBuffered) {
-                const unsigned cnt = lineCounter().fetch_add(1, std::memory_order_relaxed) + 1U;
-                if (cnt % flushInterval() == 0) { // configurable via SCOPE_TIMER_FLUSH_N
-                    flushActiveSink(activeSink);
+        private:
+            friend class ScopeTimer;
+
+            enum class Kind : std::uint8_t { OneIn, Probability, RateLimit };
+
+            Sampler(Kind kind, std::uint32_t every, std::uint64_t threshold, std::int64_t intervalNs,
+                    std::int64_t toleranceNs) noexcept
+                : kind_(kind), every_(every), threshold_(threshold), intervalNs_(intervalNs), toleranceNs_(toleranceNs) {}
+
+            /**
+             * @brief Pushes this sampler onto the lock-free enlisted list once.
+             */
+            void enlist(const CallSite& site) noexcept {
+                if (enlisted_.exchange(true, std::memory_order_relaxed)) {
+                    return;
                 }
+                site_ = &site;
+                Sampler* head = enlistedHead_.load(std::memory_order_relaxed);
+                do {
+                    nextEnlisted_ = head;
+                } while (!enlistedHead_.compare_exchange_weak(head, this, std::memory_order_release,
+                                                              std::memory_order_relaxed));
+                registerLogFdCleanup(); // the atexit drain reports the tail
             }
-        }
 
-        static inline void enableThreadBufferedSink(std::size_t flushBytes = 16U * 1024U) noexcept {
-            if (flushBytes == 0) {
-                flushBytes = 16U * 1024U;
+            /**
+             * @brief GCRA form of the token bucket: one atomic "next conforming time".
+             */
+            bool takeToken() noexcept {
+                const std::int64_t now = coarseNowNs();
+                std::int64_t tat = nextFreeNs_.load(std::memory_order_relaxed);
+                for (;;) {
+                    const std::int64_t base = std::max(tat, now);
+                    if (base - now > toleranceNs_) {
+                        return false;
+                    }
+                    if (nextFreeNs_.compare_exchange_weak(tat, base + intervalNs_, std::memory_order_relaxed)) {
+                        return true;
+                    }
+                }
             }
-            std::lock_guard sinkStateLock(sinkConfigMutex());
-            flushAllThreadBuffers();
-            asyncSinkFlush();
-            shutdownAsyncSink();
-            closeLogFd();
-            threadBufferFlushBytesStorage().store(flushBytes);
-            activeSinkStorage().store(ActiveSink::ThreadBuffered, std::memory_order_release);
-            bufferedSinkTargetModeStorage().store(hasCustomSink() ? BufferedSinkTargetMode::Custom
-                                                                  : BufferedSinkTargetMode::Default,
-                                                  std::memory_order_release);
-        }
 
-        static inline void disableThreadBufferedSink() noexcept {
-            std::lock_guard sinkStateLock(sinkConfigMutex());
-            flushAllThreadBuffers();
-            asyncSinkFlush();
-            shutdownAsyncSink();
-            closeLogFd();
-            restoreDefaultSinkState();
-        }
+            static std::int64_t coarseNowNs() noexcept {
+#if !defined(_WIN32) && defined(CLOCK_MONOTONIC_COARSE)
+                timespec ts{};
+                if (::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0) {
+                    return (static_cast<std::int64_t>(ts.tv_sec) * 1000000000LL) + ts.tv_nsec;
+                }
+#endif
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
 
-        static inline void enableAsyncSink(std::size_t flushBytes = 16U * 1024U) noexcept {
-            if (flushBytes == 0) {
-                flushBytes = 16U * 1024U;
+            /**
+             * @brief xorshift64* on a per-thread state, seeded from the state's own address.
+             */
+            static std::uint64_t nextRandom() noexcept {
+                static thread_local std::uint64_t state = 0U;
+                if (state == 0U) {
+                    std::uint64_t seed = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(&state)) + 0x9e3779b97f4a7c15ULL;
+                    seed = (seed ^ (seed >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+                    seed = (seed ^ (seed >> 27U)) * 0x94d049bb133111ebULL;
+                    state = (seed ^ (seed >> 31U)) | 1U;
+                }
+                state ^= state >> 12U;
+                state ^= state << 25U;
+                state ^= state >> 27U;
+                return state * 0x2545f4914f6cdd1dULL;
             }
-            std::lock_guard sinkStateLock(sinkConfigMutex());
-            flushAllThreadBuffers();
-            asyncSinkFlush();
-            shutdownAsyncSink();
-            closeLogFd();
-            threadBufferFlushBytesStorage().store(flushBytes);
-            activeSinkStorage().store(ActiveSink::ThreadBuffered, std::memory_order_release);
-            bufferedSinkTargetModeStorage().store(BufferedSinkTargetMode::Async, std::memory_order_release);
-            asyncSinkTargetModeStorage().store(hasCustomSink() ? AsyncSinkTargetMode::Custom
-                                                               : AsyncSinkTargetMode::Default,
-                                               std::memory_order_release);
-            ensureAsyncSinkRunning();
-        }
 
-        static inline void disableAsyncSink() noexcept {
-            disableThreadBufferedSink();
-        }
+            const Kind kind_;
+            const std::uint32_t every_;
+            const std::uint64_t threshold_;
+            const std::int64_t intervalNs_;
+            const std::int64_t toleranceNs_;
+            std::atomic<std::uint64_t> seen_{0U};
+            std::atomic<std::uint64_t> suppressed_{0U};
+            std::atomic<std::int64_t> nextFreeNs_{std::numeric_limits<std::int64_t>::min() / 2};
+            std::atomic<bool> enlisted_{false};
+            const CallSite* site_{nullptr};      ///< Set once, before the sampler is published.
+            Sampler* nextEnlisted_{nullptr};
+            static inline std::atomic<Sampler*> enlistedHead_{nullptr};
+        };
 
-        static inline void setLogSink(LogSink& sink) {
-            setCustomLogSink(&sink);
-        }
+        /**
+         * @brief Per-scope perf_event counter deltas (SCOPE_TIMER_PERF_COUNTERS).
+         *
+         * The hardware fields stay zero when hardware is false, i.e. when the
+         * thread could only open the software fallback events. When the kernel
+         * multiplexed the group, timeRunningNs is below timeEnabledNs and the
+         * counts are scaled up by timeEnabledNs / timeRunningNs.
+         */
+        struct PerfCounts {
+            std::uint64_t instructions{0U};
+            std::uint64_t cycles{0U};
+            std::uint64_t cacheMisses{0U};
+            std::uint64_t branchMisses{0U};
+            std::uint64_t contextSwitches{0U};
+            std::uint64_t pageFaults{0U};
+            std::uint64_t timeEnabledNs{0U}; ///< Time the group was enabled.
+            std::uint64_t timeRunningNs{0U}; ///< Time the group was actually on the PMU.
+            bool hardware{false};
+
+            PerfCounts& operator+=(const PerfCounts& other) noexcept {
+                instructions += other.instructions;
+                cycles += other.cycles;
+                cacheMisses += other.cacheMisses;
+                branchMisses += other.branchMisses;
+                contextSwitches += other.contextSwitches;
+                pageFaults += other.pageFaults;
+                timeEnabledNs += other.timeEnabledNs;
+                timeRunningNs += other.timeRunningNs;
+                hardware = hardware || other.hardware;
+                return *this;
+            }
+        };
 
-        static inline void resetLogSink() {
-            setCustomLogSink(nullptr);
-        }
+        /**
+         * @brief Per-scope getrusage(RUSAGE_THREAD) deltas (SCOPE_TIMER_RUSAGE callsites).
+         */
+        struct ResourceUsage {
+            std::int64_t minorFaults{0};
+            std::int64_t majorFaults{0};
+            std::int64_t voluntarySwitches{0};   ///< Blocked: I/O, locks, sleeps.
+            std::int64_t involuntarySwitches{0}; ///< Preempted by the scheduler.
+
+            ResourceUsage& operator+=(const ResourceUsage& other) noexcept {
+                minorFaults += other.minorFaults;
+                majorFaults += other.majorFaults;
+                voluntarySwitches += other.voluntarySwitches;
+                involuntarySwitches += other.involuntarySwitches;
+                return *this;
+            }
+        };
 
-    private:
-        friend class xyzzy::scopetimer::ScopeTimer_TestFriend; // Allow unit tests to access private members
-        
         /**
-         * @brief Checks if the ScopeTimer is disabled based on the SCOPE_TIMER environment variable.
-         *
-         * Reads the environment variable once and caches the result for subsequent calls.
-         * Returns true if the value is "OFF", "FALSE", "NO", or "0" (case-insensitive).
+         * @brief Heap allocations made by the timing thread inside a scope.
          *
-         * @return true if disabled, false otherwise.
+         * Only counted when src/ScopeTimerAllocHooks.cpp is linked in; nested
+         * scopes include the allocations of their children, like elapsed time.
          */
-        static inline bool isDisabled() noexcept {
-            static const bool disabled = []() {
-                const char* env = std::getenv("SCOPE_TIMER");
-
-                if(!env) {
-                    return false;
-                }
+        struct AllocationCounts {
+            std::uint64_t count{0U};
+            std::uint64_t bytes{0U};
+
+            AllocationCounts& operator+=(const AllocationCounts& other) noexcept {
+                count += other.count;
+                bytes += other.bytes;
+                return *this;
+            }
+        };
 
-                const std::string val = normalizeBooleanSetting(env);
+        /**
+         * @brief One checkpoint of a LapScopeTimer: time since the previous lap (or the start).
+         */
+        struct LapSplit {
+            std::string_view name; ///< Points at a string literal passed to SCOPE_TIMER_LAP.
+            std::int64_t ns{0};
+        };
 
-                return val == "OFF" || val == "FALSE" || val == "NO" || val == "0";
-            }();
+        /**
+         * @brief Fixed inline lap storage owned by a LapScopeTimer.
+         */
+        struct LapSplits {
+            static constexpr std::size_t Capacity = 8U;
+            std::array<LapSplit, Capacity> splits{};
+            std::uint32_t count{0U};
+            std::uint32_t dropped{0U}; ///< Laps past Capacity; counted only.
+        };
 
-            return disabled;
-        }
+        /**
+         * @brief Summary of a LoopScopeTimer: iteration count plus sampled iteration times.
+         *
+         * The duration fields are zero unless sampled is non-zero. min and max
+         * cover every timed iteration; the percentiles come from the samples
+         * still held when the loop ended.
+         */
+        struct LoopStats {
+            std::uint64_t iterations{0U};
+            std::uint64_t sampled{0U}; ///< Iterations that were timed.
+            std::int64_t meanNs{0}; ///< Scope time divided by iterations.
+            std::int64_t minNs{0};
+            std::int64_t p50Ns{0};
+            std::int64_t p90Ns{0};
+            std::int64_t p99Ns{0};
+            std::int64_t maxNs{0};
+        };
 
-        static inline std::string normalizeBooleanSetting(const char* env) {
-            std::string value(env ? env : "");
-            const auto isSpace = [](char c) {
-                return std::isspace(static_cast<unsigned char>(c)) != 0;
-            };
-            const auto first = std::find_if_not(value.begin(), value.end(), isSpace);
-            const auto last = std::find_if_not(value.rbegin(), value.rend(), isSpace).base();
-            if (first >= last) {
-                return {};
-            }
+        /**
+         * @brief What a BasicScopeTimer hands its sink policy: no timestamps, no counters.
+         */
+        struct ElapsedSample {
+            const CallSite* site{nullptr};
+            std::string_view label;
+            std::int64_t elapsedNs{0};
+        };
 
-            std::string normalized(first, last);
-            std::transform(normalized.begin(), normalized.end(), normalized.begin(),
-                           [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
-            return normalized;
-        }
+        /**
+         * @brief Structured form of one timing record.
+         *
+         * Steady timestamps are nanoseconds since the steady_clock epoch. Wall
+         * timestamps are nanoseconds since the Unix epoch and are only present
+         * when hasWallTime is true (SCOPE_TIMER_WALLTIME enabled, non hot-path).
+         * cpuNs is only present when hasCpuTime is true (SCOPE_TIMER_CPU_TIME),
+         * perf only when hasPerfCounts is true (SCOPE_TIMER_PERF_COUNTERS), and
+         * rusage only when hasResourceUsage is true (SCOPE_TIMER_RUSAGE callsites),
+         * allocations only when hasAllocations is true (allocation hooks linked),
+         * and suspendedNs/migrations only when hasSuspendedTime is true
+         * (AsyncScopeTimer; elapsed minus suspendedNs is the active time).
+         * correlationId is zero unless a ScopeSpan was given one. suppressed
+         * counts the calls a sampling macro skipped at this callsite since the
+         * previous record it admitted. laps is null
+         * unless the timer is a LapScopeTimer that took at least one lap, and
+         * loop is null unless the timer is a LoopScopeTimer.
+         * Views borrow the timer's storage and are only valid during record().
+         */
+        struct Record {
+            const CallSite* site{nullptr}; ///< Null for timers constructed without a macro.
+            std::string_view where;
+            std::string_view label;
+            std::uint32_t threadNum{0U};
+            std::int64_t startSteadyNs{0};
+            std::int64_t endSteadyNs{0};
+            std::int64_t startWallNs{0};
+            std::int64_t endWallNs{0};
+            std::int64_t cpuNs{0}; ///< Thread CPU time spent in the scope; valid when hasCpuTime.
+            PerfCounts perf{}; ///< Counter deltas; valid when hasPerfCounts.
+            ResourceUsage rusage{}; ///< Fault and context-switch deltas; valid when hasResourceUsage.
+            AllocationCounts allocations{}; ///< Heap allocations in the scope; valid when hasAllocations.
+            std::int64_t suspendedNs{0}; ///< Time spent suspended; valid when hasSuspendedTime.
+            std::uint32_t migrations{0U}; ///< Resumes on a different thread than the suspend.
+            std::uint64_t correlationId{0U}; ///< Request id set on a ScopeSpan; zero when none.
+            std::uint64_t suppressed{0U}; ///< Calls skipped by sampling since the previous admitted record.
+            const LapSplits* laps{nullptr}; ///< SCOPE_TIMER_LAP checkpoints, in the order taken.
+            const LoopStats* loop{nullptr}; ///< SCOPE_TIMER_LOOP iteration summary.
+            bool hasWallTime{false};
+            bool hasCpuTime{false};
+            bool hasPerfCounts{false};
+            bool hasResourceUsage{false};
+            bool hasAllocations{false};
+            bool hasSuspendedTime{false};
+            bool hotPath{false};
+            bool stillRunning{false}; ///< Watchdog report for a scope past its deadline.
+        };
 
-        static inline bool isTruthySetting(const char* envName, bool defaultValue) noexcept {
-            if (const char* env = std::getenv(envName); env && *env) {
-                const std::string value = normalizeBooleanSetting(env);
-                if (value.empty()) {
-                    return defaultValue;
-                }
-                if (value == "OFF" || value == "FALSE" || value == "NO" || value == "0") {
-                    return false;
-                }
-                return true;
+        /**
+         * @brief Interface for sinks that consume records as structs instead of text.
+         *
+         * record() runs on the timing thread without taking ScopeTimer's output
+         * lock, so implementations called from several threads must synchronize
+         * themselves. flush() runs when the sink is replaced or reset. The sink
+         * object must outlive the registration.
+         */
+        class RecordSink {
+        public:
+            virtual ~RecordSink() = default;
+            virtual void record(const Record& rec) noexcept = 0;
+            virtual void flush() noexcept {
+                // Default record sinks hold no buffered state.
             }
-            return defaultValue;
-        }
+        };
 
-        static inline bool includeWallTime() noexcept {
-            static const bool enabled = isTruthySetting("SCOPE_TIMER_WALLTIME", true);
-            return enabled;
-        }
+        /**
+         * @brief Whether text output continues while a RecordSink is registered.
+         */
+        enum class RecordSinkMode {
+            Exclusive,     ///< Only the record sink runs; text formatting is skipped.
+            AlongsideText, ///< Records are delivered and the text line is still written.
+        };
+
+        static constexpr std::size_t MaxSinkRoutes = 32U;
 
         /**
-         * @brief Retrieves a unique thread ID number in a lock-free manner.
-         *
-         * Uses thread_local storage to cache the thread ID, and an atomic counter
-         * to assign unique IDs starting from 1.
+         * @brief One destination in a sink pipeline plus the filters guarding it.
          *
-         * @return uint32_t The unique thread ID number.
+         * A record reaches the route when the callsite filter accepts its
+         * CallSite, its elapsed time is at least minElapsed, and it is the Nth
+         * such record for sampleEvery = N. The callsite filter runs once per
+         * macro expansion per pipeline and must not throw.
          */
-        static inline uint32_t getThreadIdNumber() noexcept {
-            thread_local uint32_t tid = 0;
+        struct SinkRoute {
+            enum class Target {
+                DefaultFile, ///< Text line written through the active sink, ScopeTimer.log unless one is set.
+                Log,         ///< Text line handed to a LogSink.
+                Record,      ///< Structured record handed to a RecordSink.
+            };
 
-            if(tid == 0) {
-                static std::atomic<uint32_t> next{ 1 };
-                // Only uniqueness matters here; callers do not depend on any cross-thread
-                // ordering relationship with the assigned numeric IDs.
-                tid = next.fetch_add(1, std::memory_order_relaxed);
-            }
+            Target target{Target::DefaultFile};
+            LogSink* logSink{nullptr};
+            RecordSink* recordSink{nullptr};
+            std::chrono::nanoseconds minElapsed{0};
+            std::uint32_t sampleEvery{1U};
+            std::function<bool(const CallSite&)> callSiteFilter;
 
-            return tid;
-        }
+            static SinkRoute toDefaultFile() {
+                return SinkRoute{};
+            }
+            static SinkRoute toLogSink(LogSink& sink) {
+                SinkRoute route;
+                route.target = Target::Log;
+                route.logSink = &sink;
+                return route;
+            }
+            static SinkRoute toRecordSink(RecordSink& sink) {
+                SinkRoute route;
+                route.target = Target::Record;
+                route.recordSink = &sink;
+                return route;
+            }
+            SinkRoute withMinElapsed(std::chrono::nanoseconds threshold) const {
+                SinkRoute route = *this;
+                route.minElapsed = threshold;
+                return route;
+            }
+            SinkRoute withSampleEvery(std::uint32_t n) const {
+                SinkRoute route = *this;
+                route.sampleEvery = n == 0U ? 1U : n;
+                return route;
+            }
+            SinkRoute withCallSiteFilter(std::function<bool(const CallSite&)> filter) const {
+                SinkRoute route = *this;
+                route.callSiteFilter = std::move(filter);
+                return route;
+            }
+        };
 
         /**
-         * @brief Returns the periodic flush interval for the ScopeTimer log.
-         *
-         * Controlled by the environment variable `SCOPE_TIMER_FLUSH_N`.
-         * If unset, non-numeric, or <= 0, defaults to 4096. Parsed once and cached.
-         *
-         * @return unsigned The number of lines between flushes.
+         * @brief Built-in RecordSink keeping count/total/min/max per callsite and label.
          */
-        static inline unsigned flushInterval() noexcept {
-            static const auto interval = []() noexcept {
-                if (const auto* p = std::getenv("SCOPE_TIMER_FLUSH_N")) {
-                    auto* end = static_cast<char*>(nullptr);
-                    const auto v = std::strtoul(p, &end, 10);
+        class StatsRecordSink final : public RecordSink {
+        public:
+            struct Entry {
+                const CallSite* site{nullptr};
+                std::string where;
+                std::string label;
+                std::uint64_t count{0U};
+                std::int64_t totalNs{0};
+                std::int64_t minNs{0};
+                std::int64_t maxNs{0};
+                std::uint64_t cpuCount{0U}; ///< Records that carried CPU time.
+                std::int64_t cpuTotalNs{0}; ///< Off-CPU time is the elapsed total of those records minus this.
+                std::int64_t cpuElapsedTotalNs{0};
+                std::uint64_t perfCount{0U}; ///< Records that carried perf counters.
+                PerfCounts perfTotal{};
+                std::uint64_t rusageCount{0U}; ///< Records that carried resource usage.
+                ResourceUsage rusageTotal{};
+                std::uint64_t allocRecordCount{0U}; ///< Records that carried allocation counts.
+                AllocationCounts allocTotal{};
+                std::uint64_t suspendableCount{0U}; ///< AsyncScopeTimer records.
+                std::int64_t suspendedTotalNs{0};
+                std::uint64_t suppressedTotal{0U}; ///< Calls skipped by sampling; count + this = calls.
+            };
 
-                    if (end != p && *end == '\0' && v > 0UL && v <= 1000000UL) {
-                        return static_cast<unsigned>(v);
+            void record(const Record& rec) noexcept override {
+                const std::int64_t elapsedNs = rec.endSteadyNs - rec.startSteadyNs;
+                std::lock_guard lock(mutex_);
+                auto it = entries_.find(KeyView{rec.site, rec.where, rec.label});
+                if (it == entries_.end()) {
+                    Totals fresh{};
+                    fresh.minNs = elapsedNs;
+                    fresh.maxNs = elapsedNs;
+                    it = entries_.emplace(Key{rec.site, std::string(rec.where), std::string(rec.label)}, fresh).first;
+                }
+                auto& totals = it->second;
+                ++totals.count;
+                totals.totalNs += elapsedNs;
+                totals.minNs = std::min(totals.minNs, elapsedNs);
+                totals.maxNs = std::max(totals.maxNs, elapsedNs);
+                if (rec.hasCpuTime) {
+                    ++totals.cpuCount;
+                    totals.cpuTotalNs += rec.cpuNs;
+                    totals.cpuElapsedTotalNs += elapsedNs;
+                }
+                if (rec.hasPerfCounts) {
+                    ++totals.perfCount;
+                    totals.perfTotal += rec.perf;
+                }
+                if (rec.hasResourceUsage) {
+                    ++totals.rusageCount;
+                    totals.rusageTotal += rec.rusage;
+                }
+                if (rec.hasAllocations) {
+                    ++totals.allocRecordCount;
+                    totals.allocTotal += rec.allocations;
+                }
+                if (rec.hasSuspendedTime) {
+                    ++totals.suspendableCount;
+                    totals.suspendedTotalNs += rec.suspendedNs;
+                }
+                totals.suppressedTotal += rec.suppressed;
+            }
+
+            std::vector<Entry> snapshot() const {
+                std::vector<Entry> out;
+                std::lock_guard lock(mutex_);
+                out.reserve(entries_.size());
+                for (const auto& [key, totals] : entries_) {
+                    out.push_back(Entry{key.site, key.where, key.label, totals.count, totals.totalNs, totals.minNs, totals.maxNs,
+                                        totals.cpuCount, totals.cpuTotalNs, totals.cpuElapsedTotalNs,
+                                        totals.perfCount, totals.perfTotal, totals.rusageCount, totals.rusageTotal,
+                                        totals.allocRecordCount, totals.allocTotal,
+                                        totals.suspendableCount, totals.suspendedTotalNs, totals.suppressedTotal});
+                }
+                return out;
+            }
+
+            void clear() {
+                std::lock_guard lock(mutex_);
+                entries_.clear();
+            }
+
+        private:
+            struct Key {
+                const CallSite* site;
+                std::string where;
+                std::string label;
+            };
+            struct KeyView {
+                const CallSite* site;
+                std::string_view where;
+                std::string_view label;
+            };
+            struct KeyLess {
+                using is_transparent = void;
+                template <typename A, typename B>
+                bool operator()(const A& a, const B& b) const noexcept {
+                    if (a.site != b.site) {
+                        return std::less<const CallSite*>{}(a.site, b.site);
+                    }
+                    if (const int cmp = std::string_view{a.where}.compare(b.where); cmp != 0) {
+                        return cmp < 0;
                     }
+                    return std::string_view{a.label} < std::string_view{b.label};
                 }
-                return 4096U; // default
-            }();
-            return interval;
-        }
+            };
+            struct Totals {
+                std::uint64_t count{0U};
+                std::int64_t totalNs{0};
+                std::int64_t minNs{0};
+                std::int64_t maxNs{0};
+                std::uint64_t cpuCount{0U};
+                std::int64_t cpuTotalNs{0};
+                std::int64_t cpuElapsedTotalNs{0};
+                std::uint64_t perfCount{0U};
+                PerfCounts perfTotal{};
+                std::uint64_t rusageCount{0U};
+                ResourceUsage rusageTotal{};
+                std::uint64_t allocRecordCount{0U};
+                AllocationCounts allocTotal{};
+                std::uint64_t suspendableCount{0U};
+                std::int64_t suspendedTotalNs{0};
+                std::uint64_t suppressedTotal{0U};
+            };
+
+            mutable std::mutex mutex_;
+            std::map<Key, Totals, KeyLess> entries_;
+        };
 
         /**
-         * @brief Resolves the log directory from environment overrides.
+         * @brief Built-in RecordSink that keeps recent records in memory only.
          *
-         * Controlled solely by SCOPE_TIMER_DIR; defaults to /tmp when unset/empty.
+         * Records are copied into fixed-size rings (one per thread, or one
+         * shared ring) that overwrite their oldest entry; nothing is formatted
+         * or written until a dump. dump() writes the records that ended within
+         * the configured window, oldest first, in the normal text line format.
+         * A dump also runs after a record whose elapsed time reaches the
+         * trigger latency (at most once per window) and after the signal
+         * armed with dumpOnSignal(). Automatic dumps go to
+         * `ScopeTimer.flight.<pid>.<n>.log` in the log directory. They run on
+         * a dumper thread the recorder starts when either trigger is set, so
+         * the timed thread never formats or writes, and an idle or hung
+         * process still dumps on the signal. Labels and ad-hoc scope names
+         * longer than the slot text are truncated.
          */
-        static inline const std::string& logDirectory() {
-            if (!logDirInitialized_) {
-                resetLogDirectoryForTests();
-                logDirInitialized_ = true;
-            }
-            return logDirCache_;
-        }
+        class FlightRecorderSink final : public RecordSink {
+        public:
+            enum class Layout {
+                PerThread, ///< One single-writer ring per recording thread.
+                Shared,    ///< One ring written by every thread.
+            };
 
-        static inline void resetLogDirectoryForTests(std::string_view newDir = {}) {
-            std::string normalized;
-            if (!newDir.empty()) {
-                normalized.assign(newDir.begin(), newDir.end());
-            } else {
-                if (const char* primary = std::getenv("SCOPE_TIMER_DIR"); primary && *primary) {
-                    normalized = primary;
+            explicit FlightRecorderSink(
+                std::size_t slots = 1024U,
+                Layout layout = Layout::PerThread,
+                std::chrono::nanoseconds window = std::chrono::seconds(10)
+            )
+                : capacity_(roundUpToPowerOfTwo(slots)),
+                  layout_(layout),
+                  windowNs_(window.count()) {
+                if (layout_ == Layout::Shared) {
+                    rings_.push_back(std::make_unique<Ring>(capacity_, 0U));
                 }
             }
-            if (normalized.empty()) {
-                normalized = "/tmp";
-            }
-            if (!normalized.empty() && normalized.back() != '/') {
-                normalized.push_back('/');
+
+            ~FlightRecorderSink() override {
+                if (signalTarget_.load(std::memory_order_acquire) == this) {
+#if !defined(_WIN32)
+                    ::sigaction(signalNumber_, &previousAction_, nullptr);
+#endif
+                    signalTarget_.store(nullptr, std::memory_order_release);
+                }
+                stopDumper();
             }
-            logDirCache_ = std::move(normalized);
-            logDirInitialized_ = true;
-        }
 
-        // One-time-selected elapsed-time formatter infrastructure
-        // I call through a cached function pointer to avoid branching in the hot path.
-        enum class TimeFormat { Auto, Seconds, Millis, Micros, Nanos };
-        using FormatterFn = std::size_t(*)(long long ns, char* out, size_t outSz) noexcept;
+            FlightRecorderSink(const FlightRecorderSink&) = delete;
+            FlightRecorderSink& operator=(const FlightRecorderSink&) = delete;
 
-        static inline bool fillLocalTime(std::tm& tm, const std::time_t& tt) noexcept {
-#if defined(_WIN32) && defined(_MSC_VER)
-            return ::localtime_s(&tm, &tt) == 0;
-#elif defined(_WIN32)
-            std::lock_guard lock(localtimeMutex());
-            if (std::tm* local = std::localtime(&tt)) {
-                tm = *local;
-                return true;
+            /**
+             * @brief Dumps automatically after a record at least this slow; zero disables.
+             */
+            void setTriggerLatency(std::chrono::nanoseconds threshold) noexcept {
+                triggerNs_.store(threshold.count(), std::memory_order_relaxed);
+                if (threshold.count() > 0) {
+                    startDumper();
+                }
             }
-            return false;
-#else
-            return ::localtime_r(&tt, &tm) != nullptr;
-#endif
-        }
 
-        static inline bool appendFixedDigits(char*& out, const char* end, unsigned value, unsigned width) noexcept {
-            constexpr unsigned MaxFixedDigitWidth = 10U;
-            if (width > MaxFixedDigitWidth || static_cast<std::size_t>(end - out) < width) {
+            /**
+             * @brief Dumps from the dumper thread when @p signo arrives.
+             *
+             * The handler only sets a flag, which the dumper checks every
+             * SignalPollInterval, and then calls the handler it replaced
+             * (a default or ignored disposition is not chained). The
+             * destructor restores that handler. One recorder is armed at a
+             * time; returns false when the handler cannot be installed or on
+             * Windows.
+             */
+            bool dumpOnSignal(int signo) noexcept {
+#if defined(_WIN32)
+                (void)signo;
                 return false;
+#else
+                bool wasArmed = false;
+                {
+                    std::lock_guard lock(dumperMutex_);
+                    wasArmed = signalArmed_;
+                    signalArmed_ = true;
+                }
+                startDumper();
+                struct sigaction action {};
+                action.sa_sigaction = &FlightRecorderSink::signalHandler;
+                sigemptyset(&action.sa_mask);
+                action.sa_flags = SA_RESTART | SA_SIGINFO;
+                struct sigaction previous {};
+                // Published first so a signal right after sigaction() finds it; undone on failure.
+                FlightRecorderSink* previousTarget = signalTarget_.exchange(this, std::memory_order_acq_rel);
+                if (::sigaction(signo, &action, &previous) != 0) {
+                    signalTarget_.store(previousTarget, std::memory_order_release);
+                    std::lock_guard lock(dumperMutex_);
+                    signalArmed_ = wasArmed;
+                    return false;
+                }
+                // Re-arming keeps the handler that was there before any recorder.
+                if ((previous.sa_flags & SA_SIGINFO) == 0 || previous.sa_sigaction != &FlightRecorderSink::signalHandler) {
+                    previousAction_ = previous;
+                }
+                signalNumber_ = signo;
+                return true;
+#endif
             }
 
-            if (width == 2U) {
-                out[0] = static_cast<char>('0' + ((value / 10U) % 10U));
-                out[1] = static_cast<char>('0' + (value % 10U));
-                out += 2U;
-                return true;
+            void record(const Record& rec) noexcept override {
+                Ring& ring = ringForCurrentThread(rec.threadNum);
+                const std::uint64_t idx = layout_ == Layout::Shared
+                    ? ring.head.fetch_add(1U, std::memory_order_relaxed)
+                    : ring.head.load(std::memory_order_relaxed);
+                if (layout_ == Layout::PerThread) {
+                    ring.head.store(idx + 1U, std::memory_order_relaxed);
+                }
+                Slot& slot = ring.slots[idx & (capacity_ - 1U)];
+                // Odd sequence marks the slot as being written. In the shared
+                // ring a writer that laps a slot still in use drops its record.
+                if ((slot.seq.exchange(2U * idx + 1U, std::memory_order_acquire) & 1U) == 0U) {
+                    fillEntry(slot.entry, rec);
+                    slot.seq.store(2U * idx + 2U, std::memory_order_release);
+                }
+
+                const std::int64_t triggerNs = triggerNs_.load(std::memory_order_relaxed);
+                if (triggerNs > 0 && rec.endSteadyNs - rec.startSteadyNs >= triggerNs
+                    && rec.endSteadyNs - lastTriggerNs_.load(std::memory_order_relaxed) >= windowNs_) {
+                    lastTriggerNs_.store(rec.endSteadyNs, std::memory_order_relaxed);
+                    {
+                        std::lock_guard lock(dumperMutex_);
+                        triggerPending_ = true;
+                    }
+                    dumperWake_.notify_one();
+                }
             }
 
-            if (width == 4U) {
-                out[0] = static_cast<char>('0' + ((value / 1000U) % 10U));
-                out[1] = static_cast<char>('0' + ((value / 100U) % 10U));
-                out[2] = static_cast<char>('0' + ((value / 10U) % 10U));
-                out[3] = static_cast<char>('0' + (value % 10U));
-                out += 4U;
-                return true;
+            /**
+             * @brief Writes the window to a new `ScopeTimer.flight.<pid>.<n>.log`.
+             * @return Number of records written; zero when the window could not be rendered.
+             */
+            std::size_t dump() noexcept {
+                std::string text;
+                std::size_t count = 0U;
+                try {
+                    count = renderWindow(text);
+                } catch (...) {
+                    return 0U;
+                }
+                char name[64];
+                const int n = std::snprintf(name, sizeof(name), "ScopeTimer.flight.%ld.%03u.log",
+                                            ScopeTimer::currentProcessId(),
+                                            dumpCount_.fetch_add(1U, std::memory_order_relaxed) + 1U);
+                if (n <= 0 || static_cast<std::size_t>(n) >= sizeof(name)) {
+                    return 0U;
+                }
+                const int fd = ScopeTimer::openLogFileForAppend(ScopeTimer::logDirectory() + name);
+                if (fd < 0) {
+                    return 0U;
+                }
+                ScopeTimer::writeFdBestEffort(fd, text.data(), text.size());
+                ScopeTimer::closeFd(fd);
+                return count;
             }
 
-            for (unsigned i = width; i > 0U; --i) {
-                out[i - 1U] = static_cast<char>('0' + (value % 10U));
-                value /= 10U;
+            /**
+             * @brief Writes the window to @p sink and flushes it.
+             * @return Number of records written.
+             */
+            std::size_t dump(LogSink& sink) noexcept {
+                std::string text;
+                std::size_t count = 0U;
+                try {
+                    count = renderWindow(text);
+                } catch (...) {
+                    return 0U;
+                }
+                if (!text.empty()) {
+                    sink.write(text.data(), text.size());
+                }
+                sink.flush();
+                return count;
             }
-            out += width;
-            return true;
-        }
 
-        /**
-         * @brief Elapsed time formatters selected once for speed.
-         *
-         * Each formatter accepts elapsed nanoseconds and writes a formatted
-         * string into the provided buffer. The active formatter is chosen once
-         * from the SCOPE_TIMER_FORMAT environment variable and cached via a
-         * function pointer to avoid branching in the hot path.
-         */
-        static inline std::size_t fmtSeconds(long long ns, char* out, size_t outSz) noexcept {
-            const long long sec   = ns / 1000000000LL;
-            const auto remMs = static_cast<unsigned>((ns / 1000000LL) % 1000LL); // 3 decimals
-            return formatElapsedImpl(static_cast<unsigned long long>(sec), remMs, 's', out, outSz);
-        }
+            /// How long a signal-requested dump may wait for the dumper to notice it.
+            static constexpr std::chrono::milliseconds SignalPollInterval{50};
 
-        static inline std::size_t fmtMillis(long long ns, char* out, size_t outSz) noexcept {
-            const long long ms    = ns / 1000000LL;
-            const auto remUs = static_cast<unsigned>((ns / 1000LL) % 1000LL);   // 3 decimals for ms
-            return formatElapsedImpl(static_cast<unsigned long long>(ms), remUs, 'm', out, outSz); // suffix handled inside
-        }
+        private:
+            static constexpr std::size_t SlotTextSize = 192U;
+
+            struct Entry {
+                const CallSite* site{nullptr};
+                std::int64_t startSteadyNs{0};
+                std::int64_t endSteadyNs{0};
+                std::int64_t startWallNs{0};
+                std::int64_t endWallNs{0};
+                std::int64_t cpuNs{0};
+                PerfCounts perf{};
+                ResourceUsage rusage{};
+                AllocationCounts allocations{};
+                std::int64_t suspendedNs{0};
+                std::uint32_t migrations{0U};
+                std::uint64_t correlationId{0U};
+                std::uint64_t suppressed{0U};
+                std::uint32_t threadNum{0U};
+                std::uint16_t labelLen{0U};
+                std::uint16_t whereLen{0U}; ///< Only set when site is null.
+                bool hasWallTime{false};
+                bool hasCpuTime{false};
+                bool hasPerfCounts{false};
+                bool hasResourceUsage{false};
+                bool hasAllocations{false};
+                bool hasSuspendedTime{false};
+                bool hotPath{false};
+                char text[SlotTextSize]; ///< Label, then the ad-hoc scope name.
+            };
 
-        static inline std::size_t fmtMicros(long long ns, char* out, size_t outSz) noexcept {
-            const long long us    = ns / 1000LL;
-            const auto remNs = static_cast<unsigned>(ns % 1000LL); // nanoseconds remainder
-            return formatElapsedImpl(static_cast<unsigned long long>(us), remNs, 'u', out, outSz); // suffix handled inside
-        }
+            struct Slot {
+                std::atomic<std::uint64_t> seq{0U};
+                Entry entry;
+            };
 
-        static inline std::size_t fmtNanos(long long ns, char* out, size_t outSz) noexcept {
-            char* cur = out;
-            const char* end = out + outSz;
-            if (auto* next = appendUnsignedToBuffer(cur, end, static_cast<unsigned long long>(ns)); next) {
-                cur = next;
-                (void)appendStrToBuffer(cur, end, "ns", 2);
+            struct Ring {
+                Ring(std::size_t capacity, std::uint32_t owner)
+                    : slots(std::make_unique<Slot[]>(capacity)), threadNum(owner) {}
+                std::unique_ptr<Slot[]> slots;
+                std::atomic<std::uint64_t> head{0U};
+                std::uint32_t threadNum;
+            };
+
+            static std::size_t roundUpToPowerOfTwo(std::size_t n) noexcept {
+                std::size_t capacity = 1U;
+                while (capacity < n) {
+                    capacity <<= 1U;
+                }
+                return capacity;
             }
-            if (cur < end) {
-                *cur = '\0';
-            } else if (outSz) {
-                out[outSz - 1] = '\0';
-            }
-            return static_cast<std::size_t>(cur - out);
-        }
 
-        /**
-         * @brief Automatic elapsed time formatter.
-         *
-         * Selects the most appropriate unit: seconds (>=1s), milliseconds (>=1ms), microseconds (>=1us), or nanoseconds (<1us).
-         * For explicit microseconds, use SCOPE_TIMER_FORMAT=MICROS.
-         */
-        static inline std::size_t fmtAuto(long long ns, char* out, size_t outSz) noexcept {
-            if (ns >= 1000000000LL) {
-                return fmtSeconds(ns, out, outSz);
-            }
-            if (ns >= 1000000LL) {
-                return fmtMillis(ns, out, outSz);
-            }
-            if (ns >= 1000LL) {
-                return fmtMicros(ns, out, outSz);
+            static void fillEntry(Entry& entry, const Record& rec) noexcept {
+                entry.site = rec.site;
+                entry.startSteadyNs = rec.startSteadyNs;
+                entry.endSteadyNs = rec.endSteadyNs;
+                entry.startWallNs = rec.startWallNs;
+                entry.endWallNs = rec.endWallNs;
+                entry.threadNum = rec.threadNum;
+                entry.cpuNs = rec.cpuNs;
+                entry.perf = rec.perf;
+                entry.rusage = rec.rusage;
+                entry.allocations = rec.allocations;
+                entry.suspendedNs = rec.suspendedNs;
+                entry.migrations = rec.migrations;
+                entry.correlationId = rec.correlationId;
+                entry.suppressed = rec.suppressed;
+                entry.hasWallTime = rec.hasWallTime;
+                entry.hasCpuTime = rec.hasCpuTime;
+                entry.hasPerfCounts = rec.hasPerfCounts;
+                entry.hasResourceUsage = rec.hasResourceUsage;
+                entry.hasAllocations = rec.hasAllocations;
+                entry.hasSuspendedTime = rec.hasSuspendedTime;
+                entry.hotPath = rec.hotPath;
+                const std::size_t labelLen = std::min(rec.label.size(), SlotTextSize);
+                std::memcpy(entry.text, rec.label.data(), labelLen);
+                entry.labelLen = static_cast<std::uint16_t>(labelLen);
+                std::size_t whereLen = 0U;
+                if (rec.site == nullptr) {
+                    whereLen = std::min(rec.where.size(), SlotTextSize - labelLen);
+                    std::memcpy(entry.text + labelLen, rec.where.data(), whereLen);
+                }
+                entry.whereLen = static_cast<std::uint16_t>(whereLen);
             }
-            return fmtNanos(ns, out, outSz);
-        }
-
-        /**
-         * @brief One-time initialization of the elapsed-time formatter.
-         *
-         * Reads SCOPE_TIMER_FORMAT (case-insensitive). If it matches
-         * SECONDS/MILLIS/MICROS/NANOS, picks the corresponding formatter; otherwise
-         * defaults to the auto formatter.
-         */
-        static inline FormatterFn initFormatter() noexcept {
-            if (const char* env = std::getenv("SCOPE_TIMER_FORMAT"); env && *env) {
-                std::string s(env);
-                std::transform(s.begin(), s.end(), s.begin(),
-                            [](unsigned char c){ return static_cast<char>(std::toupper(c)); });
 
-                if (s == "SECONDS") return &fmtSeconds;
-                if (s == "MILLIS")  return &fmtMillis;
-                if (s == "MICROS")  return &fmtMicros;
-                if (s == "NANOS")   return &fmtNanos;
+            Ring& ringForCurrentThread(std::uint32_t threadNum) noexcept {
+                if (layout_ == Layout::Shared) {
+                    return *rings_.front();
+                }
+                // One cached ring per thread; a thread alternating between
+                // recorders falls back to the locked lookup.
+                struct Cached {
+                    std::uint64_t owner{0U};
+                    Ring* ring{nullptr};
+                };
+                thread_local Cached cached;
+                if (cached.owner == id_) {
+                    return *cached.ring;
+                }
+                std::lock_guard lock(ringsMutex_);
+                Ring* ring = nullptr;
+                for (const auto& candidate : rings_) {
+                    if (candidate->threadNum == threadNum) {
+                        ring = candidate.get();
+                        break;
+                    }
+                }
+                if (ring == nullptr) {
+                    rings_.push_back(std::make_unique<Ring>(capacity_, threadNum));
+                    ring = rings_.back().get();
+                }
+                cached = Cached{id_, ring};
+                return *ring;
             }
-            return &fmtAuto;
-        }        
 
-        /**
-         * @brief Accessor for the cached formatter function pointer.
-         *
-         * This ensures I pay the environment parsing cost once; no per-call branching
-         * occurs on the hot path - I just call through the function pointer.
-         */
-        static inline FormatterFn& getFormatter() noexcept {
-            static FormatterFn fn = initFormatter();
-            return fn;
-        }
+            std::size_t renderWindow(std::string& text) {
+                std::vector<Entry> entries;
+                const std::int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                {
+                    std::lock_guard lock(ringsMutex_);
+                    for (const auto& ring : rings_) {
+                        collect(*ring, nowNs, entries);
+                    }
+                }
+                std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+                    return a.endSteadyNs < b.endSteadyNs;
+                });
 
-        // Small helpers for fast formatting (avoid snprintf).
-        static inline char* appendUnsignedToBuffer(char* out, const char* end, unsigned long long v) noexcept {
-            std::array<char, 32> tmp{};
-            int pos = 0;
-            do {
-                tmp[static_cast<std::size_t>(pos)] = static_cast<char>('0' + (v % 10ULL));
-                ++pos;
-                v /= 10ULL;
-            } while (v && pos < static_cast<int>(tmp.size()));
-            if (static_cast<std::size_t>(end - out) < static_cast<std::size_t>(pos)) {
-                return nullptr;
-            }
-            while (pos--) {
-                *out++ = tmp[static_cast<std::size_t>(pos)];
+                text.reserve(entries.size() * 160U);
+                for (const auto& entry : entries) {
+                    appendLine(text, entry);
+                }
+                return entries.size();
             }
-            return out;
-        }
 
-        static inline char* appendThreeDigitsToBuffer(char* out, const char* end, unsigned v) noexcept {
-            const std::array<char, 3> digits{
-                static_cast<char>('0' + ((v / 100U) % 10U)),
-                static_cast<char>('0' + ((v / 10U) % 10U)),
-                static_cast<char>('0' + (v % 10U))
-            };
-            if (static_cast<std::size_t>(end - out) < digits.size()) {
-                return nullptr;
+            void collect(const Ring& ring, std::int64_t nowNs, std::vector<Entry>& entries) const {
+                for (std::size_t i = 0U; i < capacity_; ++i) {
+                    const Slot& slot = ring.slots[i];
+                    const std::uint64_t before = slot.seq.load(std::memory_order_acquire);
+                    if (before == 0U || (before & 1U) != 0U) {
+                        continue;
+                    }
+                    Entry copy = slot.entry;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (slot.seq.load(std::memory_order_relaxed) != before) {
+                        continue;
+                    }
+                    if (windowNs_ > 0 && nowNs - copy.endSteadyNs > windowNs_) {
+                        continue;
+                    }
+                    entries.push_back(copy);
+                }
             }
-            std::memcpy(out, digits.data(), digits.size());
-            return out + digits.size();
-        }
 
-        static inline bool appendCharToBuffer(char*& out, const char* end, char c) noexcept {
-            if (out >= end) return false;
-            *out++ = c;
-            return true;
-        }
-
-        static inline bool appendStrToBuffer(char*& out, const char* end, const char* s, std::size_t n) noexcept {
-            if (static_cast<std::size_t>(end - out) < n) return false;
-            std::memcpy(out, s, n);
-            out += n;
-            return true;
-        }
-
-        static inline std::size_t formatElapsedImpl(unsigned long long whole, unsigned frac3, char unit, char* out, size_t outSz) noexcept {
-            char* cur = out;
-            const char* end = out + outSz;
+            static void appendLine(std::string& text, const Entry& entry) {
+                const std::string_view label{entry.text, entry.labelLen};
+                const long long elapsedNs = entry.endSteadyNs - entry.startSteadyNs;
+                char elapsed[32];
+                char line[sizeof(LineBuffer::data)];
+                std::size_t len = 0U;
+                if (entry.hotPath) {
+                    const std::size_t elapsedLen = ScopeTimer::formatElapsedNanos(elapsedNs, elapsed, sizeof(elapsed));
+                    len = ScopeTimer::buildHotPathLogLine(line, sizeof(line), label, elapsed, elapsedLen);
+                } else {
+                    char start[32];
+                    char end[32];
+                    std::size_t startLen = 0U;
+                    std::size_t endLen = 0U;
+                    if (entry.hasWallTime) {
+                        startLen = ScopeTimer::formatTime(wallTimePoint(entry.startWallNs), start, sizeof(start));
+                        endLen = ScopeTimer::formatTime(wallTimePoint(entry.endWallNs), end, sizeof(end));
+                    }
+                    const std::size_t elapsedLen = ScopeTimer::formatElapsed(elapsedNs, elapsed, sizeof(elapsed));
+                    LogLineFields fields{};
+                    fields.label = label;
+                    fields.threadNum = entry.threadNum;
+                    fields.where = entry.site != nullptr ? entry.site->where
+                                                         : std::string_view{entry.text + entry.labelLen, entry.whereLen};
+                    fields.startWall = std::string_view{start, startLen};
+                    fields.endWall = std::string_view{end, endLen};
+                    fields.elapsed = std::string_view{elapsed, elapsedLen};
+                    fields.wallTimeEnabled = entry.hasWallTime;
+                    fields.perf = entry.hasPerfCounts ? &entry.perf : nullptr;
+                    fields.rusage = entry.hasResourceUsage ? &entry.rusage : nullptr;
+                    fields.allocations = entry.hasAllocations ? &entry.allocations : nullptr;
+                    fields.correlationId = entry.correlationId;
+                    fields.suppressed = entry.suppressed;
+                    char cpu[32];
+                    char offCpu[32];
+                    if (entry.hasCpuTime) {
+                        fields.cpu = std::string_view{cpu, ScopeTimer::formatElapsed(entry.cpuNs, cpu, sizeof(cpu))};
+                        fields.offCpu = std::string_view{offCpu, ScopeTimer::formatElapsed(
+                            std::max<long long>(0, elapsedNs - entry.cpuNs), offCpu, sizeof(offCpu))};
+                    }
+                    char active[32];
+                    char suspended[32];
+                    if (entry.hasSuspendedTime) {
+                        fields.active = std::string_view{active, ScopeTimer::formatElapsed(
+                            std::max<long long>(0, elapsedNs - entry.suspendedNs), active, sizeof(active))};
+                        fields.suspended = std::string_view{suspended, ScopeTimer::formatElapsed(entry.suspendedNs, suspended, sizeof(suspended))};
+                        fields.migrations = entry.migrations;
+                    }
+                    len = ScopeTimer::buildLogLine(line, sizeof(line), fields);
+                }
+                text.append(line, len);
+            }
 
-            if (auto* next = appendUnsignedToBuffer(cur, end, whole)) {
-                cur = next;
-            } else {
-                if (outSz) out[0] = '\0';
-                return 0;
+            static std::chrono::system_clock::time_point wallTimePoint(std::int64_t ns) noexcept {
+                return std::chrono::system_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
             }
 
-            if (!appendCharToBuffer(cur, end, '.')) {
-                if (outSz) {
-                    out[0] = '\0';
+            void startDumper() noexcept {
+                std::lock_guard lock(dumperMutex_);
+                if (!dumper_.joinable()) {
+                    dumper_ = std::thread([this] { runDumper(); });
                 }
-                return 0;
             }
 
-            if (auto* next = appendThreeDigitsToBuffer(cur, end, frac3)) {
-                cur = next;
-            } else {
-                if (outSz) out[0] = '\0';
-                return 0;
+            void stopDumper() noexcept {
+                {
+                    std::lock_guard lock(dumperMutex_);
+                    stopDumper_ = true;
+                }
+                dumperWake_.notify_one();
+                if (dumper_.joinable()) {
+                    dumper_.join();
+                }
             }
 
-            const char suffix1 = unit;
-            const char suffix2 = (unit == 's') ? '\0' : 's'; // "s" for seconds, "ms"/"us"
-            if (!appendCharToBuffer(cur, end, suffix1)) {
-                if (outSz) {
-                    out[0] = '\0';
+            /**
+             * @brief Dumper thread: serves latency triggers at once and signal requests within SignalPollInterval.
+             */
+            void runDumper() noexcept {
+                std::unique_lock lock(dumperMutex_);
+                const auto woken = [this] {
+                    return stopDumper_ || triggerPending_ || dumpRequested_.load(std::memory_order_relaxed);
+                };
+                for (;;) {
+                    if (signalArmed_) {
+                        dumperWake_.wait_for(lock, SignalPollInterval, woken);
+                    } else {
+                        dumperWake_.wait(lock, woken);
+                    }
+                    const bool requested = dumpRequested_.exchange(false, std::memory_order_relaxed);
+                    if (requested || triggerPending_) {
+                        triggerPending_ = false;
+                        lock.unlock();
+                        (void)dump();
+                        lock.lock();
+                    }
+                    if (stopDumper_) {
+                        return;
+                    }
                 }
-                return 0;
             }
-            if (suffix2 && !appendCharToBuffer(cur, end, suffix2)) {
-                if (outSz) {
-                    out[0] = '\0';
+
+#if !defined(_WIN32)
+            static void signalHandler(int signo, siginfo_t* info, void* context) noexcept {
+                if (auto* target = signalTarget_.load(std::memory_order_acquire)) {
+                    target->dumpRequested_.store(true, std::memory_order_relaxed);
+                }
+                if ((previousAction_.sa_flags & SA_SIGINFO) != 0) {
+                    if (previousAction_.sa_sigaction != nullptr) {
+                        previousAction_.sa_sigaction(signo, info, context);
+                    }
+                } else if (previousAction_.sa_handler != SIG_DFL && previousAction_.sa_handler != SIG_IGN) {
+                    previousAction_.sa_handler(signo);
                 }
-                return 0;
             }
 
-            if (cur < end) {
-                *cur = '\0';
-            } else if (outSz) {
-                out[outSz - 1] = '\0';
+            static inline struct sigaction previousAction_{};
+            static inline int signalNumber_{0};
+#endif
+
+            static inline std::atomic<std::uint64_t> nextId_{1U};
+            static inline std::atomic<FlightRecorderSink*> signalTarget_{nullptr};
+
+            const std::uint64_t id_{nextId_.fetch_add(1U, std::memory_order_relaxed)};
+            const std::size_t capacity_;
+            const Layout layout_;
+            const std::int64_t windowNs_;
+            std::atomic<std::int64_t> triggerNs_{0};
+            std::atomic<std::int64_t> lastTriggerNs_{std::numeric_limits<std::int64_t>::min() / 2};
+            std::atomic<bool> dumpRequested_{false};
+            std::atomic<unsigned> dumpCount_{0U};
+            std::mutex ringsMutex_;
+            std::vector<std::unique_ptr<Ring>> rings_;
+            std::mutex dumperMutex_;
+            std::condition_variable dumperWake_;
+            std::thread dumper_;
+            bool signalArmed_{false};   ///< Guarded by dumperMutex_.
+            bool triggerPending_{false}; ///< Guarded by dumperMutex_.
+            bool stopDumper_{false};    ///< Guarded by dumperMutex_.
+        };
+
+        /**
+         * @brief Constructs a ScopeTimer instance and records the start time.
+         *
+         * @param where A std::string_view describing the scope or function being timed.
+         * @param labelData A helper struct conveying the label string and any owned storage.
+         */
+        inline explicit ScopeTimer(std::string_view where, detail::LabelData labelData = detail::LabelData{}) noexcept
+            : ScopeTimer(DeferStartTag{}, where, std::move(labelData)) {
+            if (!disabled_) {
+                takeStartReadings();
             }
-            return static_cast<std::size_t>(cur - out);
         }
 
         /**
-         * @brief Formats elapsed time using a one-time-selected formatter.
-         *
-         * The formatter is chosen once from SCOPE_TIMER_FORMAT ("SECONDS" | "MILLIS" | "NANOS"),
-         * defaulting to automatic behavior if unset/invalid.
-         *
-         * @param ns   Elapsed time in nanoseconds.
-         * @param out  Output buffer.
-         * @param outSz Size of the output buffer.
+         * @brief Macro entry point: same as the where/label constructor plus a callsite descriptor.
          */
-        static inline std::size_t formatElapsed(long long ns, char* out, size_t outSz) noexcept {
-            return getFormatter()(ns, out, outSz);
+        inline explicit ScopeTimer(const CallSite& site, detail::LabelData labelData = detail::LabelData{}) noexcept
+            : ScopeTimer(siteWhere(site), std::move(labelData)) {
+            site_ = &site;
         }
 
-        static inline std::size_t formatElapsedNanos(long long ns, char* out, size_t outSz) noexcept {
-            return fmtNanos(ns, out, outSz);
+        /**
+         * @brief Finishes a CompactScopeTimer: rebuilt at scope end around its start tick.
+         *
+         * CPU time, perf counters and allocation counts need readings taken at
+         * construction, so compact timers never carry them.
+         */
+        inline explicit ScopeTimer(CompactTag, const CallSite& site, std::string_view label,
+                                   std::chrono::steady_clock::time_point start) noexcept {
+            site_ = &site;
+            where_ = siteWhere(site);
+            label_ = label;
+            threadNum_ = getThreadIdNumber();
+            startSteady_ = start;
         }
 
-        static inline void appendBytesTruncating(char*& out, const char* end, const char* s, std::size_t n) noexcept {
-            if (n == 0 || out >= end) {
-                return;
+        /**
+         * @brief Macro entry point for SCOPE_TIMER_FMT: the label is formatted when the record is delivered.
+         */
+        template <typename... Args>
+        inline explicit ScopeTimer(const CallSite& site, const detail::FormattedLabel<Args...>& label) noexcept
+            : ScopeTimer(site) {
+            if (!disabled_) {
+                label.pack(reinterpret_cast<unsigned char*>(labelBuffer_.data()));
+                label_ = label.format;
+                labelFormatter_ = &detail::FormattedLabel<Args...>::formatPacked;
             }
-            const auto available = static_cast<std::size_t>(end - out);
-            const auto toCopy = std::min(available, n);
-            std::memcpy(out, s, toCopy);
-            out += toCopy;
         }
 
-        static inline void appendCharTruncating(char*& out, const char* end, char c) noexcept {
-            if (out < end) {
-                *out++ = c;
-            }
+        /**
+         * @brief Macro entry point for SCOPE_TIMER_DEADLINE: watched by the watchdog while open.
+         */
+        inline explicit ScopeTimer(std::chrono::nanoseconds deadline, const CallSite& site,
+                                   detail::LabelData labelData = detail::LabelData{}) noexcept
+            : ScopeTimer(site, std::move(labelData)) {
+            watchScope(deadline);
         }
 
         /**
-         * @brief Formats a system_clock time_point into a human-readable timestamp string.
-         *
-         * The format is "YYYY-MM-DD HH:MM:SS.mmm" with millisecond precision.
-         * The calendar portion is cached per-thread for the current second.
+         * @brief Macro entry point for SCOPE_TIMER_RUSAGE: also records the thread's
+         * page faults and context switches across the scope.
          */
-        static inline std::size_t formatTime(std::chrono::system_clock::time_point tp, char* out, size_t outSz) noexcept {
-            if (outSz == 0) {
-                return 0;
+        inline explicit ScopeTimer(ResourceUsageTag, const CallSite& site,
+                                   detail::LabelData labelData = detail::LabelData{}) noexcept
+            : ScopeTimer(DeferStartTag{}, siteWhere(site), std::move(labelData)) {
+            site_ = &site;
+            if (!disabled_) {
+                // Read first so the getrusage() call stays out of elapsed, CPU time and perf counts.
+                rusageCounting_ = readResourceUsage(rusage_);
+                takeStartReadings();
             }
+        }
 
-            const std::time_t tt = std::chrono::system_clock::to_time_t(tp);
-            const auto ms_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
-            const auto ms3 = static_cast<unsigned>(ms_since_epoch % 1000);
+        /**
+         * @brief Macro entry point for the sampling macros, called only once @p sampler admitted the call.
+         */
+        inline explicit ScopeTimer(Sampler& sampler, const CallSite& site,
+                                   detail::LabelData labelData = detail::LabelData{}) noexcept
+            : ScopeTimer(site, std::move(labelData)) {
+            if (!disabled_) {
+                suppressed_ = sampler.takeSuppressed();
+            }
+        }
 
-            struct TimestampPrefixCache {
-                std::time_t second{-1};
-                std::array<char, 20> prefix{};
-                std::uint8_t len{0};
-            };
-            thread_local TimestampPrefixCache cache;
+        /**
+         * @brief Convenience overload that accepts a plain string_view label.
+         */
+        inline explicit ScopeTimer(std::string_view where, std::string_view label) noexcept
+            : ScopeTimer(where, detail::LabelData{label}) {}
 
-            if (cache.second != tt) {
-                auto tm = std::tm{};
-                if (!fillLocalTime(tm, tt)) {
-                    out[0] = '\0';
-                    return 0;
-                }
+        template <std::size_t N>
+        inline explicit ScopeTimer(std::string_view where, const char (&label)[N]) noexcept
+            : ScopeTimer(where, detail::LabelData{
+                std::string_view{label, N ? N - 1 : 0},
+                {},
+                detail::LabelStorageKind::Borrowed
+            }) {}
 
-                char* prefixOut = cache.prefix.data();
-                if (const char* prefixEnd = cache.prefix.data() + cache.prefix.size() - 1U;
-                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(1900 + tm.tm_year), 4) ||
-                    !appendCharToBuffer(prefixOut, prefixEnd, '-') ||
-                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(1 + tm.tm_mon), 2) ||
-                    !appendCharToBuffer(prefixOut, prefixEnd, '-') ||
-                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_mday), 2) ||
-                    !appendCharToBuffer(prefixOut, prefixEnd, ' ') ||
-                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_hour), 2) ||
-                    !appendCharToBuffer(prefixOut, prefixEnd, ':') ||
-                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_min), 2) ||
-                    !appendCharToBuffer(prefixOut, prefixEnd, ':') ||
-                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_sec), 2)) {
-                    out[0] = '\0';
-                    return 0;
-                }
-                *prefixOut = '\0';
-                cache.second = tt;
-                cache.len = static_cast<std::uint8_t>(prefixOut - cache.prefix.data());
+        inline explicit ScopeTimer(HotPathTag, detail::LabelData labelData = detail::LabelData{}) noexcept {
+            if (isDisabled()) {
+                disabled_ = true;
+                return;
             }
 
-            char* cur = out;
-            const char* end = out + outSz - 1U;
-            appendBytesTruncating(cur, end, cache.prefix.data(), cache.len);
-            appendCharTruncating(cur, end, '.');
-            if (auto* next = appendThreeDigitsToBuffer(cur, end, ms3)) {
-                cur = next;
-            }
-            *cur = '\0';
-            return static_cast<std::size_t>(cur - out);
+            hotPathMode_ = true;
+            assignLabel(std::move(labelData));
+            startSteady_ = std::chrono::steady_clock::now();
         }
 
-        static inline void appendUnsignedTruncating(char*& out, const char* end, unsigned long long v) noexcept {
-            std::array<char, 32> tmp{};
-            const auto result = std::to_chars(tmp.data(), tmp.data() + tmp.size(), v);
-            if (result.ec != std::errc{}) {
-                return;
-            }
-            appendBytesTruncating(out, end, tmp.data(), static_cast<std::size_t>(result.ptr - tmp.data()));
+        inline explicit ScopeTimer(HotPathTag, const CallSite& site, detail::LabelData labelData = detail::LabelData{}) noexcept
+            : ScopeTimer(HotPathTag{}, std::move(labelData)) {
+            site_ = &site;
         }
 
-        static inline void appendThreadIdTruncating(char*& out, const char* end, unsigned tid) noexcept {
-            if (tid < 1000U) {
-                const std::array<char, 3> digits{
-                    static_cast<char>('0' + ((tid / 100U) % 10U)),
-                    static_cast<char>('0' + ((tid / 10U) % 10U)),
-                    static_cast<char>('0' + (tid % 10U))
-                };
-                appendBytesTruncating(out, end, digits.data(), digits.size());
+        inline explicit ScopeTimer(HotPathTag, std::string_view label) noexcept
+            : ScopeTimer(HotPathTag{}, detail::LabelData{label}) {}
+
+        template <std::size_t N>
+        inline explicit ScopeTimer(HotPathTag, const char (&label)[N]) noexcept
+            : ScopeTimer(HotPathTag{}, detail::LabelData{
+                std::string_view{label, N ? N - 1 : 0},
+                {},
+                detail::LabelStorageKind::Borrowed
+            }) {}
+
+        ScopeTimer(const ScopeTimer&) = delete; ///< Deleted copy constructor for safety.
+        ScopeTimer& operator=(const ScopeTimer&) = delete; ///< Deleted copy assignment operator.
+
+        /**
+         * @brief Destructor that records the end time, computes elapsed duration,
+         * formats timing information, and writes a log entry.
+         *
+         * Logs include thread ID, scope name, start and end timestamps, and elapsed time.
+         */
+        inline ~ScopeTimer() noexcept {
+            if (disabled_) {
                 return;
             }
-            appendUnsignedTruncating(out, end, tid);
-        }
+            if (watched_) {
+                unwatchScope();
+            }
 
-        struct LogLineFields {
-            std::string_view label;
-            unsigned threadNum{0};
-            std::string_view where;
-            std::string_view startWall;
-            std::string_view endWall;
-            std::string_view elapsed;
-            bool wallTimeEnabled{false};
-        };
+            const auto endSteady = std::chrono::steady_clock::now();
+            const auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(endSteady - startSteady_).count();
+            if (allocCounting_) {
+                const AllocationCounts& now = threadAllocations();
+                allocations_.count = now.count - allocations_.count;
+                allocations_.bytes = now.bytes - allocations_.bytes;
+            }
+            if (cpuNs_ != NoCpuTime) {
+                cpuNs_ += threadCpuTimeNs();
+            }
+            if (perfCounting_) {
+                perfCounting_ = finishPerfCounters(perf_);
+            }
+            if (rusageCounting_) {
+                rusageCounting_ = finishResourceUsage(rusage_);
+            }
 
-        static inline std::size_t buildLogLine(
-            char* out,
-            std::size_t outSz,
-            const LogLineFields& fields
-        ) noexcept {
-            if (outSz == 0) {
-                return 0;
+            if (sinkPipelineStorage().load(std::memory_order_relaxed) != nullptr) {
+                const SinkPipelineReadGuard readGuard;
+                if (auto* pipeline = sinkPipelineStorage().load(std::memory_order_seq_cst)) {
+                    deliverToPipeline(*pipeline, endSteady, elapsedNs);
+                    return;
+                }
             }
 
-            char* cur = out;
-            const char* end = out + outSz - 1U; // reserve a byte for a terminator
+            formatDeferredLabel();
+            if (auto* recordSink = recordSinkStorage().load(std::memory_order_acquire)) {
+                deliverRecord(*recordSink, endSteady);
+                if (recordSinkIsExclusive()) {
+                    return;
+                }
+            }
 
-            appendCharTruncating(cur, end, '[');
-            appendBytesTruncating(cur, end, fields.label.data(), fields.label.size());
-            appendBytesTruncating(cur, end, "] TID=", sizeof("] TID=") - 1U);
-            appendThreadIdTruncating(cur, end, fields.threadNum);
-            appendBytesTruncating(cur, end, " | ", sizeof(" | ") - 1U);
-            appendBytesTruncating(cur, end, fields.where.data(), fields.where.size());
-            if (fields.wallTimeEnabled) {
-                appendBytesTruncating(cur, end, " | start=", sizeof(" | start=") - 1U);
-                appendBytesTruncating(cur, end, fields.startWall.data(), fields.startWall.size());
-                appendBytesTruncating(cur, end, " | end=", sizeof(" | end=") - 1U);
-                appendBytesTruncating(cur, end, fields.endWall.data(), fields.endWall.size());
+            // These sink-state atomics are intentionally acquire/release or relaxed
+            // instead of seq_cst. They publish configuration chosen under
+            // sinkConfigMutex(), and stronger global ordering would add fences on the
+            // steady-state timer path without improving correctness. Sonar's blanket
+            // seq_cst rule is suppressed for this header in sonar-project.properties.
+            const auto activeSink = activeSinkStorage().load(std::memory_order_acquire);
+            if (auto* reservingSink = customReservingSinkStorage();
+                reservingSink != nullptr && activeSink == ActiveSink::Custom) {
+                std::lock_guard lock(outMutex());
+                writeToReservingSink(*reservingSink, elapsedNs);
+            } else {
+                // Final line buffer reused per thread to avoid repeated stack allocation.
+                auto& lineBuf = lineBuffer();
+                if (const std::size_t len = renderLogLine(lineBuf.data, sizeof(lineBuf.data), elapsedNs); len) {
+                    if (activeSink != ActiveSink::ThreadBuffered) {
+                        std::lock_guard lock(outMutex());
+                        writeToActiveSink(activeSink, lineBuf.data, len);
+                    } else {
+                        writeToActiveSink(activeSink, lineBuf.data, len);
+                    }
+                }
             }
-            appendBytesTruncating(cur, end, " | elapsed=", sizeof(" | elapsed=") - 1U);
-            appendBytesTruncating(cur, end, fields.elapsed.data(), fields.elapsed.size());
-            appendCharTruncating(cur, end, '\n');
 
-            *cur = '\0';
-            return static_cast<std::size_t>(cur - out);
+            // Thread-buffered sink flushes on size; avoid periodic counters and
+            // interval checks to keep the buffered hot path cheap.
+            if (activeSink != ActiveSink::ThreadBuffered) {
+                const unsigned cnt = lineCounter().fetch_add(1, std::memory_order_relaxed) + 1U;
+                if (cnt % flushInterval() == 0) { // configurable via SCOPE_TIMER_FLUSH_N
+                    flushActiveSink(activeSink);
+                }
+            }
         }
 
-        static inline std::size_t buildHotPathLogLine(
-            char* out,
-            std::size_t outSz,
-            std::string_view label,
-            const char* elapsed,
-            std::size_t elapsedLen
-        ) noexcept {
-            if (outSz == 0) {
-                return 0;
+        static inline void enableThreadBufferedSink(std::size_t flushBytes = 16U * 1024U) noexcept {
+            if (flushBytes == 0) {
+                flushBytes = 16U * 1024U;
             }
-
-            char* cur = out;
-            const char* end = out + outSz - 1U;
-            appendCharTruncating(cur, end, '[');
-            appendBytesTruncating(cur, end, label.data(), label.size());
-            appendBytesTruncating(cur, end, "] elapsed=", sizeof("] elapsed=") - 1U);
-            appendBytesTruncating(cur, end, elapsed, elapsedLen);
-            appendCharTruncating(cur, end, '\n');
-
-            *cur = '\0';
-            return static_cast<std::size_t>(cur - out);
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            flushAllThreadBuffers();
+            asyncSinkFlush();
+            shutdownAsyncSink();
+            closeLogFd();
+            threadBufferFlushBytesStorage().store(flushBytes);
+            activeSinkStorage().store(ActiveSink::ThreadBuffered, std::memory_order_release);
+            bufferedSinkTargetModeStorage().store(hasCustomSink() ? BufferedSinkTargetMode::Custom
+                                                                  : BufferedSinkTargetMode::Default,
+                                                  std::memory_order_release);
+            // Buffered records must drain at exit even if no descriptor was opened yet.
+            registerLogFdCleanup();
         }
 
         /**
-         * @brief Per-thread scratch space for formatted end/elapsed timestamps.
+         * @brief Thread-buffered mode where each thread appends to its own file.
+         *
+         * Every thread writes `ScopeTimer.<pid>.<tid>.log` in the log directory
+         * through its own descriptor, so flushes never take the shared output
+         * lock. Use scripts/merge_scope_logs.py to interleave the files by
+         * timestamp. Disable with disableThreadBufferedSink().
          */
-        struct FormatBuffers {
-            char endBuf[32];
-            char elapsedBuf[32];
-            std::uint8_t endLen;
-            std::uint8_t elapsedLen;
-        };
+        static inline void enablePerThreadFileSink(std::size_t flushBytes = 16U * 1024U) noexcept {
+            if (flushBytes == 0) {
+                flushBytes = 16U * 1024U;
+            }
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            flushAllThreadBuffers();
+            asyncSinkFlush();
+            shutdownAsyncSink();
+            closeLogFd();
+            threadBufferFlushBytesStorage().store(flushBytes);
+            activeSinkStorage().store(ActiveSink::ThreadBuffered, std::memory_order_release);
+            bufferedSinkTargetModeStorage().store(BufferedSinkTargetMode::PerThreadFile, std::memory_order_release);
+            registerLogFdCleanup();
+        }
 
         /**
-         * @brief Returns the thread-local formatting scratch space.
+         * @brief Opt-in emergency flush of buffered records on fatal signals.
+         *
+         * Installs handlers for SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, and
+         * SIGTERM that write every thread buffer, plus the async queue when its
+         * lock is free, straight to the log files with raw write(). The
+         * previous handler is then restored and the signal re-raised, so
+         * existing crash handlers and exit statuses are preserved. Records go
+         * to ScopeTimer.log (or the per-thread files) even when a custom sink
+         * is registered, because user sink code is not signal safe. Returns
+         * false where POSIX signals are unavailable.
          */
-        static inline FormatBuffers& formatBuffers() noexcept {
-            return tlsFormatBuffers_;
+        static inline bool installCrashFlushHandler() noexcept {
+#if defined(_WIN32)
+            return false;
+#else
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            if (crashFlushInstalled_) {
+                return true;
+            }
+
+            // Resolve the fallback path now; the handler cannot build strings.
+            const std::string path = logDirectory() + "ScopeTimer.log";
+            if (path.size() >= sizeof(crashLogPath_)) {
+                return false;
+            }
+            std::memcpy(crashLogPath_, path.c_str(), path.size() + 1U);
+
+            struct sigaction action {};
+            action.sa_handler = &crashFlushSignalHandler;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_ONSTACK; // use an alternate stack when the app configured one
+            for (std::size_t i = 0U; i < CrashSignals.size(); ++i) {
+                ::sigaction(CrashSignals[i], &action, &crashPreviousActions_[i]);
+            }
+            crashFlushInstalled_ = true;
+            return true;
+#endif
         }
 
-        /**
-         * @brief Helper used by tests to ensure format buffers are reused.
-         */
-        static inline const char* endBufferAddressForTests() noexcept {
-            return formatBuffers().endBuf;
+        static inline void uninstallCrashFlushHandler() noexcept {
+#if !defined(_WIN32)
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            if (!crashFlushInstalled_) {
+                return;
+            }
+            for (std::size_t i = 0U; i < CrashSignals.size(); ++i) {
+                ::sigaction(CrashSignals[i], &crashPreviousActions_[i], nullptr);
+            }
+            crashFlushInstalled_ = false;
+#endif
         }
 
-        /**
-         * @brief Per-thread assembly buffer for the full log line.
-         */
-        struct LineBuffer {
-            char data[512];
-        };
+        static inline void disableThreadBufferedSink() noexcept {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            flushSuppressedSamples();
+            flushAllThreadBuffers();
+            asyncSinkFlush();
+            shutdownAsyncSink();
+            closeLogFd();
+            restoreDefaultSinkState();
+        }
+
+        static inline void enableAsyncSink(std::size_t flushBytes = 16U * 1024U) noexcept {
+            if (flushBytes == 0) {
+                flushBytes = 16U * 1024U;
+            }
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            flushAllThreadBuffers();
+            asyncSinkFlush();
+            shutdownAsyncSink();
+            closeLogFd();
+            threadBufferFlushBytesStorage().store(flushBytes);
+            activeSinkStorage().store(ActiveSink::ThreadBuffered, std::memory_order_release);
+            bufferedSinkTargetModeStorage().store(BufferedSinkTargetMode::Async, std::memory_order_release);
+            asyncSinkTargetModeStorage().store(hasCustomSink() ? AsyncSinkTargetMode::Custom
+                                                               : AsyncSinkTargetMode::Default,
+                                               std::memory_order_release);
+            registerLogFdCleanup();
+            ensureAsyncSinkRunning();
+        }
+
+        static inline void disableAsyncSink() noexcept {
+            disableThreadBufferedSink();
+        }
+
+        static inline void setLogSink(LogSink& sink) {
+            setCustomLogSink(&sink);
+        }
+
+        static inline void setLogSink(ReservingLogSink& sink) {
+            setCustomLogSink(&sink, &sink);
+        }
+
+        static inline void resetLogSink() {
+            setCustomLogSink(nullptr);
+        }
 
         /**
-         * @brief Accessor for the thread-local line assembly buffer.
+         * @brief Routes every record to @p sink as a struct.
+         *
+         * In Exclusive mode timers skip wall-clock formatting and line assembly
+         * entirely, so the cost measured is capture plus the sink itself.
          */
-        static inline LineBuffer& lineBuffer() noexcept {
-            return tlsLineBuffer_;
+        static inline void setRecordSink(RecordSink& sink, RecordSinkMode mode = RecordSinkMode::Exclusive) {
+            setRecordSinkImpl(&sink, mode);
+        }
+
+        static inline void resetRecordSink() {
+            setRecordSinkImpl(nullptr, RecordSinkMode::Exclusive);
         }
 
         /**
-         * @brief Per-thread assembly buffer for the full log line.
+         * @brief Fans every record out to several routes at once.
+         *
+         * While a pipeline is installed it replaces the single active sink and
+         * the record sink. DefaultFile routes write through the active sink
+         * mode, so the buffered, async and per-thread-file modes still apply;
+         * Log and Record routes are written synchronously on the timing thread.
+         * SCOPE_TIMER_FLUSH_N flushes the text routes. At most MaxSinkRoutes are
+         * kept; routes missing their sink are dropped. Sinks of the outgoing
+         * pipeline are flushed on replacement and must outlive the pipeline.
+         * A replaced pipeline is freed by a later replacement that finds no
+         * timer still delivering.
          */
-        static void defaultSinkWrite(const char* data, std::size_t len) noexcept;
-        static void defaultSinkFlush() noexcept;
-        static void noopSinkFlush() noexcept;
-        static void threadBufferedSinkWrite(const char* data, std::size_t len) noexcept;
-        static void threadBufferedSinkFlush() noexcept;
-        static void asyncSinkWrite(const char* data, std::size_t len) noexcept;
-        static void asyncSinkFlush() noexcept;
-
-        enum class ActiveSink {
-            Default,
-            ThreadBuffered,
-            Custom,
-        };
-
-        enum class BufferedSinkTargetMode {
-            Default,
-            Async,
-            Custom,
-            TestCustom,
-        };
+        static inline void setSinkPipeline(std::vector<SinkRoute> routes) {
+            auto pipeline = std::make_unique<SinkPipeline>();
+            for (auto& route : routes) {
+                if (pipeline->count == MaxSinkRoutes) {
+                    break;
+                }
+                if ((route.target == SinkRoute::Target::Log && route.logSink == nullptr)
+                    || (route.target == SinkRoute::Target::Record && route.recordSink == nullptr)) {
+                    continue;
+                }
+                if (route.target != SinkRoute::Target::Record) {
+                    pipeline->hasTextRoutes = true;
+                }
+                if (route.sampleEvery == 0U) {
+                    route.sampleEvery = 1U;
+                }
+                pipeline->routes[pipeline->count++].route = std::move(route);
+            }
+            installSinkPipeline(std::move(pipeline));
+        }
 
-        enum class BufferedSinkFlushMode {
-            Deferred,
-            Forced,
-        };
+        static inline void resetSinkPipeline() {
+            installSinkPipeline(nullptr);
+        }
 
-        enum class AsyncSinkTargetMode {
-            Default,
-            Custom,
-        };
+        /**
+         * @brief Starts the thread that checks SCOPE_TIMER_DEADLINE scopes every @p period.
+         *
+         * Deadline timers register in their thread's live-scope stack only
+         * while the watchdog runs. The first check that finds an open scope
+         * past its deadline reports it once, as a `deadline=... | running=...`
+         * text line on the active sink or through the watchdog callback.
+         */
+        static inline void startWatchdog(std::chrono::nanoseconds period = std::chrono::milliseconds(10)) noexcept {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            shutdownWatchdog();
+            auto& state = watchdogState();
+            {
+                std::lock_guard lock(state.mutex);
+                state.period = period.count() > 0 ? period : std::chrono::nanoseconds(std::chrono::milliseconds(10));
+                state.stop = false;
+                state.running = true;
+                state.worker = std::thread([] { runWatchdog(); });
+            }
+            watchdogRunningStorage().store(true, std::memory_order_release);
+            registerLogFdCleanup();
+        }
 
-        struct ThreadBufferState {
-            std::mutex flushMutex;
-            std::vector<char> data;
-            std::size_t size{0U};
-            std::size_t capacity{0U};
-        };
+        static inline void stopWatchdog() noexcept {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            shutdownWatchdog();
+        }
 
-        struct ThreadBufferHandle {
-            std::shared_ptr<ThreadBufferState> state{std::make_shared<ThreadBufferState>()};
+        /**
+         * @brief Replaces the text report with @p callback; pass nullptr to restore it.
+         *
+         * The callback runs on the watchdog thread with Record::stillRunning set
+         * and endSteadyNs holding the time of the check. No ScopeTimer lock is
+         * held and the views are copies, so the timed scope may end meanwhile.
+         * It must not call stopWatchdog(), which joins the watchdog thread.
+         */
+        static inline void setWatchdogCallback(std::function<void(const Record&)> callback) {
+            auto& state = watchdogState();
+            std::lock_guard lock(state.mutex);
+            state.callback = std::move(callback);
+        }
 
-            ThreadBufferHandle() {
-                registerThreadBuffer(state);
+        /**
+         * @brief Reports the calls each sampling-macro callsite skipped after its last record.
+         *
+         * Writes one "suppressed=" line per callsite with a pending count and
+         * clears the count. Runs at exit and when the buffered sinks are
+         * disabled; call it before reading the log of a running process.
+         */
+        static inline void flushSuppressedSamples() noexcept {
+            if (isDisabled()) {
+                return;
             }
-
-            ~ThreadBufferHandle() {
-                ScopeTimer::flushThreadBuffer(*state);
+            for (Sampler* sampler = Sampler::enlistedHead_.load(std::memory_order_acquire); sampler != nullptr;
+                 sampler = sampler->nextEnlisted_) {
+                if (const std::uint64_t count = sampler->takeSuppressed(); count != 0U) {
+                    writeSuppressedLine(*sampler->site_, count);
+                }
             }
-
-            ThreadBufferHandle(const ThreadBufferHandle&) = delete;
-            ThreadBufferHandle& operator=(const ThreadBufferHandle&) = delete;
-            ThreadBufferHandle(ThreadBufferHandle&&) = delete;
-            ThreadBufferHandle& operator=(ThreadBufferHandle&&) = delete;
-        };
-
-        static inline ThreadBufferState& threadLocalBuffer() noexcept {
-            thread_local ThreadBufferHandle handle;
-            return *handle.state;
-        }
-        static inline std::atomic<std::size_t>& threadBufferFlushBytesStorage() noexcept {
-            return detail::singletonStorage<detail::ThreadBufferFlushBytesTag, std::atomic<std::size_t>>(16U * 1024U);
-        }
-        static inline std::size_t threadBufferFlushBytes() noexcept {
-            // The threshold is configuration state written under sinkConfigMutex(); a
-            // relaxed load is sufficient and avoids an unnecessary fence per append.
-            return threadBufferFlushBytesStorage().load(std::memory_order_relaxed);
-        }
-        static inline std::mutex& threadBufferRegistryMutex() noexcept {
-            return detail::singletonStorage<detail::ThreadBufferRegistryMutexTag, std::mutex>();
         }
-        static inline std::vector<std::weak_ptr<ThreadBufferState>>& threadBufferRegistry() noexcept {
-            return detail::singletonStorage<detail::ThreadBufferRegistryTag, std::vector<std::weak_ptr<ThreadBufferState>>>();
+
+        /**
+         * @brief Counts one heap allocation on the calling thread.
+         *
+         * Called by the operator new replacements in src/ScopeTimerAllocHooks.cpp;
+         * touches only trivially constructed thread-local storage, so it is safe
+         * during thread start-up and teardown.
+         */
+        static inline void noteAllocation(std::size_t bytes) noexcept {
+            auto& counts = threadAllocations();
+            ++counts.count;
+            counts.bytes += bytes;
         }
-        static inline void registerThreadBuffer(const std::shared_ptr<ThreadBufferState>& state) noexcept {
-            std::lock_guard lock(threadBufferRegistryMutex());
-            threadBufferRegistry().emplace_back(state);
+
+        /**
+         * @brief Turns on per-scope allocation counts; the hook source calls this at start-up.
+         */
+        static inline void markAllocationHooksLinked() noexcept {
+            allocationHooksLinked_.store(true, std::memory_order_relaxed);
         }
-        static inline std::vector<std::shared_ptr<ThreadBufferState>> snapshotThreadBuffers() noexcept {
-            std::vector<std::shared_ptr<ThreadBufferState>> states;
-            std::lock_guard lock(threadBufferRegistryMutex());
-            auto& registry = threadBufferRegistry();
-            registry.erase(
-                std::remove_if(registry.begin(), registry.end(), [&states](const auto& weakState) {
-                    if (auto state = weakState.lock()) {
-                        states.push_back(state);
-                        return false;
-                    }
-                    return true;
-                }),
-                registry.end()
-            );
-            return states;
+
+        /**
+         * @brief Whether records carry allocation counts (the hook source is linked in).
+         */
+        static inline bool allocationTrackingEnabled() noexcept {
+            return allocationHooksLinked_.load(std::memory_order_relaxed);
         }
-        static inline void ensureThreadBufferCapacity(ThreadBufferState& state, std::size_t flushBytes) noexcept {
-            if (state.capacity >= flushBytes) {
-                return;
-            }
 
-            std::lock_guard lock(state.flushMutex);
-            if (state.capacity >= flushBytes) {
+    private:
+        friend class xyzzy::scopetimer::ScopeTimer_TestFriend; // Allow unit tests to access private members
+        friend class xyzzy::scopetimer::AsyncScopeTimer;
+        friend class xyzzy::scopetimer::ScopeSpan;
+        friend class xyzzy::scopetimer::LapScopeTimer;
+        friend class xyzzy::scopetimer::LoopScopeTimer;
+        friend class xyzzy::scopetimer::CompactScopeTimer;
+        template <typename, typename> friend class xyzzy::scopetimer::BasicScopeTimer;
+        friend struct xyzzy::scopetimer::ScopeTimerSinkPolicy;
+
+        struct RelocateTag {};
+        struct DeferStartTag {};
+
+        /**
+         * @brief Sets up where, label and thread but takes no start readings; see takeStartReadings().
+         */
+        inline ScopeTimer(DeferStartTag, std::string_view where, detail::LabelData labelData) noexcept {
+            if(isDisabled()) {
+                disabled_ = true;
                 return;
             }
 
-            state.data.resize(flushBytes);
-            state.capacity = flushBytes;
-        }
-        static inline bool bufferedSinkTargetNeedsLock(BufferedSinkTargetMode mode) noexcept {
-            return mode != BufferedSinkTargetMode::Async;
+            where_ = where;
+            assignLabel(std::move(labelData));
+            threadNum_ = getThreadIdNumber();
         }
-        static inline std::size_t drainThreadBuffer(ThreadBufferState& state, const char*& data) noexcept {
-            // Buffered sink mode changes are documented as setup/teardown steps.
-            // Callers are expected to quiesce profiled worker threads before a
-            // cross-thread flush such as disable/atexit walks the registry.
-            std::lock_guard lock(state.flushMutex);
-            if (state.size == 0U) {
-                data = nullptr;
-                return 0U;
+
+        /**
+         * @brief Takes the CPU-time, perf, clock and allocation start readings, in that order.
+         */
+        inline void takeStartReadings() noexcept {
+            if (includeCpuTime()) {
+                cpuNs_ = -threadCpuTimeNs();
+            }
+            if (includePerfCounters()) {
+                perfCounting_ = readPerfCounters(perf_);
+            }
+            startSteady_ = std::chrono::steady_clock::now();
+            if (allocationHooksLinked_.load(std::memory_order_relaxed)) {
+                allocations_ = threadAllocations();
+                allocCounting_ = true;
             }
+        }
 
-            data = state.data.data();
-            const std::size_t len = state.size;
-            state.size = 0U;
-            return len;
+        /**
+         * @brief The calling thread's running allocation totals (constant-initialized, no TLS guard).
+         */
+        static inline AllocationCounts& threadAllocations() noexcept {
+            thread_local AllocationCounts counts;
+            return counts;
         }
-        static inline void writeBufferedSinkPayload(
-            BufferedSinkTargetMode mode,
-            const char* data,
-            std::size_t len
-        ) noexcept {
-            if (len == 0U) {
-                return;
-            }
 
-            writeToBufferedSinkTarget(mode, data, len);
+        /**
+         * @brief Takes over a running timer, leaving @p other disabled (ScopeSpan moves).
+         *
+         * The label view is re-pointed when it refers to the source's inline or
+         * heap storage. Deadline timers are never relocated.
+         */
+        inline ScopeTimer(RelocateTag, ScopeTimer& other) noexcept {
+            site_ = other.site_;
+            where_ = other.where_;
+            labelBuffer_ = other.labelBuffer_;
+            const bool inlineLabel = other.label_.data() == other.labelBuffer_.data();
+            const bool heapLabel = !other.labelHeapStorage_.empty() && other.label_.data() == other.labelHeapStorage_.data();
+            labelHeapStorage_ = std::move(other.labelHeapStorage_);
+            labelFormatter_ = std::exchange(other.labelFormatter_, nullptr);
+            if (inlineLabel) {
+                label_ = std::string_view{labelBuffer_.data(), other.label_.size()};
+            } else if (heapLabel) {
+                label_ = labelHeapStorage_;
+            } else {
+                label_ = other.label_;
+            }
+            threadNum_ = other.threadNum_;
+            startSteady_ = other.startSteady_;
+            cpuNs_ = other.cpuNs_;
+            perf_ = other.perf_;
+            perfCounting_ = other.perfCounting_;
+            rusage_ = other.rusage_;
+            rusageCounting_ = other.rusageCounting_;
+            allocations_ = other.allocations_;
+            allocCounting_ = other.allocCounting_;
+            disabled_ = other.disabled_;
+            hotPathMode_ = other.hotPathMode_;
+            suspendedNs_ = other.suspendedNs_;
+            migrations_ = other.migrations_;
+            correlationId_ = other.correlationId_;
+            suppressed_ = other.suppressed_;
+            other.disabled_ = true;
         }
-        static inline void publishBufferedSinkPayload(
-            const char* data,
-            std::size_t len,
-            BufferedSinkFlushMode flushMode = BufferedSinkFlushMode::Deferred
-        ) noexcept {
-            if (len == 0U && flushMode == BufferedSinkFlushMode::Deferred) {
+
+        /**
+         * @brief Drops the thread-bound counters when the timer ends on another thread.
+         *
+         * CPU time, perf counters, resource usage and allocation counts are
+         * per-thread, so a delta across two threads would be meaningless.
+         */
+        inline void dropThreadCountersIfMigrated() noexcept {
+            if (disabled_ || threadNum_ == getThreadIdNumber()) {
                 return;
             }
+            cpuNs_ = NoCpuTime;
+            perfCounting_ = false;
+            rusageCounting_ = false;
+            allocCounting_ = false;
+        }
+        
+        /**
+         * @brief Checks if the ScopeTimer is disabled based on the SCOPE_TIMER environment variable.
+         *
+         * Reads the environment variable once and caches the result for subsequent calls.
+         * Returns true if the value is "OFF", "FALSE", "NO", or "0" (case-insensitive).
+         *
+         * @return true if disabled, false otherwise.
+         */
+        static inline bool isDisabled() noexcept {
+            static const bool disabled = []() {
+                const char* env = std::getenv("SCOPE_TIMER");
 
-            const auto bufferedTarget = bufferedSinkTargetModeStorage().load(std::memory_order_acquire);
-            if (bufferedSinkTargetNeedsLock(bufferedTarget)) {
-                std::lock_guard lock(outMutex());
-                writeBufferedSinkPayload(bufferedTarget, data, len);
-                if (flushMode == BufferedSinkFlushMode::Forced) {
-                    flushBufferedSinkTarget(bufferedTarget);
+                if(!env) {
+                    return false;
                 }
-                return;
-            }
 
-            writeBufferedSinkPayload(bufferedTarget, data, len);
-            if (flushMode == BufferedSinkFlushMode::Forced) {
-                flushBufferedSinkTarget(bufferedTarget);
-            }
-        }
-        static inline void flushThreadBuffer(
-            ThreadBufferState& state,
-            BufferedSinkFlushMode flushMode = BufferedSinkFlushMode::Deferred
-        ) noexcept {
-            const char* pendingData = nullptr;
-            const std::size_t pendingLen = drainThreadBuffer(state, pendingData);
-            publishBufferedSinkPayload(pendingData, pendingLen, flushMode);
+                const std::string val = normalizeBooleanSetting(env);
+
+                return val == "OFF" || val == "FALSE" || val == "NO" || val == "0";
+            }();
+
+            return disabled;
         }
-        static inline void flushAllThreadBuffers(
-            BufferedSinkFlushMode flushMode = BufferedSinkFlushMode::Forced
-        ) noexcept {
-            const auto states = snapshotThreadBuffers();
-            const auto bufferedTarget = bufferedSinkTargetModeStorage().load(std::memory_order_acquire);
-            const bool needsLock = bufferedSinkTargetNeedsLock(bufferedTarget);
-            std::unique_lock sinkLock(outMutex(), std::defer_lock);
-            if (needsLock) {
-                sinkLock.lock();
-            }
 
-            for (const auto& state : states) {
-                const char* pendingData = nullptr;
-                const std::size_t pendingLen = drainThreadBuffer(*state, pendingData);
-                writeBufferedSinkPayload(bufferedTarget, pendingData, pendingLen);
+        static inline std::string normalizeBooleanSetting(const char* env) {
+            std::string value(env ? env : "");
+            const auto isSpace = [](char c) {
+                return std::isspace(static_cast<unsigned char>(c)) != 0;
+            };
+            const auto first = std::find_if_not(value.begin(), value.end(), isSpace);
+            const auto last = std::find_if_not(value.rbegin(), value.rend(), isSpace).base();
+            if (first >= last) {
+                return {};
             }
 
-            if (flushMode == BufferedSinkFlushMode::Forced) {
-                flushBufferedSinkTarget(bufferedTarget);
-            }
-        }
-        static inline std::mutex& sinkConfigMutex() noexcept {
-            return detail::singletonStorage<detail::SinkConfigMutexTag, std::mutex>();
-        }
-        static inline void restoreDefaultSinkState() noexcept {
-            activeSinkStorage().store(hasCustomSink() ? ActiveSink::Custom : ActiveSink::Default,
-                                      std::memory_order_release);
-            bufferedSinkTargetModeStorage().store(hasCustomSink() ? BufferedSinkTargetMode::Custom
-                                                                  : BufferedSinkTargetMode::Default,
-                                                  std::memory_order_release);
-            asyncSinkTargetModeStorage().store(hasCustomSink() ? AsyncSinkTargetMode::Custom
-                                                               : AsyncSinkTargetMode::Default,
-                                               std::memory_order_release);
+            std::string normalized(first, last);
+            std::transform(normalized.begin(), normalized.end(), normalized.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+            return normalized;
         }
 
-        static inline std::atomic<ActiveSink>& activeSinkStorage() noexcept {
-            return detail::singletonStorage<detail::ActiveSinkStorageTag, std::atomic<ActiveSink>>(ActiveSink::Default);
+        static inline bool isTruthySetting(const char* envName, bool defaultValue) noexcept {
+            if (const char* env = std::getenv(envName); env && *env) {
+                const std::string value = normalizeBooleanSetting(env);
+                if (value.empty()) {
+                    return defaultValue;
+                }
+                if (value == "OFF" || value == "FALSE" || value == "NO" || value == "0") {
+                    return false;
+                }
+                return true;
+            }
+            return defaultValue;
+        }
+
+        static inline bool includeWallTime() noexcept {
+            static const bool enabled = isTruthySetting("SCOPE_TIMER_WALLTIME", true);
+            return enabled;
+        }
+
+        /**
+         * @brief Whether callsite timers report the compile-time short function name (SCOPE_TIMER_WHERE=SHORT).
+         */
+        static inline bool useShortWhere() noexcept {
+            static const bool enabled = [] {
+                const char* env = std::getenv("SCOPE_TIMER_WHERE");
+                return env != nullptr && normalizeBooleanSetting(env) == "SHORT";
+            }();
+            return enabled;
+        }
+
+        /**
+         * @brief The where= text reported for @p site under the current SCOPE_TIMER_WHERE setting.
+         */
+        static inline std::string_view siteWhere(const CallSite& site) noexcept {
+            return useShortWhere() && !site.shortWhere.empty() ? site.shortWhere : site.where;
+        }
+
+        /**
+         * @brief Whether standard records use the tab-separated compact line (SCOPE_TIMER_LINE_FORMAT=COMPACT).
+         */
+        static inline bool compactLines() noexcept {
+            static const bool enabled = [] {
+                const char* env = std::getenv("SCOPE_TIMER_LINE_FORMAT");
+                return env != nullptr && normalizeBooleanSetting(env) == "COMPACT";
+            }();
+            return enabled;
+        }
+
+        /**
+         * @brief Whether standard timers also measure thread CPU time (SCOPE_TIMER_CPU_TIME, off by default).
+         */
+        static inline bool includeCpuTime() noexcept {
+            static const bool enabled = isTruthySetting("SCOPE_TIMER_CPU_TIME", false) && threadCpuTimeNs() > 0;
+            return enabled;
+        }
+
+        /**
+         * @brief CPU time consumed by the calling thread, in nanoseconds; 0 when unavailable.
+         *
+         * CLOCK_THREAD_CPUTIME_ID is not served by the vDSO on Linux, so each
+         * read is a system call; that is why CPU capture is opt-in.
+         */
+        static inline std::int64_t threadCpuTimeNs() noexcept {
+#if defined(_WIN32) || !defined(CLOCK_THREAD_CPUTIME_ID)
+            return 0;
+#else
+            timespec ts{};
+            if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+                return 0;
+            }
+            return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+#endif
+        }
+
+        /**
+         * @brief Whether standard timers also read perf_event counters (SCOPE_TIMER_PERF_COUNTERS, off by default).
+         */
+        static inline bool includePerfCounters() noexcept {
+#if defined(SCOPE_TIMER_HAS_PERF_EVENTS)
+            static const bool enabled = isTruthySetting("SCOPE_TIMER_PERF_COUNTERS", false);
+            return enabled;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * @brief One thread's perf_event_open counter group.
+         *
+         * All events share a group so one read() returns a consistent snapshot.
+         * The group is opened on first use and closed when the thread exits; a
+         * thread that cannot open any event never retries.
+         */
+        struct PerfCounterGroup {
+            enum class State : std::uint8_t { Unopened, Open, Failed };
+            static constexpr std::size_t MaxEvents = 6U;
+
+            std::array<int, MaxEvents> fds{-1, -1, -1, -1, -1, -1};
+            std::size_t count{0U};
+            bool hardware{false};
+            State state{State::Unopened};
+
+            PerfCounterGroup() = default;
+            PerfCounterGroup(const PerfCounterGroup&) = delete;
+            PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+            ~PerfCounterGroup() { reset(); }
+
+            void reset() noexcept {
+                for (std::size_t i = count; i > 0U; --i) {
+                    closeFd(fds[i - 1U]);
+                    fds[i - 1U] = -1;
+                }
+                count = 0U;
+                hardware = false;
+                state = State::Unopened;
+            }
+        };
+
+        static inline PerfCounterGroup& perfCounterGroup() noexcept {
+            thread_local PerfCounterGroup group;
+            return group;
+        }
+
+#if defined(SCOPE_TIMER_HAS_PERF_EVENTS)
+        static inline int openPerfEvent(std::uint32_t type, std::uint64_t config, int groupFd) noexcept {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_hv = 1;
+            // Counting kernel work needs perf_event_paranoid < 2; retry user-only
+            // so unprivileged processes still get what they are allowed to see.
+            for (const unsigned excludeKernel : {0U, 1U}) {
+                attr.exclude_kernel = excludeKernel;
+                const long fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+                if (fd >= 0) {
+                    return static_cast<int>(fd);
+                }
+                if (errno != EACCES && errno != EPERM) {
+                    break;
+                }
+            }
+            return -1;
+        }
+
+        /**
+         * @brief Opens the hardware group, or the software fallback when there is no usable PMU.
+         */
+        static inline bool openPerfCounterGroup(PerfCounterGroup& group) noexcept {
+            constexpr std::pair<std::uint32_t, std::uint64_t> hardwareEvents[] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+                {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+            };
+            const auto openAll = [&group](const std::pair<std::uint32_t, std::uint64_t>* events, std::size_t n) noexcept {
+                for (std::size_t i = 0U; i < n; ++i) {
+                    const int fd = openPerfEvent(events[i].first, events[i].second, group.count == 0U ? -1 : group.fds[0]);
+                    if (fd < 0) {
+                        group.reset();
+                        return false;
+                    }
+                    group.fds[group.count++] = fd;
+                }
+                return true;
+            };
+            if (openAll(hardwareEvents, 6U)) {
+                group.hardware = true;
+            } else if (!openAll(hardwareEvents + 4, 2U)) {
+                return false;
+            }
+            group.state = PerfCounterGroup::State::Open;
+            return true;
+        }
+#endif
+
+        /**
+         * @brief Reads the calling thread's counters into out; false when perf is unavailable.
+         *
+         * Uses one read() of the whole group rather than rdpmc: rdpmc needs a
+         * mapped page per counter and is x86-only, while the group read is
+         * portable and returns every event in a single system call. The raw
+         * counts and the group's enabled/running times are returned unscaled;
+         * finishPerfCounters() scales the deltas.
+         */
+        static inline bool readPerfCounters(PerfCounts& out) noexcept {
+#if defined(SCOPE_TIMER_HAS_PERF_EVENTS)
+            auto& group = perfCounterGroup();
+            if (group.state == PerfCounterGroup::State::Unopened && !openPerfCounterGroup(group)) {
+                group.state = PerfCounterGroup::State::Failed;
+            }
+            if (group.state != PerfCounterGroup::State::Open) {
+                return false;
+            }
+            // Layout: nr, time_enabled, time_running, then one value per event.
+            std::uint64_t values[3U + PerfCounterGroup::MaxEvents]{};
+            const ssize_t got = ::read(group.fds[0], values, sizeof(values));
+            if (got < static_cast<ssize_t>(sizeof(std::uint64_t) * (3U + group.count)) || values[0] != group.count) {
+                return false;
+            }
+            const std::uint64_t* v = values + 3;
+            out = PerfCounts{};
+            out.timeEnabledNs = values[1];
+            out.timeRunningNs = values[2];
+            out.hardware = group.hardware;
+            if (group.hardware) {
+                out.instructions = v[0];
+                out.cycles = v[1];
+                out.cacheMisses = v[2];
+                out.branchMisses = v[3];
+                v += 4;
+            }
+            out.contextSwitches = v[0];
+            out.pageFaults = v[1];
+            return true;
+#else
+            (void)out;
+            return false;
+#endif
+        }
+
+        /**
+         * @brief Replaces every raw value x in perf with now - x; false if the read failed.
+         */
+        static inline bool flipPerfCounters(PerfCounts& perf) noexcept {
+            PerfCounts now;
+            if (!readPerfCounters(now)) {
+                return false;
+            }
+            perf.instructions = now.instructions - perf.instructions;
+            perf.cycles = now.cycles - perf.cycles;
+            perf.cacheMisses = now.cacheMisses - perf.cacheMisses;
+            perf.branchMisses = now.branchMisses - perf.branchMisses;
+            perf.contextSwitches = now.contextSwitches - perf.contextSwitches;
+            perf.pageFaults = now.pageFaults - perf.pageFaults;
+            perf.timeEnabledNs = now.timeEnabledNs - perf.timeEnabledNs;
+            perf.timeRunningNs = now.timeRunningNs - perf.timeRunningNs;
+            return true;
+        }
+
+        /**
+         * @brief Turns the start values in perf into deltas; false if the end read failed.
+         *
+         * When other perf users forced the kernel to multiplex the group, the
+         * deltas are scaled by the enabled/running ratio over the scope, as
+         * perf stat does. A group that never ran during the scope has no
+         * usable counts and is reported as unavailable.
+         */
+        static inline bool finishPerfCounters(PerfCounts& perf) noexcept {
+            if (!flipPerfCounters(perf)) {
+                return false;
+            }
+            const std::uint64_t enabled = perf.timeEnabledNs;
+            const std::uint64_t running = perf.timeRunningNs;
+            if (running >= enabled) {
+                return true;
+            }
+            if (running == 0U) {
+                return false;
+            }
+            const double scale = static_cast<double>(enabled) / static_cast<double>(running);
+            for (std::uint64_t* count : {&perf.instructions, &perf.cycles, &perf.cacheMisses,
+                                         &perf.branchMisses, &perf.contextSwitches, &perf.pageFaults}) {
+                *count = static_cast<std::uint64_t>(static_cast<double>(*count) * scale);
+            }
+            return true;
+        }
+
+        /**
+         * @brief Reads the calling thread's fault and context-switch counts; false when unsupported.
+         *
+         * RUSAGE_THREAD is Linux-specific. A getrusage() call costs a system
+         * call, so only SCOPE_TIMER_RUSAGE callsites pay for it.
+         */
+        static inline bool readResourceUsage(ResourceUsage& out) noexcept {
+#if defined(RUSAGE_THREAD)
+            rusage usage{};
+            if (::getrusage(RUSAGE_THREAD, &usage) != 0) {
+                return false;
+            }
+            out.minorFaults = usage.ru_minflt;
+            out.majorFaults = usage.ru_majflt;
+            out.voluntarySwitches = usage.ru_nvcsw;
+            out.involuntarySwitches = usage.ru_nivcsw;
+            return true;
+#else
+            (void)out;
+            return false;
+#endif
+        }
+
+        /**
+         * @brief Turns the start values in usage into deltas; false if the end read failed.
+         */
+        static inline bool finishResourceUsage(ResourceUsage& usage) noexcept {
+            ResourceUsage now;
+            if (!readResourceUsage(now)) {
+                return false;
+            }
+            usage.minorFaults = now.minorFaults - usage.minorFaults;
+            usage.majorFaults = now.majorFaults - usage.majorFaults;
+            usage.voluntarySwitches = now.voluntarySwitches - usage.voluntarySwitches;
+            usage.involuntarySwitches = now.involuntarySwitches - usage.involuntarySwitches;
+            return true;
+        }
+
+        /**
+         * @brief Retrieves a unique thread ID number in a lock-free manner.
+         *
+         * Uses thread_local storage to cache the thread ID, and an atomic counter
+         * to assign unique IDs starting from 1.
+         *
+         * @return uint32_t The unique thread ID number.
+         */
+        static inline uint32_t getThreadIdNumber() noexcept {
+            thread_local uint32_t tid = 0;
+
+            if(tid == 0) {
+                static std::atomic<uint32_t> next{ 1 };
+                // Only uniqueness matters here; callers do not depend on any cross-thread
+                // ordering relationship with the assigned numeric IDs.
+                tid = next.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            return tid;
+        }
+
+        /**
+         * @brief Returns the periodic flush interval for the ScopeTimer log.
+         *
+         * Controlled by the environment variable `SCOPE_TIMER_FLUSH_N`.
+         * If unset, non-numeric, or <= 0, defaults to 4096. Parsed once and cached.
+         *
+         * @return unsigned The number of lines between flushes.
+         */
+        static inline unsigned flushInterval() noexcept {
+            static const auto interval = []() noexcept {
+                if (const auto* p = std::getenv("SCOPE_TIMER_FLUSH_N")) {
+                    auto* end = static_cast<char*>(nullptr);
+                    const auto v = std::strtoul(p, &end, 10);
+
+                    if (end != p && *end == '\0' && v > 0UL && v <= 1000000UL) {
+                        return static_cast<unsigned>(v);
+                    }
+                }
+                return 4096U; // default
+            }();
+            return interval;
+        }
+
+        /**
+         * @brief Resolves the log directory from environment overrides.
+         *
+         * Controlled solely by SCOPE_TIMER_DIR; defaults to /tmp when unset/empty.
+         */
+        static inline const std::string& logDirectory() {
+            if (!logDirInitialized_) {
+                resetLogDirectoryForTests();
+                logDirInitialized_ = true;
+            }
+            return logDirCache_;
+        }
+
+        static inline void resetLogDirectoryForTests(std::string_view newDir = {}) {
+            std::string normalized;
+            if (!newDir.empty()) {
+                normalized.assign(newDir.begin(), newDir.end());
+            } else {
+                if (const char* primary = std::getenv("SCOPE_TIMER_DIR"); primary && *primary) {
+                    normalized = primary;
+                }
+            }
+            if (normalized.empty()) {
+                normalized = "/tmp";
+            }
+            if (!normalized.empty() && normalized.back() != '/') {
+                normalized.push_back('/');
+            }
+            logDirCache_ = std::move(normalized);
+            logDirInitialized_ = true;
+        }
+
+        // One-time-selected elapsed-time formatter infrastructure
+        // I call through a cached function pointer to avoid branching in the hot path.
+        enum class TimeFormat { Auto, Seconds, Millis, Micros, Nanos };
+        using FormatterFn = std::size_t(*)(long long ns, char* out, size_t outSz) noexcept;
+
+        static inline bool fillLocalTime(std::tm& tm, const std::time_t& tt) noexcept {
+#if defined(_WIN32) && defined(_MSC_VER)
+            return ::localtime_s(&tm, &tt) == 0;
+#elif defined(_WIN32)
+            std::lock_guard lock(localtimeMutex());
+            if (std::tm* local = std::localtime(&tt)) {
+                tm = *local;
+                return true;
+            }
+            return false;
+#else
+            return ::localtime_r(&tt, &tm) != nullptr;
+#endif
+        }
+
+        static inline bool appendFixedDigits(char*& out, const char* end, unsigned value, unsigned width) noexcept {
+            constexpr unsigned MaxFixedDigitWidth = 10U;
+            if (width > MaxFixedDigitWidth || static_cast<std::size_t>(end - out) < width) {
+                return false;
+            }
+
+            if (width == 2U) {
+                out[0] = static_cast<char>('0' + ((value / 10U) % 10U));
+                out[1] = static_cast<char>('0' + (value % 10U));
+                out += 2U;
+                return true;
+            }
+
+            if (width == 4U) {
+                out[0] = static_cast<char>('0' + ((value / 1000U) % 10U));
+                out[1] = static_cast<char>('0' + ((value / 100U) % 10U));
+                out[2] = static_cast<char>('0' + ((value / 10U) % 10U));
+                out[3] = static_cast<char>('0' + (value % 10U));
+                out += 4U;
+                return true;
+            }
+
+            for (unsigned i = width; i > 0U; --i) {
+                out[i - 1U] = static_cast<char>('0' + (value % 10U));
+                value /= 10U;
+            }
+            out += width;
+            return true;
+        }
+
+        /**
+         * @brief Elapsed time formatters selected once for speed.
+         *
+         * Each formatter accepts elapsed nanoseconds and writes a formatted
+         * string into the provided buffer. The active formatter is chosen once
+         * from the SCOPE_TIMER_FORMAT environment variable and cached via a
+         * function pointer to avoid branching in the hot path.
+         */
+        static inline std::size_t fmtSeconds(long long ns, char* out, size_t outSz) noexcept {
+            const long long sec   = ns / 1000000000LL;
+            const auto remMs = static_cast<unsigned>((ns / 1000000LL) % 1000LL); // 3 decimals
+            return formatElapsedImpl(static_cast<unsigned long long>(sec), remMs, 's', out, outSz);
+        }
+
+        static inline std::size_t fmtMillis(long long ns, char* out, size_t outSz) noexcept {
+            const long long ms    = ns / 1000000LL;
+            const auto remUs = static_cast<unsigned>((ns / 1000LL) % 1000LL);   // 3 decimals for ms
+            return formatElapsedImpl(static_cast<unsigned long long>(ms), remUs, 'm', out, outSz); // suffix handled inside
+        }
+
+        static inline std::size_t fmtMicros(long long ns, char* out, size_t outSz) noexcept {
+            const long long us    = ns / 1000LL;
+            const auto remNs = static_cast<unsigned>(ns % 1000LL); // nanoseconds remainder
+            return formatElapsedImpl(static_cast<unsigned long long>(us), remNs, 'u', out, outSz); // suffix handled inside
+        }
+
+        static inline std::size_t fmtNanos(long long ns, char* out, size_t outSz) noexcept {
+            char* cur = out;
+            const char* end = out + outSz;
+            if (auto* next = appendUnsignedToBuffer(cur, end, static_cast<unsigned long long>(ns)); next) {
+                cur = next;
+                (void)appendStrToBuffer(cur, end, "ns", 2);
+            }
+            if (cur < end) {
+                *cur = '\0';
+            } else if (outSz) {
+                out[outSz - 1] = '\0';
+            }
+            return static_cast<std::size_t>(cur - out);
+        }
+
+        /**
+         * @brief Automatic elapsed time formatter.
+         *
+         * Selects the most appropriate unit: seconds (>=1s), milliseconds (>=1ms), microseconds (>=1us), or nanoseconds (<1us).
+         * For explicit microseconds, use SCOPE_TIMER_FORMAT=MICROS.
+         */
+        static inline std::size_t fmtAuto(long long ns, char* out, size_t outSz) noexcept {
+            if (ns >= 1000000000LL) {
+                return fmtSeconds(ns, out, outSz);
+            }
+            if (ns >= 1000000LL) {
+                return fmtMillis(ns, out, outSz);
+            }
+            if (ns >= 1000LL) {
+                return fmtMicros(ns, out, outSz);
+            }
+            return fmtNanos(ns, out, outSz);
+        }
+
+        /**
+         * @brief One-time initialization of the elapsed-time formatter.
+         *
+         * Reads SCOPE_TIMER_FORMAT (case-insensitive). If it matches
+         * SECONDS/MILLIS/MICROS/NANOS, picks the corresponding formatter; otherwise
+         * defaults to the auto formatter.
+         */
+        static inline FormatterFn initFormatter() noexcept {
+            if (const char* env = std::getenv("SCOPE_TIMER_FORMAT"); env && *env) {
+                std::string s(env);
+                std::transform(s.begin(), s.end(), s.begin(),
+                            [](unsigned char c){ return static_cast<char>(std::toupper(c)); });
+
+                if (s == "SECONDS") return &fmtSeconds;
+                if (s == "MILLIS")  return &fmtMillis;
+                if (s == "MICROS")  return &fmtMicros;
+                if (s == "NANOS")   return &fmtNanos;
+            }
+            return &fmtAuto;
+        }        
+
+        /**
+         * @brief Accessor for the cached formatter function pointer.
+         *
+         * This ensures I pay the environment parsing cost once; no per-call branching
+         * occurs on the hot path - I just call through the function pointer.
+         */
+        static inline FormatterFn& getFormatter() noexcept {
+            static FormatterFn fn = initFormatter();
+            return fn;
+        }
+
+        /**
+         * @brief Wall timestamp formatters, selected once from SCOPE_TIMER_TIMESTAMP.
+         *
+         * Each accepts nanoseconds since the Unix epoch. Only fmtLocalTime()
+         * consults the C library; the UTC and epoch forms are pure integer
+         * arithmetic and need no lock on any platform.
+         */
+        using TimestampFn = std::size_t(*)(std::int64_t wallNs, char* out, size_t outSz) noexcept;
+
+        static constexpr std::int64_t NanosPerSecond = 1'000'000'000;
+        static constexpr std::int64_t SecondsPerDay = 86'400;
+
+        static constexpr std::int64_t floorDiv(std::int64_t value, std::int64_t divisor) noexcept {
+            return value / divisor - ((value % divisor) < 0 ? 1 : 0);
+        }
+
+        struct CivilDate {
+            std::int64_t year;
+            unsigned month;
+            unsigned day;
+        };
+
+        /**
+         * @brief Proleptic Gregorian date for a count of days since 1970-01-01.
+         *
+         * Howard Hinnant's civil_from_days(): shifts the year to start in March so
+         * the leap day falls last, then splits into 400-year eras.
+         */
+        static constexpr CivilDate civilFromDays(std::int64_t days) noexcept {
+            days += 719'468;
+            const std::int64_t era = floorDiv(days, 146'097);
+            const auto dayOfEra = static_cast<unsigned>(days - era * 146'097);
+            const unsigned yearOfEra = (dayOfEra - dayOfEra / 1'460 + dayOfEra / 36'524 - dayOfEra / 146'096) / 365;
+            const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+            const unsigned monthIndex = (5 * dayOfYear + 2) / 153;
+            const unsigned day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+            const unsigned month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+            return CivilDate{static_cast<std::int64_t>(yearOfEra) + era * 400 + (month <= 2 ? 1 : 0), month, day};
+        }
+
+        /**
+         * @brief "YYYY-MM-DDTHH:MM:SS.<fraction>Z" with FractionDigits (6 or 9) sub-second digits.
+         */
+        template <unsigned FractionDigits>
+        static inline std::size_t fmtUtc(std::int64_t wallNs, char* out, size_t outSz) noexcept {
+            static_assert(FractionDigits == 6U || FractionDigits == 9U, "UTC timestamps carry micro- or nanoseconds");
+            if (outSz == 0) {
+                return 0;
+            }
+            const std::int64_t seconds = floorDiv(wallNs, NanosPerSecond);
+            const auto fractionNs = static_cast<unsigned>(wallNs - seconds * NanosPerSecond);
+            const std::int64_t days = floorDiv(seconds, SecondsPerDay);
+            const auto secondOfDay = static_cast<unsigned>(seconds - days * SecondsPerDay);
+            const CivilDate date = civilFromDays(days);
+            const unsigned fraction = FractionDigits == 6U ? fractionNs / 1'000U : fractionNs;
+
+            char* cur = out;
+            const char* end = out + outSz - 1U;
+            if (date.year < 0 || date.year > 9'999 ||
+                !appendFixedDigits(cur, end, static_cast<unsigned>(date.year), 4) ||
+                !appendCharToBuffer(cur, end, '-') ||
+                !appendFixedDigits(cur, end, date.month, 2) ||
+                !appendCharToBuffer(cur, end, '-') ||
+                !appendFixedDigits(cur, end, date.day, 2) ||
+                !appendCharToBuffer(cur, end, 'T') ||
+                !appendFixedDigits(cur, end, secondOfDay / 3'600U, 2) ||
+                !appendCharToBuffer(cur, end, ':') ||
+                !appendFixedDigits(cur, end, (secondOfDay / 60U) % 60U, 2) ||
+                !appendCharToBuffer(cur, end, ':') ||
+                !appendFixedDigits(cur, end, secondOfDay % 60U, 2) ||
+                !appendCharToBuffer(cur, end, '.') ||
+                !appendFixedDigits(cur, end, fraction, FractionDigits) ||
+                !appendCharToBuffer(cur, end, 'Z')) {
+                out[0] = '\0';
+                return 0;
+            }
+            *cur = '\0';
+            return static_cast<std::size_t>(cur - out);
+        }
+
+        static inline std::size_t fmtUtcMicros(std::int64_t wallNs, char* out, size_t outSz) noexcept {
+            return fmtUtc<6U>(wallNs, out, outSz);
+        }
+
+        static inline std::size_t fmtUtcNanos(std::int64_t wallNs, char* out, size_t outSz) noexcept {
+            return fmtUtc<9U>(wallNs, out, outSz);
+        }
+
+        static inline std::size_t fmtEpochNanos(std::int64_t wallNs, char* out, size_t outSz) noexcept {
+            if (outSz == 0) {
+                return 0;
+            }
+            const auto result = std::to_chars(out, out + outSz - 1U, wallNs);
+            if (result.ec != std::errc{}) {
+                out[0] = '\0';
+                return 0;
+            }
+            *result.ptr = '\0';
+            return static_cast<std::size_t>(result.ptr - out);
+        }
+
+        /**
+         * @brief Maps a SCOPE_TIMER_TIMESTAMP value to its formatter; unset or unknown means LOCAL.
+         */
+        static inline TimestampFn timestampFormatterFromSetting(const char* env) {
+            const std::string s = normalizeBooleanSetting(env);
+            if (s == "UTC" || s == "UTC_MICROS") return &fmtUtcMicros;
+            if (s == "UTC_NANOS")                return &fmtUtcNanos;
+            if (s == "EPOCH" || s == "EPOCH_NANOS") return &fmtEpochNanos;
+            return &fmtLocalTime;
+        }
+
+        static inline TimestampFn getTimestampFormatter() noexcept {
+            static const TimestampFn fn = timestampFormatterFromSetting(std::getenv("SCOPE_TIMER_TIMESTAMP"));
+            return fn;
+        }
+
+        // Small helpers for fast formatting (avoid snprintf).
+        static inline char* appendUnsignedToBuffer(char* out, const char* end, unsigned long long v) noexcept {
+            std::array<char, 32> tmp{};
+            int pos = 0;
+            do {
+                tmp[static_cast<std::size_t>(pos)] = static_cast<char>('0' + (v % 10ULL));
+                ++pos;
+                v /= 10ULL;
+            } while (v && pos < static_cast<int>(tmp.size()));
+            if (static_cast<std::size_t>(end - out) < static_cast<std::size_t>(pos)) {
+                return nullptr;
+            }
+            while (pos--) {
+                *out++ = tmp[static_cast<std::size_t>(pos)];
+            }
+            return out;
+        }
+
+        static inline char* appendThreeDigitsToBuffer(char* out, const char* end, unsigned v) noexcept {
+            const std::array<char, 3> digits{
+                static_cast<char>('0' + ((v / 100U) % 10U)),
+                static_cast<char>('0' + ((v / 10U) % 10U)),
+                static_cast<char>('0' + (v % 10U))
+            };
+            if (static_cast<std::size_t>(end - out) < digits.size()) {
+                return nullptr;
+            }
+            std::memcpy(out, digits.data(), digits.size());
+            return out + digits.size();
+        }
+
+        static inline bool appendCharToBuffer(char*& out, const char* end, char c) noexcept {
+            if (out >= end) return false;
+            *out++ = c;
+            return true;
+        }
+
+        static inline bool appendStrToBuffer(char*& out, const char* end, const char* s, std::size_t n) noexcept {
+            if (static_cast<std::size_t>(end - out) < n) return false;
+            std::memcpy(out, s, n);
+            out += n;
+            return true;
+        }
+
+        static inline std::size_t formatElapsedImpl(unsigned long long whole, unsigned frac3, char unit, char* out, size_t outSz) noexcept {
+            char* cur = out;
+            const char* end = out + outSz;
+
+            if (auto* next = appendUnsignedToBuffer(cur, end, whole)) {
+                cur = next;
+            } else {
+                if (outSz) out[0] = '\0';
+                return 0;
+            }
+
+            if (!appendCharToBuffer(cur, end, '.')) {
+                if (outSz) {
+                    out[0] = '\0';
+                }
+                return 0;
+            }
+
+            if (auto* next = appendThreeDigitsToBuffer(cur, end, frac3)) {
+                cur = next;
+            } else {
+                if (outSz) out[0] = '\0';
+                return 0;
+            }
+
+            const char suffix1 = unit;
+            const char suffix2 = (unit == 's') ? '\0' : 's'; // "s" for seconds, "ms"/"us"
+            if (!appendCharToBuffer(cur, end, suffix1)) {
+                if (outSz) {
+                    out[0] = '\0';
+                }
+                return 0;
+            }
+            if (suffix2 && !appendCharToBuffer(cur, end, suffix2)) {
+                if (outSz) {
+                    out[0] = '\0';
+                }
+                return 0;
+            }
+
+            if (cur < end) {
+                *cur = '\0';
+            } else if (outSz) {
+                out[outSz - 1] = '\0';
+            }
+            return static_cast<std::size_t>(cur - out);
+        }
+
+        /**
+         * @brief Formats elapsed time using a one-time-selected formatter.
+         *
+         * The formatter is chosen once from SCOPE_TIMER_FORMAT ("SECONDS" | "MILLIS" | "NANOS"),
+         * defaulting to automatic behavior if unset/invalid.
+         *
+         * @param ns   Elapsed time in nanoseconds.
+         * @param out  Output buffer.
+         * @param outSz Size of the output buffer.
+         */
+        static inline std::size_t formatElapsed(long long ns, char* out, size_t outSz) noexcept {
+            return getFormatter()(ns, out, outSz);
+        }
+
+        static inline std::size_t formatElapsedNanos(long long ns, char* out, size_t outSz) noexcept {
+            return fmtNanos(ns, out, outSz);
+        }
+
+        static inline void appendBytesTruncating(char*& out, const char* end, const char* s, std::size_t n) noexcept {
+            if (n == 0 || out >= end) {
+                return;
+            }
+            const auto available = static_cast<std::size_t>(end - out);
+            const auto toCopy = std::min(available, n);
+            std::memcpy(out, s, toCopy);
+            out += toCopy;
+        }
+
+        static inline void appendCharTruncating(char*& out, const char* end, char c) noexcept {
+            if (out < end) {
+                *out++ = c;
+            }
+        }
+
+        /**
+         * @brief Process-wide system_clock minus steady_clock offset, in nanoseconds.
+         *
+         * Timers keep only their steady stamps. Wall times are derived from them
+         * with this offset when a line or record is produced, which saves two
+         * clock reads and a formatting pass per timer. The offset is re-read at
+         * most once a second, so a wall-clock step shows up within a second.
+         */
+        struct WallClockAnchor {
+            std::atomic<std::int64_t> offsetNs{0};
+            std::atomic<std::int64_t> refreshedSteadyNs{std::numeric_limits<std::int64_t>::min()};
+        };
+        static constexpr std::int64_t WallClockAnchorRefreshNs = 1'000'000'000;
+
+        static inline WallClockAnchor& wallClockAnchor() noexcept {
+            return detail::singletonStorage<detail::WallClockAnchorTag, WallClockAnchor>();
+        }
+
+        static inline std::int64_t steadyNs(std::chrono::steady_clock::time_point tp) noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+        }
+
+        static inline std::chrono::system_clock::time_point wallTimeFromNs(std::int64_t ns) noexcept {
+            return std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
+        }
+
+        /**
+         * @brief Returns the offset to add to steady nanoseconds, refreshing it when stale at @p nowSteadyNs.
+         *
+         * Callers convert both ends of a scope with one offset so end - start equals elapsed.
+         */
+        static inline std::int64_t wallClockOffsetNs(std::int64_t nowSteadyNs) noexcept {
+            auto& anchor = wallClockAnchor();
+            const std::int64_t refreshed = anchor.refreshedSteadyNs.load(std::memory_order_acquire);
+            if (refreshed != std::numeric_limits<std::int64_t>::min()
+                && nowSteadyNs - refreshed <= WallClockAnchorRefreshNs) {
+                return anchor.offsetNs.load(std::memory_order_relaxed);
+            }
+            // Racing refreshes are harmless: each stores a valid offset.
+            const std::int64_t steadyNow = steadyNs(std::chrono::steady_clock::now());
+            const std::int64_t offset =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+                - steadyNow;
+            anchor.offsetNs.store(offset, std::memory_order_relaxed);
+            anchor.refreshedSteadyNs.store(steadyNow, std::memory_order_release);
+            return offset;
+        }
+
+        /**
+         * @brief Formats a system_clock time_point in the SCOPE_TIMER_TIMESTAMP style.
+         */
+        static inline std::size_t formatTime(std::chrono::system_clock::time_point tp, char* out, size_t outSz) noexcept {
+            return getTimestampFormatter()(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count(), out, outSz);
+        }
+
+        /**
+         * @brief Formats epoch nanoseconds as local time, "YYYY-MM-DD HH:MM:SS.mmm".
+         *
+         * The calendar portion is cached per-thread for the current second.
+         */
+        static inline std::size_t fmtLocalTime(std::int64_t wallNs, char* out, size_t outSz) noexcept {
+            if (outSz == 0) {
+                return 0;
+            }
+
+            const auto tt = static_cast<std::time_t>(floorDiv(wallNs, NanosPerSecond));
+            const auto ms3 = static_cast<unsigned>(floorDiv(wallNs, 1'000'000) - static_cast<std::int64_t>(tt) * 1'000);
+
+            struct TimestampPrefixCache {
+                std::time_t second{-1};
+                std::array<char, 20> prefix{};
+                std::uint8_t len{0};
+            };
+            thread_local TimestampPrefixCache cache;
+
+            if (cache.second != tt) {
+                auto tm = std::tm{};
+                if (!fillLocalTime(tm, tt)) {
+                    out[0] = '\0';
+                    return 0;
+                }
+
+                char* prefixOut = cache.prefix.data();
+                if (const char* prefixEnd = cache.prefix.data() + cache.prefix.size() - 1U;
+                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(1900 + tm.tm_year), 4) ||
+                    !appendCharToBuffer(prefixOut, prefixEnd, '-') ||
+                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(1 + tm.tm_mon), 2) ||
+                    !appendCharToBuffer(prefixOut, prefixEnd, '-') ||
+                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_mday), 2) ||
+                    !appendCharToBuffer(prefixOut, prefixEnd, ' ') ||
+                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_hour), 2) ||
+                    !appendCharToBuffer(prefixOut, prefixEnd, ':') ||
+                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_min), 2) ||
+                    !appendCharToBuffer(prefixOut, prefixEnd, ':') ||
+                    !appendFixedDigits(prefixOut, prefixEnd, static_cast<unsigned>(tm.tm_sec), 2)) {
+                    out[0] = '\0';
+                    return 0;
+                }
+                *prefixOut = '\0';
+                cache.second = tt;
+                cache.len = static_cast<std::uint8_t>(prefixOut - cache.prefix.data());
+            }
+
+            char* cur = out;
+            const char* end = out + outSz - 1U;
+            appendBytesTruncating(cur, end, cache.prefix.data(), cache.len);
+            appendCharTruncating(cur, end, '.');
+            if (auto* next = appendThreeDigitsToBuffer(cur, end, ms3)) {
+                cur = next;
+            }
+            *cur = '\0';
+            return static_cast<std::size_t>(cur - out);
+        }
+
+        static inline void appendUnsignedTruncating(char*& out, const char* end, unsigned long long v) noexcept {
+            std::array<char, 32> tmp{};
+            const auto result = std::to_chars(tmp.data(), tmp.data() + tmp.size(), v);
+            if (result.ec != std::errc{}) {
+                return;
+            }
+            appendBytesTruncating(out, end, tmp.data(), static_cast<std::size_t>(result.ptr - tmp.data()));
+        }
+
+        /**
+         * @brief Appends the perf counter fields; IPC is printed with two decimals.
+         */
+        static inline void appendPerfCountsTruncating(char*& out, const char* end, const PerfCounts& perf) noexcept {
+            if (perf.hardware) {
+                appendBytesTruncating(out, end, " | instr=", sizeof(" | instr=") - 1U);
+                appendUnsignedTruncating(out, end, perf.instructions);
+                appendBytesTruncating(out, end, " | cycles=", sizeof(" | cycles=") - 1U);
+                appendUnsignedTruncating(out, end, perf.cycles);
+                if (perf.cycles != 0U) {
+                    const unsigned long long ipc100 = (perf.instructions * 100U + perf.cycles / 2U) / perf.cycles;
+                    appendBytesTruncating(out, end, " | ipc=", sizeof(" | ipc=") - 1U);
+                    appendUnsignedTruncating(out, end, ipc100 / 100U);
+                    appendCharTruncating(out, end, '.');
+                    appendCharTruncating(out, end, static_cast<char>('0' + (ipc100 / 10U) % 10U));
+                    appendCharTruncating(out, end, static_cast<char>('0' + ipc100 % 10U));
+                }
+                appendBytesTruncating(out, end, " | cache-miss=", sizeof(" | cache-miss=") - 1U);
+                appendUnsignedTruncating(out, end, perf.cacheMisses);
+                appendBytesTruncating(out, end, " | branch-miss=", sizeof(" | branch-miss=") - 1U);
+                appendUnsignedTruncating(out, end, perf.branchMisses);
+            }
+            appendBytesTruncating(out, end, " | ctx-sw=", sizeof(" | ctx-sw=") - 1U);
+            appendUnsignedTruncating(out, end, perf.contextSwitches);
+            appendBytesTruncating(out, end, " | page-faults=", sizeof(" | page-faults=") - 1U);
+            appendUnsignedTruncating(out, end, perf.pageFaults);
+        }
+
+        /**
+         * @brief Appends the resource usage fields, named after their struct rusage members.
+         */
+        static inline void appendResourceUsageTruncating(char*& out, const char* end, const ResourceUsage& usage) noexcept {
+            const auto appendField = [&out, end](const char* name, std::size_t nameLen, std::int64_t value) noexcept {
+                appendBytesTruncating(out, end, name, nameLen);
+                appendUnsignedTruncating(out, end, static_cast<unsigned long long>(std::max<std::int64_t>(0, value)));
+            };
+            appendField(" | minflt=", sizeof(" | minflt=") - 1U, usage.minorFaults);
+            appendField(" | majflt=", sizeof(" | majflt=") - 1U, usage.majorFaults);
+            appendField(" | nvcsw=", sizeof(" | nvcsw=") - 1U, usage.voluntarySwitches);
+            appendField(" | nivcsw=", sizeof(" | nivcsw=") - 1U, usage.involuntarySwitches);
+        }
+
+        /**
+         * @brief Appends one ` | lap:<name>=<split>` field per lap, then laps-dropped= on overflow.
+         */
+        static inline void appendLapsTruncating(char*& out, const char* end, const LapSplits& laps) noexcept {
+            char value[32];
+            for (std::uint32_t i = 0U; i < laps.count; ++i) {
+                const LapSplit& lap = laps.splits[i];
+                appendBytesTruncating(out, end, " | lap:", sizeof(" | lap:") - 1U);
+                appendBytesTruncating(out, end, lap.name.data(), lap.name.size());
+                appendCharTruncating(out, end, '=');
+                appendBytesTruncating(out, end, value, formatElapsed(lap.ns, value, sizeof(value)));
+            }
+            if (laps.dropped != 0U) {
+                appendBytesTruncating(out, end, " | laps-dropped=", sizeof(" | laps-dropped=") - 1U);
+                appendUnsignedTruncating(out, end, laps.dropped);
+            }
+        }
+
+        /**
+         * @brief Appends iterations= and iter-mean=, then the sampled iteration times when there are any.
+         */
+        static inline void appendLoopStatsTruncating(char*& out, const char* end, const LoopStats& loop) noexcept {
+            char value[32];
+            const auto appendDuration = [&out, end, &value](const char* name, std::size_t nameLen, std::int64_t ns) noexcept {
+                appendBytesTruncating(out, end, name, nameLen);
+                appendBytesTruncating(out, end, value, formatElapsed(ns, value, sizeof(value)));
+            };
+            appendBytesTruncating(out, end, " | iterations=", sizeof(" | iterations=") - 1U);
+            appendUnsignedTruncating(out, end, loop.iterations);
+            appendDuration(" | iter-mean=", sizeof(" | iter-mean=") - 1U, loop.meanNs);
+            if (loop.sampled == 0U) {
+                return;
+            }
+            appendBytesTruncating(out, end, " | sampled=", sizeof(" | sampled=") - 1U);
+            appendUnsignedTruncating(out, end, loop.sampled);
+            appendDuration(" | iter-min=", sizeof(" | iter-min=") - 1U, loop.minNs);
+            appendDuration(" | iter-p50=", sizeof(" | iter-p50=") - 1U, loop.p50Ns);
+            appendDuration(" | iter-p90=", sizeof(" | iter-p90=") - 1U, loop.p90Ns);
+            appendDuration(" | iter-p99=", sizeof(" | iter-p99=") - 1U, loop.p99Ns);
+            appendDuration(" | iter-max=", sizeof(" | iter-max=") - 1U, loop.maxNs);
+        }
+
+        static inline void appendThreadIdTruncating(char*& out, const char* end, unsigned tid) noexcept {
+            if (tid < 1000U) {
+                const std::array<char, 3> digits{
+                    static_cast<char>('0' + ((tid / 100U) % 10U)),
+                    static_cast<char>('0' + ((tid / 10U) % 10U)),
+                    static_cast<char>('0' + (tid % 10U))
+                };
+                appendBytesTruncating(out, end, digits.data(), digits.size());
+                return;
+            }
+            appendUnsignedTruncating(out, end, tid);
+        }
+
+        struct LogLineFields {
+            std::string_view label;
+            unsigned threadNum{0};
+            std::string_view where;
+            std::string_view startWall;
+            std::string_view endWall;
+            std::string_view elapsed;
+            bool wallTimeEnabled{false};
+            std::string_view cpu;    ///< Empty unless CPU time was captured.
+            std::string_view offCpu;
+            const PerfCounts* perf{nullptr}; ///< Null unless perf counters were captured.
+            const ResourceUsage* rusage{nullptr}; ///< Null unless resource usage was captured.
+            const AllocationCounts* allocations{nullptr}; ///< Null unless the allocation hooks are linked.
+            std::string_view active;    ///< Empty unless the timer is an AsyncScopeTimer.
+            std::string_view suspended;
+            std::uint32_t migrations{0U};
+            std::uint64_t correlationId{0U}; ///< Printed as corr= when non-zero.
+            const LapSplits* laps{nullptr}; ///< Null unless the timer is a LapScopeTimer.
+            const LoopStats* loop{nullptr}; ///< Null unless the timer is a LoopScopeTimer.
+            std::uint64_t suppressed{0U}; ///< Printed as suppressed= when non-zero.
+        };
+
+        static inline std::size_t buildLogLine(
+            char* out,
+            std::size_t outSz,
+            const LogLineFields& fields
+        ) noexcept {
+            if (outSz == 0) {
+                return 0;
+            }
+
+            char* cur = out;
+            const char* end = out + outSz - 1U; // reserve a byte for a terminator
+
+            appendCharTruncating(cur, end, '[');
+            appendBytesTruncating(cur, end, fields.label.data(), fields.label.size());
+            appendBytesTruncating(cur, end, "] TID=", sizeof("] TID=") - 1U);
+            appendThreadIdTruncating(cur, end, fields.threadNum);
+            appendBytesTruncating(cur, end, " | ", sizeof(" | ") - 1U);
+            appendBytesTruncating(cur, end, fields.where.data(), fields.where.size());
+            if (fields.wallTimeEnabled) {
+                appendBytesTruncating(cur, end, " | start=", sizeof(" | start=") - 1U);
+                appendBytesTruncating(cur, end, fields.startWall.data(), fields.startWall.size());
+                appendBytesTruncating(cur, end, " | end=", sizeof(" | end=") - 1U);
+                appendBytesTruncating(cur, end, fields.endWall.data(), fields.endWall.size());
+            }
+            appendBytesTruncating(cur, end, " | elapsed=", sizeof(" | elapsed=") - 1U);
+            appendBytesTruncating(cur, end, fields.elapsed.data(), fields.elapsed.size());
+            appendLogLineExtrasTruncating(cur, end, fields);
+            appendCharTruncating(cur, end, '\n');
+
+            *cur = '\0';
+            return static_cast<std::size_t>(cur - out);
+        }
+
+        /**
+         * @brief SCOPE_TIMER_LINE_FORMAT=COMPACT: tab-separated label, thread, callsite, start and elapsed.
+         *
+         * The callsite is "<file basename>:<line>" when the timer has a CallSite,
+         * start is epoch nanoseconds ("-" without wall time) and elapsed is
+         * integer nanoseconds. Opt-in fields keep their " | name=value" form.
+         */
+        static inline std::size_t buildCompactLogLine(
+            char* out,
+            std::size_t outSz,
+            const LogLineFields& fields,
+            const CallSite* site,
+            std::int64_t startWallNs,
+            long long elapsedNs
+        ) noexcept {
+            if (outSz == 0) {
+                return 0;
+            }
+
+            char* cur = out;
+            const char* end = out + outSz - 1U;
+
+            appendBytesTruncating(cur, end, fields.label.data(), fields.label.size());
+            appendCharTruncating(cur, end, '\t');
+            appendUnsignedTruncating(cur, end, fields.threadNum);
+            appendCharTruncating(cur, end, '\t');
+            if (site != nullptr && site->file != nullptr) {
+                const std::string_view file{site->file};
+                const std::size_t slash = file.find_last_of("/\\");
+                const std::string_view base = slash == std::string_view::npos ? file : file.substr(slash + 1U);
+                appendBytesTruncating(cur, end, base.data(), base.size());
+                appendCharTruncating(cur, end, ':');
+                appendUnsignedTruncating(cur, end, site->line);
+            } else {
+                appendBytesTruncating(cur, end, fields.where.data(), fields.where.size());
+            }
+            appendCharTruncating(cur, end, '\t');
+            if (fields.wallTimeEnabled) {
+                appendUnsignedTruncating(cur, end, static_cast<unsigned long long>(std::max<std::int64_t>(0, startWallNs)));
+            } else {
+                appendCharTruncating(cur, end, '-');
+            }
+            appendCharTruncating(cur, end, '\t');
+            appendUnsignedTruncating(cur, end, static_cast<unsigned long long>(std::max<long long>(0, elapsedNs)));
+            appendLogLineExtrasTruncating(cur, end, fields);
+            appendCharTruncating(cur, end, '\n');
+
+            *cur = '\0';
+            return static_cast<std::size_t>(cur - out);
+        }
+
+        /**
+         * @brief Appends the optional fields that follow elapsed in both line formats.
+         */
+        static inline void appendLogLineExtrasTruncating(char*& cur, const char* end, const LogLineFields& fields) noexcept {
+            if (fields.correlationId != 0U) {
+                appendBytesTruncating(cur, end, " | corr=", sizeof(" | corr=") - 1U);
+                appendUnsignedTruncating(cur, end, fields.correlationId);
+            }
+            if (fields.suppressed != 0U) {
+                appendBytesTruncating(cur, end, " | suppressed=", sizeof(" | suppressed=") - 1U);
+                appendUnsignedTruncating(cur, end, fields.suppressed);
+            }
+            if (fields.laps != nullptr) {
+                appendLapsTruncating(cur, end, *fields.laps);
+            }
+            if (fields.loop != nullptr) {
+                appendLoopStatsTruncating(cur, end, *fields.loop);
+            }
+            if (!fields.suspended.empty()) {
+                appendBytesTruncating(cur, end, " | active=", sizeof(" | active=") - 1U);
+                appendBytesTruncating(cur, end, fields.active.data(), fields.active.size());
+                appendBytesTruncating(cur, end, " | suspended=", sizeof(" | suspended=") - 1U);
+                appendBytesTruncating(cur, end, fields.suspended.data(), fields.suspended.size());
+                appendBytesTruncating(cur, end, " | migrations=", sizeof(" | migrations=") - 1U);
+                appendUnsignedTruncating(cur, end, fields.migrations);
+            }
+            if (!fields.cpu.empty()) {
+                appendBytesTruncating(cur, end, " | cpu=", sizeof(" | cpu=") - 1U);
+                appendBytesTruncating(cur, end, fields.cpu.data(), fields.cpu.size());
+                appendBytesTruncating(cur, end, " | offcpu=", sizeof(" | offcpu=") - 1U);
+                appendBytesTruncating(cur, end, fields.offCpu.data(), fields.offCpu.size());
+            }
+            if (fields.perf != nullptr) {
+                appendPerfCountsTruncating(cur, end, *fields.perf);
+            }
+            if (fields.rusage != nullptr) {
+                appendResourceUsageTruncating(cur, end, *fields.rusage);
+            }
+            if (fields.allocations != nullptr) {
+                appendBytesTruncating(cur, end, " | allocs=", sizeof(" | allocs=") - 1U);
+                appendUnsignedTruncating(cur, end, fields.allocations->count);
+                appendBytesTruncating(cur, end, " | alloc-bytes=", sizeof(" | alloc-bytes=") - 1U);
+                appendUnsignedTruncating(cur, end, fields.allocations->bytes);
+            }
+        }
+
+        static inline std::size_t buildHotPathLogLine(
+            char* out,
+            std::size_t outSz,
+            std::string_view label,
+            const char* elapsed,
+            std::size_t elapsedLen
+        ) noexcept {
+            if (outSz == 0) {
+                return 0;
+            }
+
+            char* cur = out;
+            const char* end = out + outSz - 1U;
+            appendCharTruncating(cur, end, '[');
+            appendBytesTruncating(cur, end, label.data(), label.size());
+            appendBytesTruncating(cur, end, "] elapsed=", sizeof("] elapsed=") - 1U);
+            appendBytesTruncating(cur, end, elapsed, elapsedLen);
+            appendCharTruncating(cur, end, '\n');
+
+            *cur = '\0';
+            return static_cast<std::size_t>(cur - out);
+        }
+
+        /**
+         * @brief Per-thread scratch space for formatted end/elapsed timestamps.
+         */
+        struct FormatBuffers {
+            char startBuf[32];
+            char endBuf[32];
+            char elapsedBuf[32];
+            std::uint8_t startLen;
+            std::uint8_t endLen;
+            std::uint8_t elapsedLen;
+        };
+
+        /**
+         * @brief Returns the thread-local formatting scratch space.
+         */
+        static inline FormatBuffers& formatBuffers() noexcept {
+            return tlsFormatBuffers_;
+        }
+
+        /**
+         * @brief Helper used by tests to ensure format buffers are reused.
+         */
+        static inline const char* endBufferAddressForTests() noexcept {
+            return formatBuffers().endBuf;
+        }
+
+        /**
+         * @brief Per-thread assembly buffer for the full log line.
+         */
+        struct LineBuffer {
+            char data[512];
+        };
+
+        /**
+         * @brief Accessor for the thread-local line assembly buffer.
+         */
+        static inline LineBuffer& lineBuffer() noexcept {
+            return tlsLineBuffer_;
+        }
+
+        /**
+         * @brief Formats this timer's record into the supplied buffer.
+         *
+         * The destination is either the per-thread line buffer or memory
+         * reserved directly inside a ReservingLogSink.
+         */
+        inline std::size_t renderLogLine(char* out, std::size_t outSz, long long elapsedNs) const noexcept {
+            auto& fmtBufs = formatBuffers();
+            if (hotPathMode_) {
+                fmtBufs.elapsedLen = static_cast<std::uint8_t>(formatElapsedNanos(elapsedNs, fmtBufs.elapsedBuf, sizeof(fmtBufs.elapsedBuf)));
+                return buildHotPathLogLine(out, outSz, label_, fmtBufs.elapsedBuf, fmtBufs.elapsedLen);
+            }
+
+            // Compact lines print raw nanoseconds, so they skip both formatting passes.
+            const bool compact = compactLines();
+            const bool wallTimeEnabled = includeWallTime();
+            std::int64_t startWallNs = 0;
+            fmtBufs.startLen = 0;
+            fmtBufs.endLen = 0;
+            fmtBufs.elapsedLen = 0;
+            if (wallTimeEnabled) {
+                const std::int64_t startNs = steadyNs(startSteady_);
+                startWallNs = startNs + wallClockOffsetNs(startNs + elapsedNs);
+                if (!compact) {
+                    fmtBufs.startLen = static_cast<std::uint8_t>(formatTime(wallTimeFromNs(startWallNs), fmtBufs.startBuf, sizeof(fmtBufs.startBuf)));
+                    fmtBufs.endLen = static_cast<std::uint8_t>(formatTime(wallTimeFromNs(startWallNs + elapsedNs), fmtBufs.endBuf, sizeof(fmtBufs.endBuf)));
+                }
+            }
+            if (!compact) {
+                fmtBufs.elapsedLen = static_cast<std::uint8_t>(formatElapsed(elapsedNs, fmtBufs.elapsedBuf, sizeof(fmtBufs.elapsedBuf)));
+            }
+
+            LogLineFields fields{
+                label_,
+                threadNum_,
+                where_,
+                std::string_view{fmtBufs.startBuf, fmtBufs.startLen},
+                std::string_view{fmtBufs.endBuf, fmtBufs.endLen},
+                std::string_view{fmtBufs.elapsedBuf, fmtBufs.elapsedLen},
+                wallTimeEnabled,
+                {},
+                {},
+                perfCounting_ ? &perf_ : nullptr,
+                rusageCounting_ ? &rusage_ : nullptr,
+                allocCounting_ ? &allocations_ : nullptr,
+                {},
+                {},
+                0U,
+                correlationId_,
+                laps_ != nullptr && laps_->count != 0U ? laps_ : nullptr,
+                loop_,
+                suppressed_
+            };
+            char cpuBuf[32];
+            char offCpuBuf[32];
+            if (cpuNs_ != NoCpuTime) {
+                fields.cpu = std::string_view{cpuBuf, formatElapsed(cpuNs_, cpuBuf, sizeof(cpuBuf))};
+                fields.offCpu = std::string_view{offCpuBuf, formatElapsed(std::max<long long>(0, elapsedNs - cpuNs_), offCpuBuf, sizeof(offCpuBuf))};
+            }
+            char activeBuf[32];
+            char suspendedBuf[32];
+            if (suspendedNs_ >= 0) {
+                fields.active = std::string_view{activeBuf, formatElapsed(std::max<long long>(0, elapsedNs - suspendedNs_), activeBuf, sizeof(activeBuf))};
+                fields.suspended = std::string_view{suspendedBuf, formatElapsed(suspendedNs_, suspendedBuf, sizeof(suspendedBuf))};
+                fields.migrations = migrations_;
+            }
+            if (compact) {
+                return buildCompactLogLine(out, outSz, fields, site_, startWallNs, elapsedNs);
+            }
+            return buildLogLine(out, outSz, fields);
+        }
+
+        /**
+         * @brief Formats straight into a reserving sink's memory (caller holds outMutex()).
+         *
+         * Falls back to the line buffer and write() when the sink declines the slot.
+         */
+        inline void writeToReservingSink(ReservingLogSink& sink, long long elapsedNs) const noexcept {
+            if (const SinkSpan span = sink.reserve(sizeof(LineBuffer::data)); span.data != nullptr && span.size != 0U) {
+                if (span.size >= sizeof(LineBuffer::data)) {
+                    sink.commit(renderLogLine(span.data, span.size, elapsedNs));
+                    return;
+                }
+                sink.commit(0U); // a short slot could truncate the line
+            }
+
+            auto& lineBuf = lineBuffer();
+            if (const std::size_t len = renderLogLine(lineBuf.data, sizeof(lineBuf.data), elapsedNs); len) {
+                sink.write(lineBuf.data, len);
+            }
+        }
+
+        /**
+         * @brief Builds the structured record for this timer and hands it to @p sink.
+         */
+        inline void deliverRecord(RecordSink& sink, std::chrono::steady_clock::time_point endSteady) const noexcept {
+            Record rec;
+            rec.site = site_;
+            rec.where = where_;
+            rec.label = label_;
+            rec.threadNum = threadNum_;
+            rec.startSteadyNs = steadyNs(startSteady_);
+            rec.endSteadyNs = steadyNs(endSteady);
+            rec.hotPath = hotPathMode_;
+            if (cpuNs_ != NoCpuTime) {
+                rec.hasCpuTime = true;
+                rec.cpuNs = cpuNs_;
+            }
+            if (perfCounting_) {
+                rec.hasPerfCounts = true;
+                rec.perf = perf_;
+            }
+            if (rusageCounting_) {
+                rec.hasResourceUsage = true;
+                rec.rusage = rusage_;
+            }
+            if (allocCounting_) {
+                rec.hasAllocations = true;
+                rec.allocations = allocations_;
+            }
+            rec.correlationId = correlationId_;
+            rec.suppressed = suppressed_;
+            if (laps_ != nullptr && laps_->count != 0U) {
+                rec.laps = laps_;
+            }
+            rec.loop = loop_;
+            if (suspendedNs_ >= 0) {
+                rec.hasSuspendedTime = true;
+                rec.suspendedNs = suspendedNs_;
+                rec.migrations = migrations_;
+            }
+            if (!hotPathMode_ && includeWallTime()) {
+                rec.hasWallTime = true;
+                const std::int64_t offsetNs = wallClockOffsetNs(rec.endSteadyNs);
+                rec.startWallNs = rec.startSteadyNs + offsetNs;
+                rec.endWallNs = rec.endSteadyNs + offsetNs;
+            }
+            sink.record(rec);
+        }
+
+        static inline std::atomic<RecordSink*>& recordSinkStorage() noexcept {
+            return detail::singletonStorage<detail::RecordSinkStorageTag, std::atomic<RecordSink*>>(nullptr);
+        }
+        static inline std::atomic<bool>& recordSinkExclusiveStorage() noexcept {
+            return detail::singletonStorage<detail::RecordSinkExclusiveStorageTag, std::atomic<bool>>(false);
+        }
+        static inline bool recordSinkIsExclusive() noexcept {
+            return recordSinkExclusiveStorage().load(std::memory_order_acquire);
+        }
+        static inline void setRecordSinkImpl(RecordSink* sink, RecordSinkMode mode) {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            if (auto* previous = recordSinkStorage().load(std::memory_order_acquire)) {
+                previous->flush();
+            }
+            recordSinkExclusiveStorage().store(sink != nullptr && mode == RecordSinkMode::Exclusive,
+                                               std::memory_order_release);
+            recordSinkStorage().store(sink, std::memory_order_release);
+        }
+
+        struct SinkRouteState {
+            SinkRoute route;
+            std::atomic<std::uint64_t> seen{0U};
+        };
+
+        struct SinkPipeline {
+            std::array<SinkRouteState, MaxSinkRoutes> routes{};
+            std::size_t count{0U};
+            std::uint32_t generation{0U};
+            bool hasTextRoutes{false};
+        };
+
+        static inline std::atomic<SinkPipeline*>& sinkPipelineStorage() noexcept {
+            return detail::singletonStorage<detail::SinkPipelineStorageTag, std::atomic<SinkPipeline*>>(nullptr);
+        }
+        static inline std::uint32_t& sinkPipelineGeneration() noexcept {
+            return detail::singletonStorage<detail::SinkPipelineGenerationTag, std::uint32_t>(0U);
+        }
+        static inline std::unique_ptr<SinkPipeline>& installedSinkPipeline() noexcept {
+            return detail::singletonStorage<detail::InstalledSinkPipelineTag, std::unique_ptr<SinkPipeline>>();
+        }
+        /// Replaced pipelines that a timer may still be reading; freed once no timer is delivering.
+        static inline std::vector<std::unique_ptr<SinkPipeline>>& retiredSinkPipelines() noexcept {
+            return detail::singletonStorage<detail::RetiredSinkPipelinesTag, std::vector<std::unique_ptr<SinkPipeline>>>();
+        }
+        /// Timers between loading the pipeline pointer and finishing delivery.
+        static inline std::atomic<std::uint32_t>& sinkPipelineReaders() noexcept {
+            return detail::singletonStorage<detail::SinkPipelineReadersTag, std::atomic<std::uint32_t>>(0U);
+        }
+
+        /**
+         * @brief Marks a timer as reading sinkPipelineStorage() until the guard ends.
+         *
+         * seq_cst pairs the increment with installSinkPipeline()'s store and
+         * reader check: a timer counted after that check loads the new pipeline.
+         */
+        struct SinkPipelineReadGuard {
+            SinkPipelineReadGuard() noexcept {
+                sinkPipelineReaders().fetch_add(1U, std::memory_order_seq_cst);
+            }
+            ~SinkPipelineReadGuard() {
+                sinkPipelineReaders().fetch_sub(1U, std::memory_order_release);
+            }
+            SinkPipelineReadGuard(const SinkPipelineReadGuard&) = delete;
+            SinkPipelineReadGuard& operator=(const SinkPipelineReadGuard&) = delete;
+        };
+
+        static inline void installSinkPipeline(std::unique_ptr<SinkPipeline> pipeline) {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            auto& installed = installedSinkPipeline();
+            if (installed) {
+                std::lock_guard lock(outMutex());
+                for (std::size_t i = 0U; i < installed->count; ++i) {
+                    const auto& route = installed->routes[i].route;
+                    if (route.logSink != nullptr) {
+                        route.logSink->flush();
+                    }
+                    if (route.recordSink != nullptr) {
+                        route.recordSink->flush();
+                    }
+                }
+            }
+            if (pipeline) {
+                // Generation 0 marks an empty CallSite cache, so skip it on wrap-around.
+                auto& generation = sinkPipelineGeneration();
+                generation = generation + 1U == 0U ? 1U : generation + 1U;
+                pipeline->generation = generation;
+            }
+            sinkPipelineStorage().store(pipeline.get(), std::memory_order_seq_cst);
+            auto& retired = retiredSinkPipelines();
+            if (installed) {
+                retired.push_back(std::move(installed));
+            }
+            installed = std::move(pipeline);
+            if (sinkPipelineReaders().load(std::memory_order_seq_cst) == 0U) {
+                retired.clear();
+            }
+        }
+
+        /**
+         * @brief Returns the routes accepting this callsite, cached on the CallSite per pipeline generation.
+         */
+        inline std::uint32_t pipelineRouteMask(const SinkPipeline& pipeline) const noexcept {
+            if (site_ != nullptr) {
+                const std::uint64_t cached = site_->routeCache.load(std::memory_order_relaxed);
+                if (static_cast<std::uint32_t>(cached >> 32U) == pipeline.generation) {
+                    return static_cast<std::uint32_t>(cached);
+                }
+            }
+
+            const CallSite adHocSite{where_, nullptr, 0U};
+            const CallSite& subject = site_ != nullptr ? *site_ : adHocSite;
+            std::uint32_t mask = 0U;
+            for (std::size_t i = 0U; i < pipeline.count; ++i) {
+                const auto& filter = pipeline.routes[i].route.callSiteFilter;
+                if (!filter || filter(subject)) {
+                    mask |= 1U << i;
+                }
+            }
+            if (site_ != nullptr) {
+                site_->routeCache.store((static_cast<std::uint64_t>(pipeline.generation) << 32U) | mask,
+                                        std::memory_order_relaxed);
+            }
+            return mask;
+        }
+
+        inline void deliverToPipeline(SinkPipeline& pipeline, std::chrono::steady_clock::time_point endSteady, long long elapsedNs) noexcept {
+            const std::uint32_t mask = pipelineRouteMask(pipeline);
+            const auto activeSink = activeSinkStorage().load(std::memory_order_acquire);
+            auto& lineBuf = lineBuffer();
+            std::size_t lineLen = 0U;
+            bool lineRendered = false;
+            bool wroteText = false;
+            for (std::size_t i = 0U; i < pipeline.count; ++i) {
+                if ((mask & (1U << i)) == 0U) {
+                    continue;
+                }
+                auto& state = pipeline.routes[i];
+                const auto& route = state.route;
+                if (elapsedNs < route.minElapsed.count()) {
+                    continue;
+                }
+                if (route.sampleEvery > 1U && state.seen.fetch_add(1U, std::memory_order_relaxed) % route.sampleEvery != 0U) {
+                    continue;
+                }
+                formatDeferredLabel();
+
+                if (route.target == SinkRoute::Target::Record) {
+                    deliverRecord(*route.recordSink, endSteady);
+                    continue;
+                }
+                if (!lineRendered) {
+                    lineLen = renderLogLine(lineBuf.data, sizeof(lineBuf.data), elapsedNs);
+                    lineRendered = true;
+                }
+                if (lineLen == 0U) {
+                    continue;
+                }
+                wroteText = true;
+                if (route.target == SinkRoute::Target::Log) {
+                    std::lock_guard lock(outMutex());
+                    route.logSink->write(lineBuf.data, lineLen);
+                } else if (activeSink != ActiveSink::ThreadBuffered) {
+                    std::lock_guard lock(outMutex());
+                    writeToActiveSink(activeSink, lineBuf.data, lineLen);
+                } else {
+                    writeToActiveSink(activeSink, lineBuf.data, lineLen);
+                }
+            }
+
+            if (wroteText) {
+                const unsigned cnt = lineCounter().fetch_add(1, std::memory_order_relaxed) + 1U;
+                if (cnt % flushInterval() == 0) { // configurable via SCOPE_TIMER_FLUSH_N
+                    flushPipelineTextRoutes(pipeline, activeSink);
+                }
+            }
+        }
+
+        /**
+         * @brief Per-thread assembly buffer for the full log line.
+         */
+        static void defaultSinkWrite(const char* data, std::size_t len) noexcept;
+        static void defaultSinkFlush() noexcept;
+        static void noopSinkFlush() noexcept;
+        static void threadBufferedSinkWrite(const char* data, std::size_t len) noexcept;
+        static void threadBufferedSinkFlush() noexcept;
+        static void asyncSinkWrite(const char* data, std::size_t len) noexcept;
+        static void asyncSinkFlush() noexcept;
+
+        enum class ActiveSink {
+            Default,
+            ThreadBuffered,
+            Custom,
+        };
+
+        enum class BufferedSinkTargetMode {
+            Default,
+            Async,
+            Custom,
+            TestCustom,
+            PerThreadFile,
+        };
+
+        enum class BufferedSinkFlushMode {
+            Deferred,
+            Forced,
+        };
+
+        enum class AsyncSinkTargetMode {
+            Default,
+            Custom,
+        };
+
+        struct ThreadBufferState {
+            std::mutex flushMutex;
+            std::vector<char> data;
+            std::atomic<std::size_t> size{0U}; ///< Stored with release after the bytes, for the crash handler.
+            std::size_t capacity{0U};
+            std::uint32_t threadNum{0U};
+            int fd{-1}; ///< Per-thread log descriptor (per-thread file mode only).
+            bool fdOpenFailed{false};
+            int crashSlot{-1}; ///< Index in crashFlushSlots_, or -1 when the table was full.
+        };
+
+        struct ThreadBufferHandle {
+            std::shared_ptr<ThreadBufferState> state{std::make_shared<ThreadBufferState>()};
+
+            ThreadBufferHandle() {
+                state->threadNum = getThreadIdNumber();
+                registerThreadBuffer(state);
+                claimCrashFlushSlot(*state);
+            }
+
+            ~ThreadBufferHandle() {
+                ScopeTimer::flushThreadBuffer(*state);
+                ScopeTimer::closeThreadBufferFd(*state);
+                releaseCrashFlushSlot(*state);
+            }
+
+            ThreadBufferHandle(const ThreadBufferHandle&) = delete;
+            ThreadBufferHandle& operator=(const ThreadBufferHandle&) = delete;
+            ThreadBufferHandle(ThreadBufferHandle&&) = delete;
+            ThreadBufferHandle& operator=(ThreadBufferHandle&&) = delete;
+        };
+
+        static inline ThreadBufferState& threadLocalBuffer() noexcept {
+            thread_local ThreadBufferHandle handle;
+            return *handle.state;
+        }
+        static inline std::atomic<std::size_t>& threadBufferFlushBytesStorage() noexcept {
+            return detail::singletonStorage<detail::ThreadBufferFlushBytesTag, std::atomic<std::size_t>>(16U * 1024U);
+        }
+        static inline std::size_t threadBufferFlushBytes() noexcept {
+            // The threshold is configuration state written under sinkConfigMutex(); a
+            // relaxed load is sufficient and avoids an unnecessary fence per append.
+            return threadBufferFlushBytesStorage().load(std::memory_order_relaxed);
+        }
+        static inline std::mutex& threadBufferRegistryMutex() noexcept {
+            return detail::singletonStorage<detail::ThreadBufferRegistryMutexTag, std::mutex>();
+        }
+        static inline std::vector<std::weak_ptr<ThreadBufferState>>& threadBufferRegistry() noexcept {
+            return detail::singletonStorage<detail::ThreadBufferRegistryTag, std::vector<std::weak_ptr<ThreadBufferState>>>();
+        }
+        static inline void registerThreadBuffer(const std::shared_ptr<ThreadBufferState>& state) noexcept {
+            std::lock_guard lock(threadBufferRegistryMutex());
+            threadBufferRegistry().emplace_back(state);
+        }
+        static inline std::vector<std::shared_ptr<ThreadBufferState>> snapshotThreadBuffers() noexcept {
+            std::vector<std::shared_ptr<ThreadBufferState>> states;
+            std::lock_guard lock(threadBufferRegistryMutex());
+            auto& registry = threadBufferRegistry();
+            registry.erase(
+                std::remove_if(registry.begin(), registry.end(), [&states](const auto& weakState) {
+                    if (auto state = weakState.lock()) {
+                        states.push_back(state);
+                        return false;
+                    }
+                    return true;
+                }),
+                registry.end()
+            );
+            return states;
+        }
+        static inline void ensureThreadBufferCapacity(ThreadBufferState& state, std::size_t flushBytes) noexcept {
+            if (state.capacity >= flushBytes) {
+                return;
+            }
+
+            std::lock_guard lock(state.flushMutex);
+            if (state.capacity >= flushBytes) {
+                return;
+            }
+
+            state.data.resize(flushBytes);
+            state.capacity = flushBytes;
+        }
+        static inline bool bufferedSinkTargetNeedsLock(BufferedSinkTargetMode mode) noexcept {
+            return mode != BufferedSinkTargetMode::Async && mode != BufferedSinkTargetMode::PerThreadFile;
+        }
+        static inline std::size_t drainThreadBuffer(ThreadBufferState& state, const char*& data) noexcept {
+            // Buffered sink mode changes are documented as setup/teardown steps.
+            // Callers are expected to quiesce profiled worker threads before a
+            // cross-thread flush such as disable/atexit walks the registry.
+            std::lock_guard lock(state.flushMutex);
+            const std::size_t len = state.size.load(std::memory_order_relaxed);
+            if (len == 0U) {
+                data = nullptr;
+                return 0U;
+            }
+
+            data = state.data.data();
+            state.size.store(0U, std::memory_order_relaxed);
+            return len;
+        }
+        static inline void writeBufferedSinkPayload(
+            BufferedSinkTargetMode mode,
+            const char* data,
+            std::size_t len,
+            ThreadBufferState* owner = nullptr
+        ) noexcept {
+            if (len == 0U) {
+                return;
+            }
+
+            writeToBufferedSinkTarget(mode, data, len, owner);
+        }
+        static inline void publishBufferedSinkPayload(
+            const char* data,
+            std::size_t len,
+            BufferedSinkFlushMode flushMode = BufferedSinkFlushMode::Deferred,
+            ThreadBufferState* owner = nullptr
+        ) noexcept {
+            if (len == 0U && flushMode == BufferedSinkFlushMode::Deferred) {
+                return;
+            }
+
+            const auto bufferedTarget = bufferedSinkTargetModeStorage().load(std::memory_order_acquire);
+            if (bufferedSinkTargetNeedsLock(bufferedTarget)) {
+                std::lock_guard lock(outMutex());
+                writeBufferedSinkPayload(bufferedTarget, data, len, owner);
+                if (flushMode == BufferedSinkFlushMode::Forced) {
+                    flushBufferedSinkTarget(bufferedTarget);
+                }
+                return;
+            }
+
+            writeBufferedSinkPayload(bufferedTarget, data, len, owner);
+            if (flushMode == BufferedSinkFlushMode::Forced) {
+                flushBufferedSinkTarget(bufferedTarget);
+            }
+        }
+        static inline void flushThreadBuffer(
+            ThreadBufferState& state,
+            BufferedSinkFlushMode flushMode = BufferedSinkFlushMode::Deferred
+        ) noexcept {
+            const char* pendingData = nullptr;
+            const std::size_t pendingLen = drainThreadBuffer(state, pendingData);
+            publishBufferedSinkPayload(pendingData, pendingLen, flushMode, &state);
+        }
+        static inline void flushAllThreadBuffers(
+            BufferedSinkFlushMode flushMode = BufferedSinkFlushMode::Forced
+        ) noexcept {
+            const auto states = snapshotThreadBuffers();
+            const auto bufferedTarget = bufferedSinkTargetModeStorage().load(std::memory_order_acquire);
+            const bool needsLock = bufferedSinkTargetNeedsLock(bufferedTarget);
+            std::unique_lock sinkLock(outMutex(), std::defer_lock);
+            if (needsLock) {
+                sinkLock.lock();
+            }
+
+            if (bufferedTarget == BufferedSinkTargetMode::Custom) {
+                std::vector<SinkSlice> slices;
+                slices.reserve(states.size());
+                for (const auto& state : states) {
+                    const char* pendingData = nullptr;
+                    if (const std::size_t pendingLen = drainThreadBuffer(*state, pendingData); pendingLen != 0U) {
+                        slices.push_back(SinkSlice{pendingData, pendingLen});
+                    }
+                }
+                writeBatchToCustomSink(slices.data(), slices.size());
+            } else {
+                for (const auto& state : states) {
+                    const char* pendingData = nullptr;
+                    const std::size_t pendingLen = drainThreadBuffer(*state, pendingData);
+                    writeBufferedSinkPayload(bufferedTarget, pendingData, pendingLen, state.get());
+                }
+            }
+
+            if (flushMode == BufferedSinkFlushMode::Forced) {
+                flushBufferedSinkTarget(bufferedTarget);
+            }
+        }
+        static inline std::mutex& sinkConfigMutex() noexcept {
+            return detail::singletonStorage<detail::SinkConfigMutexTag, std::mutex>();
+        }
+        static inline void restoreDefaultSinkState() noexcept {
+            activeSinkStorage().store(hasCustomSink() ? ActiveSink::Custom : ActiveSink::Default,
+                                      std::memory_order_release);
+            bufferedSinkTargetModeStorage().store(hasCustomSink() ? BufferedSinkTargetMode::Custom
+                                                                  : BufferedSinkTargetMode::Default,
+                                                  std::memory_order_release);
+            asyncSinkTargetModeStorage().store(hasCustomSink() ? AsyncSinkTargetMode::Custom
+                                                               : AsyncSinkTargetMode::Default,
+                                               std::memory_order_release);
+        }
+
+        static inline std::atomic<ActiveSink>& activeSinkStorage() noexcept {
+            return detail::singletonStorage<detail::ActiveSinkStorageTag, std::atomic<ActiveSink>>(ActiveSink::Default);
+        }
+        static inline std::atomic<BufferedSinkTargetMode>& bufferedSinkTargetModeStorage() noexcept {
+            return detail::singletonStorage<detail::BufferedSinkTargetModeStorageTag, std::atomic<BufferedSinkTargetMode>>(BufferedSinkTargetMode::Default);
+        }
+        static inline std::atomic<AsyncSinkTargetMode>& asyncSinkTargetModeStorage() noexcept {
+            return detail::singletonStorage<detail::AsyncSinkTargetModeStorageTag, std::atomic<AsyncSinkTargetMode>>(AsyncSinkTargetMode::Default);
+        }
+        static inline std::function<void(const char*, std::size_t)>& customSinkWriteStorage() {
+            return detail::singletonStorage<detail::CustomSinkWriteStorageTag, std::function<void(const char*, std::size_t)>>();
+        }
+        static inline std::function<void()>& customSinkFlushStorage() {
+            return detail::singletonStorage<detail::CustomSinkFlushStorageTag, std::function<void()>>();
+        }
+        static inline LogSink*& customLogSinkStorage() noexcept {
+            return detail::singletonStorage<detail::CustomLogSinkStorageTag, LogSink*>(nullptr);
+        }
+        static inline ReservingLogSink*& customReservingSinkStorage() noexcept {
+            return detail::singletonStorage<detail::CustomReservingSinkStorageTag, ReservingLogSink*>(nullptr);
+        }
+        static inline std::function<void(const char*, std::size_t)>& bufferedTestSinkWriteStorage() {
+            return detail::singletonStorage<detail::BufferedTestSinkWriteStorageTag, std::function<void(const char*, std::size_t)>>();
+        }
+        static inline bool hasCustomSink() {
+            return customLogSinkStorage() != nullptr || static_cast<bool>(customSinkWriteStorage());
+        }
+        static inline void writeToCustomSink(const char* data, std::size_t len) noexcept {
+            if (auto* sink = customLogSinkStorage()) {
+                sink->write(data, len);
+                return;
+            }
+            if (const auto& writeFn = customSinkWriteStorage(); writeFn) {
+                writeFn(data, len);
+            }
+        }
+        static inline void writeBatchToCustomSink(const SinkSlice* slices, std::size_t count) noexcept {
+            if (count == 0U) {
+                return;
+            }
+            if (auto* sink = customLogSinkStorage()) {
+                sink->writeBatch(slices, count);
+                return;
+            }
+            if (const auto& writeFn = customSinkWriteStorage(); writeFn) {
+                for (std::size_t i = 0U; i < count; ++i) {
+                    writeFn(slices[i].data, slices[i].size);
+                }
+            }
+        }
+        static inline void flushCustomSink() noexcept {
+            if (auto* sink = customLogSinkStorage()) {
+                sink->flush();
+                return;
+            }
+            if (const auto& flushFn = customSinkFlushStorage(); flushFn) {
+                flushFn();
+            }
+        }
+        static inline void writeToActiveSink(ActiveSink sink, const char* data, std::size_t len) noexcept {
+            switch (sink) {
+                case ActiveSink::ThreadBuffered:
+                    threadBufferedSinkWrite(data, len);
+                    break;
+                case ActiveSink::Custom:
+                    writeToCustomSink(data, len);
+                    break;
+                case ActiveSink::Default:
+                    defaultSinkWrite(data, len);
+                    break;
+            }
+        }
+        static inline void flushActiveSink(ActiveSink sink) noexcept {
+            switch (sink) {
+                case ActiveSink::ThreadBuffered:
+                    threadBufferedSinkFlush();
+                    break;
+                case ActiveSink::Custom:
+                    flushCustomSink();
+                    break;
+                case ActiveSink::Default:
+                    defaultSinkFlush();
+                    break;
+            }
+        }
+        /**
+         * @brief SCOPE_TIMER_FLUSH_N flush of a pipeline's Log routes and, unless it flushes on size, the active sink.
+         */
+        static inline void flushPipelineTextRoutes(const SinkPipeline& pipeline, ActiveSink activeSink) noexcept {
+            bool flushActive = false;
+            for (std::size_t i = 0U; i < pipeline.count; ++i) {
+                const auto& route = pipeline.routes[i].route;
+                if (route.target == SinkRoute::Target::Log) {
+                    std::lock_guard lock(outMutex());
+                    route.logSink->flush();
+                } else if (route.target == SinkRoute::Target::DefaultFile) {
+                    flushActive = true;
+                }
+            }
+            if (flushActive && activeSink != ActiveSink::ThreadBuffered) {
+                flushActiveSink(activeSink);
+            }
+        }
+        static inline void writeToBufferedSinkTarget(
+            BufferedSinkTargetMode mode,
+            const char* data,
+            std::size_t len,
+            ThreadBufferState* owner = nullptr
+        ) noexcept {
+            switch (mode) {
+                case BufferedSinkTargetMode::PerThreadFile:
+                    if (owner != nullptr) {
+                        writeThreadBufferFile(*owner, data, len);
+                    }
+                    break;
+                case BufferedSinkTargetMode::Async:
+                    asyncSinkWrite(data, len);
+                    break;
+                case BufferedSinkTargetMode::Custom:
+                    writeToCustomSink(data, len);
+                    break;
+                case BufferedSinkTargetMode::TestCustom:
+                    if (const auto& writeFn = bufferedTestSinkWriteStorage(); writeFn) {
+                        writeFn(data, len);
+                    }
+                    break;
+                case BufferedSinkTargetMode::Default:
+                    defaultSinkWrite(data, len);
+                    break;
+            }
+        }
+        static inline void flushBufferedSinkTarget(BufferedSinkTargetMode mode) noexcept {
+            switch (mode) {
+                case BufferedSinkTargetMode::Async:
+                    noopSinkFlush();
+                    break;
+                case BufferedSinkTargetMode::Custom:
+                    flushCustomSink();
+                    break;
+                case BufferedSinkTargetMode::TestCustom:
+                case BufferedSinkTargetMode::PerThreadFile:
+                    noopSinkFlush();
+                    break;
+                case BufferedSinkTargetMode::Default:
+                    defaultSinkFlush();
+                    break;
+            }
+        }
+
+        struct AsyncSinkBatch {
+            std::vector<char> data;
+            std::size_t size{0U};
+            int crashSlot{-1}; ///< Index in crashAsyncSlots_ while queued, or -1.
+        };
+
+        struct AsyncSinkState {
+            std::mutex mutex;
+            std::condition_variable ready;
+            std::condition_variable drained;
+            std::deque<AsyncSinkBatch> queue;
+            std::vector<AsyncSinkBatch> recycled;
+            std::thread worker;
+            bool running{false};
+            bool stop{false};
+            bool writing{false};
+        };
+
+        static inline AsyncSinkState& asyncSinkState() noexcept {
+            return detail::singletonStorage<detail::AsyncSinkStateTag, AsyncSinkState>();
+        }
+        static inline AsyncSinkBatch acquireAsyncSinkBatch(std::size_t len) noexcept {
+            AsyncSinkBatch batch;
+            auto& state = asyncSinkState();
+            {
+                std::lock_guard lock(state.mutex);
+                if (!state.recycled.empty()) {
+                    batch = std::move(state.recycled.back());
+                    state.recycled.pop_back();
+                }
+            }
+
+            if (batch.data.size() < len) {
+                batch.data.resize(len);
+            }
+            batch.size = len;
+            return batch;
+        }
+        static inline void defaultSinkWriteBatches(const std::deque<AsyncSinkBatch>& batches) noexcept {
+#if !defined(_WIN32)
+            constexpr std::size_t MaxIovecs = 64U;
+            std::array<::iovec, MaxIovecs> iovecs{};
+            std::size_t count = 0U;
+
+            int fd = logFd();
+            if (fd < 0) {
+                if (!ensureLogFdOpen()) {
+                    return;
+                }
+                fd = logFd();
+                if (fd < 0) {
+                    return;
+                }
+            }
+
+            for (const auto& batch : batches) {
+                if (batch.size == 0U) {
+                    continue;
+                }
+
+                // POSIX writev() exposes iov_base as mutable even for write-only buffers.
+                // The payload bytes remain immutable; this cast only adapts the API's
+                // legacy type mismatch.
+                iovecs[count].iov_base = const_cast<char*>(batch.data.data()); // NOSONAR: writev() reads from iov_base but declares it mutable.
+                iovecs[count].iov_len = batch.size;
+                ++count;
+
+                if (count == iovecs.size()) {
+                    const ssize_t unused = ::writev(fd, iovecs.data(), static_cast<int>(count));
+                    (void)unused;
+                    count = 0U;
+                }
+            }
+
+            if (count != 0U) {
+                const ssize_t unused = ::writev(fd, iovecs.data(), static_cast<int>(count));
+                (void)unused;
+            }
+#else
+            for (const auto& batch : batches) {
+                defaultSinkWrite(batch.data.data(), batch.size);
+            }
+#endif
+        }
+        static inline void runAsyncSinkWorker() noexcept {
+            auto& workerState = asyncSinkState();
+            std::vector<SinkSlice> slices;
+            for (;;) {
+                std::deque<AsyncSinkBatch> pending;
+                {
+                    std::unique_lock lock(workerState.mutex);
+                    workerState.ready.wait(lock, [&workerState] {
+                        return workerState.stop || !workerState.queue.empty();
+                    });
+                    if (workerState.queue.empty()) {
+                        if (workerState.stop) {
+                            break;
+                        }
+                        continue;
+                    }
+                    pending.swap(workerState.queue);
+                    workerState.writing = true;
+                }
+
+                switch (asyncSinkTargetModeStorage().load(std::memory_order_acquire)) {
+                    case AsyncSinkTargetMode::Custom:
+                        slices.clear();
+                        for (const auto& batch : pending) {
+                            if (batch.size != 0U) {
+                                slices.push_back(SinkSlice{batch.data.data(), batch.size});
+                            }
+                        }
+                        writeBatchToCustomSink(slices.data(), slices.size());
+                        break;
+                    case AsyncSinkTargetMode::Default:
+                        defaultSinkWriteBatches(pending);
+                        break;
+                }
+
+                {
+                    std::lock_guard lock(workerState.mutex);
+                    for (auto& batch : pending) {
+                        retireCrashAsyncBatch(batch);
+                        batch.size = 0U;
+                        workerState.recycled.emplace_back(std::move(batch));
+                    }
+                    workerState.writing = false;
+                    if (workerState.queue.empty()) {
+                        workerState.drained.notify_all();
+                    }
+                }
+            }
+            switch (asyncSinkTargetModeStorage().load(std::memory_order_acquire)) {
+                case AsyncSinkTargetMode::Custom:
+                    flushCustomSink();
+                    break;
+                case AsyncSinkTargetMode::Default:
+                    defaultSinkFlush();
+                    break;
+            }
+        }
+
+        static inline void ensureAsyncSinkRunning() noexcept {
+            auto& state = asyncSinkState();
+            std::lock_guard lock(state.mutex);
+            if (state.running) {
+                return;
+            }
+            state.stop = false;
+            state.writing = false;
+            state.running = true;
+            state.worker = std::thread([] { runAsyncSinkWorker(); });
+        }
+
+        static inline void shutdownAsyncSink() noexcept {
+            auto& state = asyncSinkState();
+            std::unique_lock lock(state.mutex);
+            if (!state.running) {
+                return;
+            }
+            state.stop = true;
+            lock.unlock();
+            state.ready.notify_all();
+            if (state.worker.joinable()) {
+                state.worker.join();
+            }
+            lock.lock();
+            state.stop = false;
+            state.running = false;
+            state.writing = false;
+        }
+
+        // Test-only sink swap; safe when called during single-threaded setup/teardown.
+        static inline void setLogSinkForTests(
+            std::function<void(const char*, std::size_t)> writeFn = {},
+            std::function<void()> flushFn = {}
+        ) {
+            setCustomSinkCallbacks(std::move(writeFn), std::move(flushFn));
+        }
+
+        static inline void setCustomSinkCallbacks(
+            std::function<void(const char*, std::size_t)> writeFn = {},
+            std::function<void()> flushFn = {}
+        ) {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            flushAllThreadBuffers();
+            asyncSinkFlush();
+            shutdownAsyncSink();
+            closeLogFd();
+
+            const bool asyncModeActive = activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::ThreadBuffered
+                && bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Async;
+
+            customLogSinkStorage() = nullptr;
+            customReservingSinkStorage() = nullptr;
+            customSinkWriteStorage() = std::move(writeFn);
+            customSinkFlushStorage() = flushFn ? std::move(flushFn) : std::function<void()>{};
+            updateCustomSinkRouting(asyncModeActive);
+        }
+
+        static inline void setCustomLogSink(LogSink* sink, ReservingLogSink* reservingSink = nullptr) {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            flushAllThreadBuffers();
+            asyncSinkFlush();
+            shutdownAsyncSink();
+            closeLogFd();
+
+            const bool asyncModeActive = activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::ThreadBuffered
+                && bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Async;
+
+            customLogSinkStorage() = sink;
+            customReservingSinkStorage() = reservingSink;
+            customSinkWriteStorage() = {};
+            customSinkFlushStorage() = {};
+            updateCustomSinkRouting(asyncModeActive);
         }
-        static inline std::atomic<BufferedSinkTargetMode>& bufferedSinkTargetModeStorage() noexcept {
-            return detail::singletonStorage<detail::BufferedSinkTargetModeStorageTag, std::atomic<BufferedSinkTargetMode>>(BufferedSinkTargetMode::Default);
+
+        static inline void updateCustomSinkRouting(bool asyncModeActive) {
+            if (hasCustomSink()) {
+                if (activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::Default) {
+                    activeSinkStorage().store(ActiveSink::Custom, std::memory_order_release);
+                }
+                if (bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Default) {
+                    bufferedSinkTargetModeStorage().store(BufferedSinkTargetMode::Custom, std::memory_order_release);
+                }
+                asyncSinkTargetModeStorage().store(AsyncSinkTargetMode::Custom, std::memory_order_release);
+            } else {
+                if (activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::Custom) {
+                    activeSinkStorage().store(ActiveSink::Default, std::memory_order_release);
+                }
+                if (bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Custom) {
+                    bufferedSinkTargetModeStorage().store(BufferedSinkTargetMode::Default, std::memory_order_release);
+                }
+                asyncSinkTargetModeStorage().store(AsyncSinkTargetMode::Default, std::memory_order_release);
+            }
+
+            if (asyncModeActive) {
+                ensureAsyncSinkRunning();
+            }
         }
-        static inline std::atomic<AsyncSinkTargetMode>& asyncSinkTargetModeStorage() noexcept {
-            return detail::singletonStorage<detail::AsyncSinkTargetModeStorageTag, std::atomic<AsyncSinkTargetMode>>(AsyncSinkTargetMode::Default);
+
+        // Test-only: allow buffered sink to flush to a custom target (e.g., in-memory sink).
+        static inline void setBufferedSinkTargetForTests(
+            std::function<void(const char*, std::size_t)> writeFn = {}
+        ) {
+            std::lock_guard sinkStateLock(sinkConfigMutex());
+            flushAllThreadBuffers();
+            asyncSinkFlush();
+            shutdownAsyncSink();
+            bufferedTestSinkWriteStorage() = std::move(writeFn);
+            bufferedSinkTargetModeStorage().store(
+                bufferedTestSinkWriteStorage() ? BufferedSinkTargetMode::TestCustom : BufferedSinkTargetMode::Default,
+                std::memory_order_release
+            );
         }
-        static inline std::function<void(const char*, std::size_t)>& customSinkWriteStorage() {
-            return detail::singletonStorage<detail::CustomSinkWriteStorageTag, std::function<void(const char*, std::size_t)>>();
+
+        /**
+         * @brief Formats a SCOPE_TIMER_FMT label into labelBuffer_; no-op for every other label.
+         */
+        inline void formatDeferredLabel() noexcept {
+            if (labelFormatter_ == nullptr) {
+                return;
+            }
+            const auto format = std::exchange(labelFormatter_, nullptr);
+            const std::size_t len = format(label_.data(), reinterpret_cast<const unsigned char*>(labelBuffer_.data()),
+                                           labelBuffer_.data(), labelBuffer_.size());
+            label_ = std::string_view{labelBuffer_.data(), len};
         }
-        static inline std::function<void()>& customSinkFlushStorage() {
-            return detail::singletonStorage<detail::CustomSinkFlushStorageTag, std::function<void()>>();
+
+        inline void assignLabel(detail::LabelData data) noexcept {
+            const std::string_view source = !data.storage.empty() ? std::string_view{data.storage} : data.view;
+            if (source.empty()) {
+                label_ = "ScopeTimer";
+                return;
+            }
+
+            if (data.canBorrowView()) {
+                label_ = source;
+                labelHeapStorage_.clear();
+                return;
+            }
+
+            if (source.size() < labelBuffer_.size()) {
+                std::memcpy(labelBuffer_.data(), source.data(), source.size());
+                label_ = std::string_view{labelBuffer_.data(), source.size()};
+                labelHeapStorage_.clear();
+            } else {
+                labelHeapStorage_ = !data.storage.empty() ? std::move(data.storage) : std::string(source);
+                label_ = labelHeapStorage_;
+            }
         }
-        static inline LogSink*& customLogSinkStorage() noexcept {
-            return detail::singletonStorage<detail::CustomLogSinkStorageTag, LogSink*>(nullptr);
+
+        const CallSite* site_{nullptr}; ///< Static macro callsite, if any.
+        std::string_view where_; ///< Description of the scope being timed.
+        std::string_view label_{ "ScopeTimer" }; ///< Label for the log output.
+        std::array<char, detail::InlineLabelCapacity> labelBuffer_{};
+        std::string labelHeapStorage_;
+        /// Set while SCOPE_TIMER_FMT arguments wait in labelBuffer_ and label_ is the format.
+        std::size_t (*labelFormatter_)(const char*, const unsigned char*, char*, std::size_t) noexcept {nullptr};
+        uint32_t threadNum_{0}; ///< Unique thread ID number.
+
+        static inline thread_local FormatBuffers tlsFormatBuffers_{};
+        static inline thread_local LineBuffer tlsLineBuffer_{};
+        static inline std::atomic<bool> allocationHooksLinked_{false};
+        static inline std::string logDirCache_{"/tmp/"};
+        static inline bool logDirInitialized_{false};
+
+        static inline int openLogFileForAppend(const std::string& path) noexcept {
+#if defined(_WIN32)
+            int openFlags = _O_CREAT | _O_WRONLY | _O_APPEND;
+#ifdef _O_BINARY
+            openFlags |= _O_BINARY;
+#endif
+#ifdef _O_NOINHERIT
+            openFlags |= _O_NOINHERIT;
+#endif
+            return ::_open(path.c_str(), openFlags, _S_IREAD | _S_IWRITE);
+#else
+            int openFlags = O_CREAT | O_WRONLY | O_APPEND;
+#ifdef O_CLOEXEC
+            openFlags |= O_CLOEXEC;
+#endif
+            const int fd = ::open(path.c_str(), openFlags, 0600);
+#ifndef O_CLOEXEC
+            if (fd >= 0) {
+                (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+#endif
+            return fd;
+#endif
         }
-        static inline std::function<void(const char*, std::size_t)>& bufferedTestSinkWriteStorage() {
-            return detail::singletonStorage<detail::BufferedTestSinkWriteStorageTag, std::function<void(const char*, std::size_t)>>();
+
+        static inline void closeFd(int fd) noexcept {
+#if defined(_WIN32)
+            (void)::_close(fd);
+#else
+            (void)::close(fd);
+#endif
         }
-        static inline bool hasCustomSink() {
-            return customLogSinkStorage() != nullptr || static_cast<bool>(customSinkWriteStorage());
+
+        static inline void writeFdBestEffort(int fd, const char* data, std::size_t len) noexcept {
+#if defined(_WIN32)
+            const auto maxChunk = static_cast<std::size_t>(std::numeric_limits<unsigned int>::max());
+            const auto chunkLen = static_cast<unsigned int>(std::min(len, maxChunk));
+            const int unused = ::_write(fd, data, chunkLen);
+            (void)unused;
+#else
+            const ssize_t unused = ::write(fd, data, len);
+            (void)unused;
+#endif
         }
-        static inline void writeToCustomSink(const char* data, std::size_t len) noexcept {
-            if (auto* sink = customLogSinkStorage()) {
-                sink->write(data, len);
-                return;
+
+        /**
+         * @brief Opens the default log file descriptor on first use (best-effort).
+         */
+        static inline bool ensureLogFdOpen() noexcept {
+            int& fd = logFd();
+            if (fd >= 0) {
+                return true;
             }
-            if (const auto& writeFn = customSinkWriteStorage(); writeFn) {
-                writeFn(data, len);
+
+            static std::string lastFailedPath;
+            static bool lastAttemptFailed = false;
+
+            const std::string path = logDirectory() + "ScopeTimer.log";
+
+            if (lastAttemptFailed && path == lastFailedPath) {
+                return false;
+            }
+
+            if (int newFd = openLogFileForAppend(path); newFd >= 0) {
+                fd = newFd;
+                lastAttemptFailed = false;
+                lastFailedPath.clear();
+                registerLogFdCleanup();
+                return true;
             }
+
+            lastFailedPath = path;
+            lastAttemptFailed = true;
+            return false;
         }
-        static inline void flushCustomSink() noexcept {
-            if (auto* sink = customLogSinkStorage()) {
-                sink->flush();
-                return;
+
+        /**
+         * @brief Registers the process lifecycle hooks: the atexit drain that
+         * closes the log descriptor and, on POSIX, the fork handlers.
+         */
+        static inline void registerLogFdCleanup() noexcept {
+            // Reached from the async worker as well as from configuration calls.
+            static std::once_flag registered;
+            std::call_once(registered, [] {
+                std::atexit([]() noexcept {
+                    std::lock_guard sinkStateLock(sinkConfigMutex());
+                    shutdownWatchdog();
+                    flushSuppressedSamples();
+                    flushAllThreadBuffers();
+                    asyncSinkFlush();
+                    shutdownAsyncSink();
+                    closeLogFd();
+                });
+#if !defined(_WIN32)
+                ::pthread_atfork(&forkPrepare, &forkParent, &forkChild);
+#endif
+            });
+        }
+
+#if !defined(_WIN32)
+        /**
+         * @brief pthread_atfork prepare hook.
+         *
+         * Drains the async queue and takes every ScopeTimer lock, in the same
+         * order the logging paths use, so the child never inherits a mutex
+         * held by a thread that does not exist there.
+         */
+        static void forkPrepare() {
+            sinkConfigMutex().lock();
+            watchdogState().mutex.lock(); // the watchdog scans with this held
+            auto& asyncState = asyncSinkState();
+            std::unique_lock asyncLock(asyncState.mutex);
+            if (asyncState.running) {
+                asyncState.drained.wait(asyncLock, [&asyncState] {
+                    return asyncState.queue.empty() && !asyncState.writing;
+                });
             }
-            if (const auto& flushFn = customSinkFlushStorage(); flushFn) {
-                flushFn();
+            asyncLock.release();
+            outMutex().lock();
+            threadBufferRegistryMutex().lock();
+            liveScopeRegistryMutex().lock();
+        }
+
+        static void forkParent() {
+            liveScopeRegistryMutex().unlock();
+            threadBufferRegistryMutex().unlock();
+            outMutex().unlock();
+            asyncSinkState().mutex.unlock();
+            watchdogState().mutex.unlock();
+            sinkConfigMutex().unlock();
+        }
+
+        /**
+         * @brief pthread_atfork child hook.
+         *
+         * Only the forking thread survives. Buffers belonging to other threads
+         * (and anything unflushed in the forking thread's buffer) stay with the
+         * parent, which still writes them; the child drops them so nothing is
+         * logged twice. Inherited descriptors are closed so the child reopens
+         * its own output (per-thread files carry the new pid). Open deadline
+         * scopes of vanished threads are forgotten, and the async worker and
+         * watchdog are restarted if they were running.
+         */
+        static void forkChild() {
+            auto& asyncState = asyncSinkState();
+            const bool restartWorker = asyncState.running;
+            // The worker does not exist in the child: forget its handle without
+            // joining and rebuild the condition variables it was waiting on.
+            ::new (static_cast<void*>(&asyncState.worker)) std::thread();
+            ::new (static_cast<void*>(&asyncState.ready)) std::condition_variable();
+            ::new (static_cast<void*>(&asyncState.drained)) std::condition_variable();
+            asyncState.running = false;
+            asyncState.stop = false;
+            asyncState.writing = false;
+            asyncState.queue.clear();
+
+            const std::uint32_t survivor = getThreadIdNumber();
+            auto& registry = threadBufferRegistry();
+            registry.erase(
+                std::remove_if(registry.begin(), registry.end(), [survivor](const auto& weakState) {
+                    auto state = weakState.lock();
+                    if (!state) {
+                        return true;
+                    }
+                    state->size.store(0U, std::memory_order_relaxed);
+                    if (state->fd >= 0) {
+                        closeFd(state->fd);
+                        state->fd = -1;
+                    }
+                    state->fdOpenFailed = false;
+                    if (state->threadNum == survivor) {
+                        return false;
+                    }
+                    releaseCrashFlushSlot(*state);
+                    return true;
+                }),
+                registry.end()
+            );
+            crashFlushRunning_.store(false, std::memory_order_relaxed);
+            sinkPipelineReaders().store(0U, std::memory_order_relaxed); // counted timers ran on other threads
+            // Inherited counters still measure the parent's thread; reopen lazily.
+            perfCounterGroup().reset();
+            if (int& fd = logFd(); fd >= 0) {
+                closeFd(fd);
+                fd = -1;
+            }
+
+            auto& liveStacks = liveScopeRegistry();
+            liveStacks.erase(
+                std::remove_if(liveStacks.begin(), liveStacks.end(), [survivor](const auto& weakStack) {
+                    auto stack = weakStack.lock();
+                    return !stack || stack->threadNum != survivor;
+                }),
+                liveStacks.end()
+            );
+            auto& watchdog = watchdogState();
+            const bool restartWatchdog = watchdog.running;
+            ::new (static_cast<void*>(&watchdog.worker)) std::thread();
+            ::new (static_cast<void*>(&watchdog.wake)) std::condition_variable();
+            watchdog.running = false;
+            watchdog.stop = false;
+            watchdogRunningStorage().store(false, std::memory_order_relaxed);
+
+            liveScopeRegistryMutex().unlock();
+            threadBufferRegistryMutex().unlock();
+            outMutex().unlock();
+            asyncState.mutex.unlock();
+            if (restartWatchdog) {
+                watchdog.running = true;
+                watchdog.worker = std::thread([] { runWatchdog(); });
+                watchdogRunningStorage().store(true, std::memory_order_release);
+            }
+            watchdog.mutex.unlock();
+            if (restartWorker) {
+                ensureAsyncSinkRunning();
             }
+            sinkConfigMutex().unlock();
         }
-        static inline void writeToActiveSink(ActiveSink sink, const char* data, std::size_t len) noexcept {
-            switch (sink) {
-                case ActiveSink::ThreadBuffered:
-                    threadBufferedSinkWrite(data, len);
-                    break;
-                case ActiveSink::Custom:
-                    writeToCustomSink(data, len);
-                    break;
-                case ActiveSink::Default:
-                    defaultSinkWrite(data, len);
-                    break;
+#endif
+
+        /**
+         * @brief Singleton storage for the log descriptor.
+         */
+        static inline int logFdStorage_{-1};
+        static inline int& logFd() noexcept {
+            return logFdStorage_;
+        }
+
+        /**
+         * @brief Resets the log descriptor so it will be reopened on demand.
+         */
+        static inline void closeLogFd() noexcept {
+            int& fd = logFd();
+            if (fd >= 0) {
+                closeFd(fd);
+                fd = -1;
+            }
+            for (const auto& state : snapshotThreadBuffers()) {
+                closeThreadBufferFd(*state);
             }
         }
-        static inline void flushActiveSink(ActiveSink sink) noexcept {
-            switch (sink) {
-                case ActiveSink::ThreadBuffered:
-                    threadBufferedSinkFlush();
-                    break;
-                case ActiveSink::Custom:
-                    flushCustomSink();
-                    break;
-                case ActiveSink::Default:
-                    defaultSinkFlush();
-                    break;
+
+        static inline long currentProcessId() noexcept {
+#if defined(_WIN32)
+            return static_cast<long>(::_getpid());
+#else
+            return static_cast<long>(::getpid());
+#endif
+        }
+
+        /**
+         * @brief Lazily opens `ScopeTimer.<pid>.<tid>.log` for a thread buffer.
+         *
+         * The caller holds state.flushMutex, which also guards closeThreadBufferFd().
+         */
+        static inline bool ensureThreadBufferFdOpen(ThreadBufferState& state) noexcept {
+            if (state.fd >= 0) {
+                return true;
             }
+            if (state.fdOpenFailed) {
+                return false;
+            }
+
+            char name[64];
+            const int n = std::snprintf(name, sizeof(name), "ScopeTimer.%ld.%03u.log",
+                                        currentProcessId(), static_cast<unsigned>(state.threadNum));
+            if (n <= 0 || static_cast<std::size_t>(n) >= sizeof(name)) {
+                state.fdOpenFailed = true;
+                return false;
+            }
+            state.fd = openLogFileForAppend(logDirectory() + name);
+            state.fdOpenFailed = state.fd < 0;
+            return state.fd >= 0;
         }
-        static inline void writeToBufferedSinkTarget(
-            BufferedSinkTargetMode mode,
-            const char* data,
-            std::size_t len
-        ) noexcept {
-            switch (mode) {
-                case BufferedSinkTargetMode::Async:
-                    asyncSinkWrite(data, len);
-                    break;
-                case BufferedSinkTargetMode::Custom:
-                    writeToCustomSink(data, len);
-                    break;
-                case BufferedSinkTargetMode::TestCustom:
-                    if (const auto& writeFn = bufferedTestSinkWriteStorage(); writeFn) {
-                        writeFn(data, len);
-                    }
-                    break;
-                case BufferedSinkTargetMode::Default:
-                    defaultSinkWrite(data, len);
-                    break;
+
+        /**
+         * @brief Appends @p data to the thread's own log file, opening it on first use.
+         *
+         * The owner thread and a cross-thread flush can both get here, so the
+         * open and the write share the lock that closeThreadBufferFd() takes.
+         */
+        static inline void writeThreadBufferFile(ThreadBufferState& state, const char* data, std::size_t len) noexcept {
+            std::lock_guard lock(state.flushMutex);
+            if (ensureThreadBufferFdOpen(state)) {
+                writeFdBestEffort(state.fd, data, len);
             }
         }
-        static inline void flushBufferedSinkTarget(BufferedSinkTargetMode mode) noexcept {
-            switch (mode) {
-                case BufferedSinkTargetMode::Async:
-                    noopSinkFlush();
-                    break;
-                case BufferedSinkTargetMode::Custom:
-                    flushCustomSink();
-                    break;
-                case BufferedSinkTargetMode::TestCustom:
-                    noopSinkFlush();
-                    break;
-                case BufferedSinkTargetMode::Default:
-                    defaultSinkFlush();
-                    break;
+
+        static inline void closeThreadBufferFd(ThreadBufferState& state) noexcept {
+            std::lock_guard lock(state.flushMutex);
+            if (state.fd >= 0) {
+                closeFd(state.fd);
+                state.fd = -1;
             }
+            state.fdOpenFailed = false;
         }
 
-        struct AsyncSinkBatch {
-            std::vector<char> data;
-            std::size_t size{0U};
-        };
+        // ---------------------------------------------------------------------
+        // Fatal-signal flush. Everything the handler touches lives in plain
+        // static storage (no function-local statics). The handler only loads
+        // atomics and calls write(): it takes no locks and never allocates or
+        // frees, so it is safe even when the signal lands inside malloc.
+        // ---------------------------------------------------------------------
+        static constexpr std::size_t MaxCrashFlushThreads = 1024U;
+        static constexpr std::size_t MaxCrashAsyncBatches = 256U;
 
-        struct AsyncSinkState {
-            std::mutex mutex;
-            std::condition_variable ready;
-            std::condition_variable drained;
-            std::deque<AsyncSinkBatch> queue;
-            std::vector<AsyncSinkBatch> recycled;
-            std::thread worker;
-            bool running{false};
-            bool stop{false};
-            bool writing{false};
+        /**
+         * @brief One queued async batch as the crash handler sees it.
+         *
+         * data is published last and cleared first, so a non-null data means
+         * size and the bytes behind it belong to a batch still in the queue.
+         * Only ever lives in static storage, which starts zeroed.
+         */
+        struct CrashAsyncSlot {
+            std::atomic<const char*> data;
+            std::atomic<std::size_t> size;
         };
-
-        static inline AsyncSinkState& asyncSinkState() noexcept {
-            return detail::singletonStorage<detail::AsyncSinkStateTag, AsyncSinkState>();
-        }
-        static inline AsyncSinkBatch acquireAsyncSinkBatch(std::size_t len) noexcept {
-            AsyncSinkBatch batch;
-            auto& state = asyncSinkState();
-            {
-                std::lock_guard lock(state.mutex);
-                if (!state.recycled.empty()) {
-                    batch = std::move(state.recycled.back());
-                    state.recycled.pop_back();
+#if !defined(_WIN32)
+        static constexpr std::array<int, 6> CrashSignals{SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGTERM};
+        static inline struct sigaction crashPreviousActions_[CrashSignals.size()]{};
+#endif
+        static inline std::atomic<ThreadBufferState*> crashFlushSlots_[MaxCrashFlushThreads]{};
+        static inline std::atomic<bool> crashFlushRunning_{false};
+        static inline bool crashFlushInstalled_{false};
+        static inline char crashLogPath_[4096]{};
+        static inline CrashAsyncSlot crashAsyncSlots_[MaxCrashAsyncBatches];
+
+        static inline void claimCrashFlushSlot(ThreadBufferState& state) noexcept {
+            for (std::size_t i = 0U; i < MaxCrashFlushThreads; ++i) {
+                ThreadBufferState* expected = nullptr;
+                if (crashFlushSlots_[i].compare_exchange_strong(expected, &state, std::memory_order_acq_rel)) {
+                    state.crashSlot = static_cast<int>(i);
+                    return;
                 }
             }
+        }
 
-            if (batch.data.size() < len) {
-                batch.data.resize(len);
+        static inline void releaseCrashFlushSlot(ThreadBufferState& state) noexcept {
+            if (state.crashSlot >= 0) {
+                crashFlushSlots_[static_cast<std::size_t>(state.crashSlot)].store(nullptr, std::memory_order_release);
+                state.crashSlot = -1;
             }
-            batch.size = len;
-            return batch;
         }
-        static inline void defaultSinkWriteBatches(const std::deque<AsyncSinkBatch>& batches) noexcept {
-#if !defined(_WIN32)
-            constexpr std::size_t MaxIovecs = 64U;
-            std::array<::iovec, MaxIovecs> iovecs{};
-            std::size_t count = 0U;
 
-            int fd = logFd();
-            if (fd < 0) {
-                if (!ensureLogFdOpen()) {
+        /**
+         * @brief Makes a batch entering the async queue visible to the crash handler.
+         *
+         * Called with the queue lock held, which serializes slot claims. Batches
+         * queued while every slot is taken are not written on a crash.
+         */
+        static inline void publishCrashAsyncBatch(AsyncSinkBatch& batch) noexcept {
+            for (std::size_t i = 0U; i < MaxCrashAsyncBatches; ++i) {
+                CrashAsyncSlot& slot = crashAsyncSlots_[i];
+                if (slot.data.load(std::memory_order_relaxed) == nullptr) {
+                    slot.size.store(batch.size, std::memory_order_relaxed);
+                    slot.data.store(batch.data.data(), std::memory_order_release);
+                    batch.crashSlot = static_cast<int>(i);
                     return;
                 }
-                fd = logFd();
-                if (fd < 0) {
+            }
+        }
+
+        /**
+         * @brief Withdraws a written batch before its buffer is recycled (queue lock held).
+         */
+        static inline void retireCrashAsyncBatch(AsyncSinkBatch& batch) noexcept {
+            if (batch.crashSlot >= 0) {
+                crashAsyncSlots_[static_cast<std::size_t>(batch.crashSlot)].data.store(nullptr, std::memory_order_release);
+                batch.crashSlot = -1;
+            }
+        }
+
+#if !defined(_WIN32)
+        static inline void writeAllRaw(int fd, const char* data, std::size_t len) noexcept {
+            while (fd >= 0 && len != 0U) {
+                const ssize_t n = ::write(fd, data, len);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
                     return;
                 }
+                data += n;
+                len -= static_cast<std::size_t>(n);
             }
+        }
 
-            for (const auto& batch : batches) {
-                if (batch.size == 0U) {
+        /**
+         * @brief Async-signal-safe drain of thread buffers and the async queue.
+         *
+         * Each thread buffer is written up to its published size. Threads
+         * that keep running during the dump can still append or flush, so
+         * their part of the crash log may repeat or miss a line.
+         */
+        static inline void emergencyFlush() noexcept {
+            int sharedFd = logFdStorage_;
+            if (sharedFd < 0 && crashLogPath_[0] != '\0') {
+                int flags = O_WRONLY | O_CREAT | O_APPEND;
+#ifdef O_CLOEXEC
+                flags |= O_CLOEXEC;
+#endif
+                sharedFd = ::open(crashLogPath_, flags, 0600);
+            }
+
+            for (auto& slot : crashFlushSlots_) {
+                ThreadBufferState* state = slot.load(std::memory_order_acquire);
+                if (state == nullptr) {
                     continue;
                 }
+                // Covers only completed appends; a line its thread is still copying is left out.
+                const std::size_t size = state->size.load(std::memory_order_acquire);
+                if (size == 0U) {
+                    continue;
+                }
+                const int fd = state->fd >= 0 ? state->fd : sharedFd;
+                writeAllRaw(fd, state->data.data(), size);
+                state->size.store(0U, std::memory_order_relaxed);
+            }
 
-                // POSIX writev() exposes iov_base as mutable even for write-only buffers.
-                // The payload bytes remain immutable; this cast only adapts the API's
-                // legacy type mismatch.
-                iovecs[count].iov_base = const_cast<char*>(batch.data.data()); // NOSONAR: writev() reads from iov_base but declares it mutable.
-                iovecs[count].iov_len = batch.size;
-                ++count;
-
-                if (count == iovecs.size()) {
-                    const ssize_t unused = ::writev(fd, iovecs.data(), static_cast<int>(count));
-                    (void)unused;
-                    count = 0U;
+            // Queued async batches are read through their published slots, never
+            // through the queue itself. A slot that changes while it is read was
+            // retired by the worker, which already wrote it, so it is skipped.
+            // Batches the worker is writing right now may appear twice.
+            for (auto& slot : crashAsyncSlots_) {
+                const char* data = slot.data.load(std::memory_order_acquire);
+                if (data == nullptr) {
+                    continue;
+                }
+                const std::size_t size = slot.size.load(std::memory_order_relaxed);
+                if (slot.data.load(std::memory_order_acquire) == data) {
+                    writeAllRaw(sharedFd, data, size);
                 }
             }
+        }
 
-            if (count != 0U) {
-                const ssize_t unused = ::writev(fd, iovecs.data(), static_cast<int>(count));
-                (void)unused;
+        static void crashFlushSignalHandler(int sig) {
+            const int savedErrno = errno;
+            if (!crashFlushRunning_.exchange(true)) {
+                emergencyFlush();
             }
-#else
-            for (const auto& batch : batches) {
-                defaultSinkWrite(batch.data.data(), batch.size);
+            for (std::size_t i = 0U; i < CrashSignals.size(); ++i) {
+                if (CrashSignals[i] == sig) {
+                    ::sigaction(sig, &crashPreviousActions_[i], nullptr);
+                    break;
+                }
             }
+            errno = savedErrno;
+            // Delivered once this handler returns, to the restored disposition.
+            ::raise(sig);
+        }
 #endif
+
+        /**
+         * @brief Test-only accessor to observe the current log descriptor.
+         */
+        static inline int defaultLogFdForTests() noexcept {
+            return logFd();
         }
-        static inline void runAsyncSinkWorker() noexcept {
-            auto& workerState = asyncSinkState();
-            for (;;) {
-                std::deque<AsyncSinkBatch> pending;
-                {
-                    std::unique_lock lock(workerState.mutex);
-                    workerState.ready.wait(lock, [&workerState] {
-                        return workerState.stop || !workerState.queue.empty();
-                    });
-                    if (workerState.queue.empty()) {
-                        if (workerState.stop) {
-                            break;
-                        }
-                        continue;
-                    }
-                    pending.swap(workerState.queue);
-                    workerState.writing = true;
-                }
 
-                switch (asyncSinkTargetModeStorage().load(std::memory_order_acquire)) {
-                    case AsyncSinkTargetMode::Custom:
-                        for (const auto& batch : pending) {
-                            writeToCustomSink(batch.data.data(), batch.size);
-                        }
-                        break;
-                    case AsyncSinkTargetMode::Default:
-                        defaultSinkWriteBatches(pending);
-                        break;
-                }
+        /**
+         * @brief Test-only helper that forces the log descriptor closed.
+         */
+        static inline void closeLogFdForTests() noexcept {
+            closeLogFd();
+        }
 
-                {
-                    std::lock_guard lock(workerState.mutex);
-                    for (auto& batch : pending) {
-                        batch.size = 0U;
-                        workerState.recycled.emplace_back(std::move(batch));
-                    }
-                    workerState.writing = false;
-                    if (workerState.queue.empty()) {
-                        workerState.drained.notify_all();
-                    }
-                }
-            }
-            switch (asyncSinkTargetModeStorage().load(std::memory_order_acquire)) {
-                case AsyncSinkTargetMode::Custom:
-                    flushCustomSink();
-                    break;
-                case AsyncSinkTargetMode::Default:
-                    defaultSinkFlush();
-                    break;
+        // ---------------------------------------------------------------------
+        // Live-scope registry and watchdog. Only SCOPE_TIMER_DEADLINE timers
+        // register, and only while the watchdog runs. Each thread owns a small
+        // stack guarded by its own mutex; the watchdog takes that mutex while
+        // it reads an open timer, so a timer cannot finish mid-report.
+        // ---------------------------------------------------------------------
+        struct LiveScope {
+            const ScopeTimer* timer{nullptr};
+            std::int64_t deadlineNs{0};
+            bool reported{false};
+        };
+
+        struct LiveScopeStack {
+            std::mutex mutex;
+            std::vector<LiveScope> scopes;
+            std::uint32_t threadNum{0U};
+        };
+
+        struct LiveScopeStackHandle {
+            std::shared_ptr<LiveScopeStack> stack{std::make_shared<LiveScopeStack>()};
+
+            LiveScopeStackHandle() {
+                stack->threadNum = getThreadIdNumber();
+                stack->scopes.reserve(8U);
+                std::lock_guard lock(liveScopeRegistryMutex());
+                liveScopeRegistry().emplace_back(stack);
             }
+        };
+
+        struct WatchdogState {
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::thread worker;
+            std::chrono::nanoseconds period{std::chrono::milliseconds(10)};
+            std::function<void(const Record&)> callback;
+            bool running{false};
+            bool stop{false};
+        };
+
+        static inline LiveScopeStack& liveScopeStack() noexcept {
+            thread_local LiveScopeStackHandle handle;
+            return *handle.stack;
+        }
+        static inline std::mutex& liveScopeRegistryMutex() noexcept {
+            return detail::singletonStorage<detail::LiveScopeRegistryMutexTag, std::mutex>();
+        }
+        static inline std::vector<std::weak_ptr<LiveScopeStack>>& liveScopeRegistry() noexcept {
+            return detail::singletonStorage<detail::LiveScopeRegistryTag, std::vector<std::weak_ptr<LiveScopeStack>>>();
+        }
+        static inline WatchdogState& watchdogState() noexcept {
+            return detail::singletonStorage<detail::WatchdogStateTag, WatchdogState>();
+        }
+        static inline std::atomic<bool>& watchdogRunningStorage() noexcept {
+            return detail::singletonStorage<detail::WatchdogRunningTag, std::atomic<bool>>(false);
         }
 
-        static inline void ensureAsyncSinkRunning() noexcept {
-            auto& state = asyncSinkState();
-            std::lock_guard lock(state.mutex);
-            if (state.running) {
+        inline void watchScope(std::chrono::nanoseconds deadline) noexcept {
+            if (disabled_ || !watchdogRunningStorage().load(std::memory_order_acquire)) {
                 return;
             }
-            state.stop = false;
-            state.writing = false;
-            state.running = true;
-            state.worker = std::thread([] { runAsyncSinkWorker(); });
+            auto& stack = liveScopeStack();
+            std::lock_guard lock(stack.mutex);
+            stack.scopes.push_back(LiveScope{this, deadline.count(), false});
+            watched_ = true;
         }
 
-        static inline void shutdownAsyncSink() noexcept {
-            auto& state = asyncSinkState();
+        inline void unwatchScope() noexcept {
+            auto& stack = liveScopeStack();
+            std::lock_guard lock(stack.mutex);
+            for (auto it = stack.scopes.rbegin(); it != stack.scopes.rend(); ++it) {
+                if (it->timer == this) {
+                    stack.scopes.erase(std::next(it).base());
+                    break;
+                }
+            }
+            watched_ = false;
+        }
+
+        static inline void shutdownWatchdog() noexcept {
+            auto& state = watchdogState();
             std::unique_lock lock(state.mutex);
             if (!state.running) {
                 return;
             }
             state.stop = true;
             lock.unlock();
-            state.ready.notify_all();
+            state.wake.notify_all();
             if (state.worker.joinable()) {
                 state.worker.join();
             }
             lock.lock();
-            state.stop = false;
             state.running = false;
-            state.writing = false;
+            state.stop = false;
+            watchdogRunningStorage().store(false, std::memory_order_release);
         }
 
-        // Test-only sink swap; safe when called during single-threaded setup/teardown.
-        static inline void setLogSinkForTests(
-            std::function<void(const char*, std::size_t)> writeFn = {},
-            std::function<void()> flushFn = {}
-        ) {
-            setCustomSinkCallbacks(std::move(writeFn), std::move(flushFn));
+        static inline void runWatchdog() noexcept {
+            auto& state = watchdogState();
+            std::unique_lock lock(state.mutex);
+            std::vector<OverdueScope> overdue;
+            while (!state.stop) {
+                state.wake.wait_for(lock, state.period, [&state] { return state.stop; });
+                if (state.stop) {
+                    break;
+                }
+                std::function<void(const Record&)> callback;
+                overdue.clear();
+                try {
+                    // Scanned with the state mutex held so fork() never splits a scan.
+                    collectOverdueScopes(overdue);
+                    callback = state.callback;
+                } catch (...) {
+                    // Out of memory: report what was copied, as text.
+                }
+                if (overdue.empty()) {
+                    continue;
+                }
+                // Reported unlocked, so a slow sink or callback never holds up the timed threads.
+                lock.unlock();
+                reportOverdueScopes(overdue, callback);
+                lock.lock();
+            }
         }
 
-        static inline void setCustomSinkCallbacks(
-            std::function<void(const char*, std::size_t)> writeFn = {},
-            std::function<void()> flushFn = {}
-        ) {
-            std::lock_guard sinkStateLock(sinkConfigMutex());
-            flushAllThreadBuffers();
-            asyncSinkFlush();
-            shutdownAsyncSink();
-            closeLogFd();
+        static inline std::vector<std::shared_ptr<LiveScopeStack>> snapshotLiveScopeStacks() noexcept {
+            std::vector<std::shared_ptr<LiveScopeStack>> stacks;
+            std::lock_guard lock(liveScopeRegistryMutex());
+            auto& registry = liveScopeRegistry();
+            registry.erase(
+                std::remove_if(registry.begin(), registry.end(), [&stacks](const auto& weakStack) {
+                    if (auto stack = weakStack.lock()) {
+                        stacks.push_back(stack);
+                        return false;
+                    }
+                    return true;
+                }),
+                registry.end()
+            );
+            return stacks;
+        }
 
-            const bool asyncModeActive = activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::ThreadBuffered
-                && bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Async;
+        /**
+         * @brief Copy of a scope past its deadline, taken so it can be reported after the locks are released.
+         */
+        struct OverdueScope {
+            const CallSite* site{nullptr};
+            std::string where;
+            std::string label;
+            std::uint32_t threadNum{0U};
+            std::int64_t startSteadyNs{0};
+            std::int64_t nowSteadyNs{0};
+            std::int64_t deadlineNs{0};
+        };
 
-            customLogSinkStorage() = nullptr;
-            customSinkWriteStorage() = std::move(writeFn);
-            customSinkFlushStorage() = flushFn ? std::move(flushFn) : std::function<void()>{};
-            updateCustomSinkRouting(asyncModeActive);
+        /**
+         * @brief Marks newly overdue scopes as reported and copies them into @p out (may throw bad_alloc).
+         */
+        static inline void collectOverdueScopes(std::vector<OverdueScope>& out) {
+            const auto now = std::chrono::steady_clock::now();
+            const std::int64_t nowNs = steadyNs(now);
+            for (const auto& stack : snapshotLiveScopeStacks()) {
+                std::lock_guard lock(stack->mutex);
+                for (auto& scope : stack->scopes) {
+                    const ScopeTimer& timer = *scope.timer;
+                    const auto runningNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - timer.startSteady_).count();
+                    if (scope.reported || runningNs < scope.deadlineNs) {
+                        continue;
+                    }
+                    out.push_back(OverdueScope{timer.site_, std::string(timer.where_), std::string(timer.label_),
+                                               timer.threadNum_, steadyNs(timer.startSteady_), nowNs, scope.deadlineNs});
+                    scope.reported = true;
+                }
+            }
         }
 
-        static inline void setCustomLogSink(LogSink* sink) {
-            std::lock_guard sinkStateLock(sinkConfigMutex());
-            flushAllThreadBuffers();
-            asyncSinkFlush();
-            shutdownAsyncSink();
-            closeLogFd();
+        static inline void reportOverdueScopes(const std::vector<OverdueScope>& overdue,
+                                               const std::function<void(const Record&)>& callback) noexcept {
+            for (const auto& scope : overdue) {
+                if (callback) {
+                    Record rec;
+                    rec.site = scope.site;
+                    rec.where = scope.where;
+                    rec.label = scope.label;
+                    rec.threadNum = scope.threadNum;
+                    rec.startSteadyNs = scope.startSteadyNs;
+                    rec.endSteadyNs = scope.nowSteadyNs;
+                    rec.stillRunning = true;
+                    callback(rec);
+                } else {
+                    writeStillRunningLine(scope);
+                }
+            }
+        }
 
-            const bool asyncModeActive = activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::ThreadBuffered
-                && bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Async;
+        static inline void writeStillRunningLine(const OverdueScope& scope) noexcept {
+            char* line = lineBuffer().data;
+            char* cur = line;
+            const char* end = line + sizeof(LineBuffer::data) - 1U;
+            char value[32];
+            const std::int64_t runningNs = scope.nowSteadyNs - scope.startSteadyNs;
 
-            customLogSinkStorage() = sink;
-            customSinkWriteStorage() = {};
-            customSinkFlushStorage() = {};
-            updateCustomSinkRouting(asyncModeActive);
+            appendCharTruncating(cur, end, '[');
+            appendBytesTruncating(cur, end, scope.label.data(), scope.label.size());
+            appendBytesTruncating(cur, end, "] TID=", sizeof("] TID=") - 1U);
+            appendThreadIdTruncating(cur, end, scope.threadNum);
+            appendBytesTruncating(cur, end, " | ", sizeof(" | ") - 1U);
+            appendBytesTruncating(cur, end, scope.where.data(), scope.where.size());
+            if (includeWallTime()) {
+                appendBytesTruncating(cur, end, " | start=", sizeof(" | start=") - 1U);
+                appendBytesTruncating(cur, end, value,
+                                      formatTime(wallTimeFromNs(scope.startSteadyNs + wallClockOffsetNs(scope.nowSteadyNs)), value, sizeof(value)));
+            }
+            appendBytesTruncating(cur, end, " | deadline=", sizeof(" | deadline=") - 1U);
+            appendBytesTruncating(cur, end, value, formatElapsed(scope.deadlineNs, value, sizeof(value)));
+            appendBytesTruncating(cur, end, " | running=", sizeof(" | running=") - 1U);
+            appendBytesTruncating(cur, end, value, formatElapsed(runningNs, value, sizeof(value)));
+            appendCharTruncating(cur, end, '\n');
+            *cur = '\0';
+
+            const auto len = static_cast<std::size_t>(cur - line);
+            const auto activeSink = activeSinkStorage().load(std::memory_order_acquire);
+            if (activeSink != ActiveSink::ThreadBuffered) {
+                std::lock_guard lock(outMutex());
+                writeToActiveSink(activeSink, line, len);
+            } else {
+                writeToActiveSink(activeSink, line, len);
+            }
+            // Stall reports are rare and time sensitive; publish them now.
+            flushActiveSink(activeSink);
         }
 
-        static inline void updateCustomSinkRouting(bool asyncModeActive) {
-            if (hasCustomSink()) {
-                if (activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::Default) {
-                    activeSinkStorage().store(ActiveSink::Custom, std::memory_order_release);
+        /**
+         * @brief "[sampler] file:line | where | suppressed=N" for flushSuppressedSamples().
+         */
+        static inline void writeSuppressedLine(const CallSite& site, std::uint64_t count) noexcept {
+            char* line = lineBuffer().data;
+            char* cur = line;
+            const char* end = line + sizeof(LineBuffer::data) - 1U;
+
+            appendBytesTruncating(cur, end, "[sampler] ", sizeof("[sampler] ") - 1U);
+            if (site.file != nullptr) {
+                appendBytesTruncating(cur, end, site.file, std::strlen(site.file));
+                appendCharTruncating(cur, end, ':');
+                appendUnsignedTruncating(cur, end, site.line);
+                appendBytesTruncating(cur, end, " | ", sizeof(" | ") - 1U);
+            }
+            const std::string_view where = siteWhere(site);
+            appendBytesTruncating(cur, end, where.data(), where.size());
+            appendBytesTruncating(cur, end, " | suppressed=", sizeof(" | suppressed=") - 1U);
+            appendUnsignedTruncating(cur, end, count);
+            appendCharTruncating(cur, end, '\n');
+            *cur = '\0';
+
+            const auto len = static_cast<std::size_t>(cur - line);
+            const auto activeSink = activeSinkStorage().load(std::memory_order_acquire);
+            if (activeSink != ActiveSink::ThreadBuffered) {
+                std::lock_guard lock(outMutex());
+                writeToActiveSink(activeSink, line, len);
+            } else {
+                writeToActiveSink(activeSink, line, len);
+            }
+        }
+
+        static inline bool labelUsesLocalBufferForTests(const ScopeTimer& timer) noexcept {
+            const char* ptr = timer.label_.data();
+            const char* begin = timer.labelBuffer_.data();
+            const char* end = begin + timer.labelBuffer_.size();
+            return ptr >= begin && ptr < end;
+        }
+
+        static inline bool labelUsesHeapForTests(const ScopeTimer& timer) noexcept {
+            return !timer.labelHeapStorage_.empty() && timer.label_.data() == timer.labelHeapStorage_.data();
+        }
+
+        static inline bool labelUsesBorrowedStorageForTests(const ScopeTimer& timer) noexcept {
+            return !labelUsesLocalBufferForTests(timer) && !labelUsesHeapForTests(timer);
+        }
+
+        /**
+         * I store only a steady_clock start: it gives elapsed durations immune to system clock
+         * changes, and start=/end= wall times are derived from it through wallClockOffsetNs()
+         * when a line or record is produced.
+         */
+        std::chrono::steady_clock::time_point startSteady_; ///< Start time for high-resolution elapsed duration.
+        /// Negated thread CPU clock at start, then the CPU time spent once the scope ends.
+        static constexpr std::int64_t NoCpuTime = std::numeric_limits<std::int64_t>::min();
+        std::int64_t cpuNs_{NoCpuTime};
+        /// Counter values at start, then the deltas once the scope ends.
+        PerfCounts perf_{};
+        bool perfCounting_{false};
+        /// getrusage values at start, then the deltas; SCOPE_TIMER_RUSAGE timers only.
+        ResourceUsage rusage_{};
+        bool rusageCounting_{false};
+        /// Thread allocation totals at start, then the scope's own counts.
+        AllocationCounts allocations_{};
+        bool allocCounting_{false};
+
+        /**
+         * @brief Indicates if this timer instance is disabled.
+         *
+         * In Debug builds, this is set to true if the SCOPE_TIMER environment variable disables timing
+         * (i.e., set to "OFF", "FALSE", "NO", or "0", case-insensitive). This check is performed once
+         * in the constructor to avoid repeated environment variable lookups for every timing event.
+         *
+         * In Release builds, this field is always unused and the timer is a no-op.
+         *
+         * This mechanism allows runtime control of timing/logging overhead in Debug builds, while ensuring
+         * no performance impact in Release builds.
+         */
+        bool disabled_{ false };
+        bool hotPathMode_{ false };
+        bool watched_{ false }; ///< Registered in the live-scope stack (deadline timers only).
+        /// AsyncScopeTimer only: total suspended time (-1 for ordinary timers) and cross-thread resumes.
+        std::int64_t suspendedNs_{-1};
+        std::uint32_t migrations_{0U};
+        std::uint64_t correlationId_{0U}; ///< ScopeSpan request id; zero when none.
+        std::uint64_t suppressed_{0U}; ///< Calls the callsite's Sampler skipped before admitting this one.
+        const LapSplits* laps_{nullptr}; ///< Owned by the enclosing LapScopeTimer, which outlives this timer.
+        const LoopStats* loop_{nullptr}; ///< Owned by the enclosing LoopScopeTimer; set as the loop ends.
+    };
+
+    namespace detail {
+        struct StaticSamplerTag {};
+
+        class ConditionalScopeTimer {
+        public:
+            template <typename LabelFactory>
+            ConditionalScopeTimer(bool enabled, std::string_view where, LabelFactory&& labelFactory) noexcept {
+                if (enabled) {
+                    timer_.emplace(where, labelFactory());
+                } else {
+                    (void)where;
                 }
-                if (bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Default) {
-                    bufferedSinkTargetModeStorage().store(BufferedSinkTargetMode::Custom, std::memory_order_release);
+            }
+
+            template <typename LabelFactory>
+            ConditionalScopeTimer(bool enabled, const ScopeTimer::CallSite& site, LabelFactory&& labelFactory) noexcept {
+                if (enabled) {
+                    timer_.emplace(site, labelFactory());
                 }
-                asyncSinkTargetModeStorage().store(AsyncSinkTargetMode::Custom, std::memory_order_release);
-            } else {
-                if (activeSinkStorage().load(std::memory_order_acquire) == ActiveSink::Custom) {
-                    activeSinkStorage().store(ActiveSink::Default, std::memory_order_release);
+            }
+
+            /**
+             * @brief Sampling macros: nothing is read or copied unless @p sampler admits the call.
+             */
+            template <typename LabelFactory>
+            ConditionalScopeTimer(ScopeTimer::Sampler& sampler, const ScopeTimer::CallSite& site, LabelFactory&& labelFactory) noexcept {
+                if (sampler.admit()) {
+                    timer_.emplace(sampler, site, labelFactory());
                 }
-                if (bufferedSinkTargetModeStorage().load(std::memory_order_acquire) == BufferedSinkTargetMode::Custom) {
-                    bufferedSinkTargetModeStorage().store(BufferedSinkTargetMode::Default, std::memory_order_release);
+            }
+
+            /**
+             * @brief Function-local static samplers: as above, and enlists the sampler for the exit report.
+             */
+            template <typename LabelFactory>
+            ConditionalScopeTimer(StaticSamplerTag, ScopeTimer::Sampler& sampler, const ScopeTimer::CallSite& site,
+                                  LabelFactory&& labelFactory) noexcept {
+                if (sampler.admitEnlisting(site)) {
+                    timer_.emplace(sampler, site, labelFactory());
                 }
-                asyncSinkTargetModeStorage().store(AsyncSinkTargetMode::Default, std::memory_order_release);
             }
 
-            if (asyncModeActive) {
-                ensureAsyncSinkRunning();
+            ~ConditionalScopeTimer() = default;
+            ConditionalScopeTimer(const ConditionalScopeTimer&) = delete;
+            ConditionalScopeTimer& operator=(const ConditionalScopeTimer&) = delete;
+            ConditionalScopeTimer(ConditionalScopeTimer&&) = delete;
+            ConditionalScopeTimer& operator=(ConditionalScopeTimer&&) = delete;
+
+        private:
+            std::optional<ScopeTimer> timer_;
+        };
+    } // namespace detail
+
+    /**
+     * @brief Timer for a scope that suspends, such as a coroutine body spanning co_await.
+     *
+     * Call suspend() before the scope gives up its thread and resume() once it
+     * runs again, possibly on another thread. The record keeps the wall-clock
+     * elapsed time and adds active=, suspended= and migrations= (resumes on a
+     * different thread than the one that suspended). TID= is the thread that
+     * started the scope. CPU time, perf counters, resource usage and
+     * allocation counts cover only the active stretches, each read on the
+     * thread that ran it. With C++20 coroutines, timedAwait() makes the calls.
+     */
+    class AsyncScopeTimer {
+    public:
+        explicit AsyncScopeTimer(const ScopeTimer::CallSite& site, detail::LabelData labelData = detail::LabelData{}) noexcept
+            : timer_(site, std::move(labelData)) {
+            if (!timer_.disabled_) {
+                timer_.suspendedNs_ = 0;
+                runningThread_ = timer_.threadNum_;
             }
         }
 
-        // Test-only: allow buffered sink to flush to a custom target (e.g., in-memory sink).
-        static inline void setBufferedSinkTargetForTests(
-            std::function<void(const char*, std::size_t)> writeFn = {}
-        ) {
-            std::lock_guard sinkStateLock(sinkConfigMutex());
-            flushAllThreadBuffers();
-            asyncSinkFlush();
-            shutdownAsyncSink();
-            bufferedTestSinkWriteStorage() = std::move(writeFn);
-            bufferedSinkTargetModeStorage().store(
-                bufferedTestSinkWriteStorage() ? BufferedSinkTargetMode::TestCustom : BufferedSinkTargetMode::Default,
-                std::memory_order_release
-            );
+        /**
+         * @brief A scope destroyed while suspended (e.g. a cancelled coroutine) counts as suspended until now.
+         */
+        ~AsyncScopeTimer() {
+            resume();
         }
 
-        inline void assignLabel(detail::LabelData data) noexcept {
-            const std::string_view source = !data.storage.empty() ? std::string_view{data.storage} : data.view;
-            if (source.empty()) {
-                label_ = "ScopeTimer";
+        AsyncScopeTimer(const AsyncScopeTimer&) = delete;
+        AsyncScopeTimer& operator=(const AsyncScopeTimer&) = delete;
+        AsyncScopeTimer(AsyncScopeTimer&&) = delete;
+        AsyncScopeTimer& operator=(AsyncScopeTimer&&) = delete;
+
+        void suspend() noexcept {
+            if (timer_.disabled_ || suspended_) {
                 return;
             }
+            suspended_ = true;
+            if (timer_.cpuNs_ != ScopeTimer::NoCpuTime) {
+                timer_.cpuNs_ += ScopeTimer::threadCpuTimeNs();
+            }
+            rebaseThreadCounters();
+            suspendedAt_ = std::chrono::steady_clock::now();
+        }
 
-            if (data.canBorrowView()) {
-                label_ = source;
-                labelHeapStorage_.clear();
+        void resume() noexcept {
+            if (!suspended_) {
                 return;
             }
+            suspended_ = false;
+            timer_.suspendedNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - suspendedAt_).count();
+            const std::uint32_t thread = ScopeTimer::getThreadIdNumber();
+            if (thread != runningThread_) {
+                ++timer_.migrations_;
+                runningThread_ = thread;
+            }
+            if (timer_.cpuNs_ != ScopeTimer::NoCpuTime) {
+                timer_.cpuNs_ -= ScopeTimer::threadCpuTimeNs();
+            }
+            rebaseThreadCounters();
+        }
 
-            if (source.size() < labelBuffer_.size()) {
-                std::memcpy(labelBuffer_.data(), source.data(), source.size());
-                label_ = std::string_view{labelBuffer_.data(), source.size()};
-                labelHeapStorage_.clear();
-            } else {
-                labelHeapStorage_ = !data.storage.empty() ? std::move(data.storage) : std::string(source);
-                label_ = labelHeapStorage_;
+        bool suspended() const noexcept {
+            return suspended_;
+        }
+
+    private:
+        /**
+         * @brief Flips the thread-bound counters between start values and running totals.
+         *
+         * The same x = now - x step turns start values into the active total at
+         * suspend(), and that total into start values on the new thread at resume().
+         * Perf counts stay raw here; the timer scales them once at scope end.
+         */
+        void rebaseThreadCounters() noexcept {
+            if (timer_.perfCounting_) {
+                timer_.perfCounting_ = ScopeTimer::flipPerfCounters(timer_.perf_);
+            }
+            if (timer_.rusageCounting_) {
+                timer_.rusageCounting_ = ScopeTimer::finishResourceUsage(timer_.rusage_);
+            }
+            if (timer_.allocCounting_) {
+                const ScopeTimer::AllocationCounts& now = ScopeTimer::threadAllocations();
+                timer_.allocations_.count = now.count - timer_.allocations_.count;
+                timer_.allocations_.bytes = now.bytes - timer_.allocations_.bytes;
             }
         }
 
-        std::string_view where_; ///< Description of the scope being timed.
-        std::string_view label_{ "ScopeTimer" }; ///< Label for the log output.
-        std::array<char, 128> labelBuffer_{};
-        std::string labelHeapStorage_;
-        uint32_t threadNum_{0}; ///< Unique thread ID number.
+        ScopeTimer timer_;
+        std::chrono::steady_clock::time_point suspendedAt_{};
+        std::uint32_t runningThread_{0U};
+        bool suspended_{false};
+    };
 
-        static inline thread_local FormatBuffers tlsFormatBuffers_{};
-        static inline thread_local LineBuffer tlsLineBuffer_{};
-        static inline std::string logDirCache_{"/tmp/"};
-        static inline bool logDirInitialized_{false};
+    /**
+     * @brief Movable handle for timing work that does not fit a lexical scope.
+     *
+     * The span starts when constructed and ends at finish(), or when the last
+     * handle is destroyed. It can be moved into a callback and finished on another
+     * thread, and it goes through the same sinks as a ScopeTimer. The timer
+     * lives inside the handle, so moves never allocate. TID= is the starting
+     * thread. A span that finishes on another thread drops its per-thread
+     * counters (CPU time, perf, resource usage, allocations). A non-zero
+     * correlation id is printed as corr= and set in Record::correlationId.
+     */
+    class ScopeSpan {
+    public:
+        ScopeSpan() noexcept = default;
 
-        static inline int openLogFileForAppend(const std::string& path) noexcept {
-#if defined(_WIN32)
-            int openFlags = _O_CREAT | _O_WRONLY | _O_APPEND;
-#ifdef _O_BINARY
-            openFlags |= _O_BINARY;
-#endif
-#ifdef _O_NOINHERIT
-            openFlags |= _O_NOINHERIT;
-#endif
-            return ::_open(path.c_str(), openFlags, _S_IREAD | _S_IWRITE);
-#else
-            int openFlags = O_CREAT | O_WRONLY | O_APPEND;
-#ifdef O_CLOEXEC
-            openFlags |= O_CLOEXEC;
-#endif
-            const int fd = ::open(path.c_str(), openFlags, 0600);
-#ifndef O_CLOEXEC
-            if (fd >= 0) {
-                (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
-            }
-#endif
-            return fd;
-#endif
+        explicit ScopeSpan(const ScopeTimer::CallSite& site, detail::LabelData labelData = detail::LabelData{},
+                           std::uint64_t correlationId = 0U) noexcept {
+            start(site, std::move(labelData))->correlationId_ = correlationId;
         }
 
-        static inline void closeFd(int fd) noexcept {
-#if defined(_WIN32)
-            (void)::_close(fd);
-#else
-            (void)::close(fd);
-#endif
+        explicit ScopeSpan(std::string_view where, detail::LabelData labelData = detail::LabelData{},
+                           std::uint64_t correlationId = 0U) noexcept {
+            start(where, std::move(labelData))->correlationId_ = correlationId;
         }
 
-        static inline void writeFdBestEffort(int fd, const char* data, std::size_t len) noexcept {
-#if defined(_WIN32)
-            const auto maxChunk = static_cast<std::size_t>(std::numeric_limits<unsigned int>::max());
-            const auto chunkLen = static_cast<unsigned int>(std::min(len, maxChunk));
-            const int unused = ::_write(fd, data, chunkLen);
-            (void)unused;
-#else
-            const ssize_t unused = ::write(fd, data, len);
-            (void)unused;
-#endif
+        ScopeSpan(ScopeSpan&& other) noexcept {
+            takeFrom(other);
         }
 
         /**
-         * @brief Opens the default log file descriptor on first use (best-effort).
+         * @brief Finishes the span currently held, then takes over @p other.
          */
-        static inline bool ensureLogFdOpen() noexcept {
-            int& fd = logFd();
-            if (fd >= 0) {
-                return true;
+        ScopeSpan& operator=(ScopeSpan&& other) noexcept {
+            if (this != &other) {
+                finish();
+                takeFrom(other);
             }
+            return *this;
+        }
 
-            static std::string lastFailedPath;
-            static bool lastAttemptFailed = false;
-
-            const std::string path = logDirectory() + "ScopeTimer.log";
+        ScopeSpan(const ScopeSpan&) = delete;
+        ScopeSpan& operator=(const ScopeSpan&) = delete;
 
-            if (lastAttemptFailed && path == lastFailedPath) {
-                return false;
-            }
+        ~ScopeSpan() {
+            finish();
+        }
 
-            if (int newFd = openLogFileForAppend(path); newFd >= 0) {
-                fd = newFd;
-                lastAttemptFailed = false;
-                lastFailedPath.clear();
-                registerLogFdCleanup();
-                return true;
+        /**
+         * @brief Ends the span and writes its record; later calls do nothing.
+         */
+        void finish() noexcept {
+            if (ScopeTimer* timer = this->timer()) {
+                timer->dropThreadCountersIfMigrated();
+                stop();
             }
-
-            lastFailedPath = path;
-            lastAttemptFailed = true;
-            return false;
         }
 
         /**
-         * @brief Registers the atexit handler that closes the log descriptor.
+         * @brief Drops the span without writing a record.
          */
-        static inline void registerLogFdCleanup() noexcept {
-            static bool registered = false;
-            if (!registered) {
-                std::atexit([]() noexcept {
-                    std::lock_guard sinkStateLock(sinkConfigMutex());
-                    flushAllThreadBuffers();
-                    asyncSinkFlush();
-                    shutdownAsyncSink();
-                    closeLogFd();
-                });
-                registered = true;
+        void cancel() noexcept {
+            if (ScopeTimer* timer = this->timer()) {
+                timer->disabled_ = true;
+                stop();
+            }
+        }
+
+        void setCorrelationId(std::uint64_t correlationId) noexcept {
+            if (ScopeTimer* timer = this->timer()) {
+                timer->correlationId_ = correlationId;
             }
         }
 
+        bool active() const noexcept {
+            const ScopeTimer* timer = this->timer();
+            return timer != nullptr && !timer->disabled_;
+        }
+
+    private:
         /**
-         * @brief Singleton storage for the log descriptor.
+         * @brief Constructs the held timer in place; the span must not hold one.
+         *
+         * Placement-new rather than std::optional so ScopeTimer's relocating
+         * constructor can stay private to its friends.
          */
-        static inline int logFdStorage_{-1};
-        static inline int& logFd() noexcept {
-            return logFdStorage_;
+        template <typename... Args>
+        ScopeTimer* start(Args&&... args) noexcept {
+            ScopeTimer* timer = ::new (static_cast<void*>(storage_.data())) ScopeTimer(std::forward<Args>(args)...);
+            engaged_ = true;
+            return timer;
         }
 
         /**
-         * @brief Resets the log descriptor so it will be reopened on demand.
+         * @brief Destroys the held timer, which writes its record unless it is disabled.
          */
-        static inline void closeLogFd() noexcept {
-            int& fd = logFd();
-            if (fd >= 0) {
-                closeFd(fd);
-                fd = -1;
+        void stop() noexcept {
+            ScopeTimer* timer = this->timer();
+            engaged_ = false;
+            timer->~ScopeTimer();
+        }
+
+        ScopeTimer* timer() noexcept {
+            return engaged_ ? std::launder(reinterpret_cast<ScopeTimer*>(storage_.data())) : nullptr;
+        }
+
+        const ScopeTimer* timer() const noexcept {
+            return engaged_ ? std::launder(reinterpret_cast<const ScopeTimer*>(storage_.data())) : nullptr;
+        }
+
+        void takeFrom(ScopeSpan& other) noexcept {
+            if (ScopeTimer* source = other.timer()) {
+                start(ScopeTimer::RelocateTag{}, *source);
+                other.stop(); // disabled by the relocation, so it writes nothing
+            }
+        }
+
+        alignas(ScopeTimer) std::array<std::byte, sizeof(ScopeTimer)> storage_;
+        bool engaged_{false};
+    };
+
+    /**
+     * @brief Timer for a multi-phase scope: SCOPE_TIMER_LAP checkpoints go into one record.
+     *
+     * Each lap stores the time since the previous lap (or the start) in fixed
+     * inline storage, and the line gets one lap:<name>= field per lap next to
+     * elapsed=. One timer with five laps costs one record instead of five
+     * nested timers. Laps past LapSplits::Capacity are only counted, in
+     * laps-dropped=. The timer becomes its thread's current lap timer until
+     * it is destroyed, so SCOPE_TIMER_LAP in a callee adds to the innermost
+     * one.
+     */
+    class LapScopeTimer {
+    public:
+        explicit LapScopeTimer(const ScopeTimer::CallSite& site, detail::LabelData labelData = detail::LabelData{}) noexcept
+            : timer_(site, std::move(labelData)) {
+            if (timer_.disabled_) {
+                return;
+            }
+            timer_.laps_ = &laps_;
+            lastLap_ = timer_.startSteady_;
+            previous_ = current();
+            current() = this;
+            registered_ = true;
+        }
+
+        ~LapScopeTimer() {
+            if (registered_) {
+                current() = previous_;
             }
         }
 
+        LapScopeTimer(const LapScopeTimer&) = delete;
+        LapScopeTimer& operator=(const LapScopeTimer&) = delete;
+        LapScopeTimer(LapScopeTimer&&) = delete;
+        LapScopeTimer& operator=(LapScopeTimer&&) = delete;
+
         /**
-         * @brief Test-only accessor to observe the current log descriptor.
+         * @brief Closes the current phase under @p name (a string literal; only the pointer is kept).
          */
-        static inline int defaultLogFdForTests() noexcept {
-            return logFd();
+        template <std::size_t N>
+        void lap(const char (&name)[N]) noexcept {
+            lap(std::string_view{name, N - 1U});
         }
 
         /**
-         * @brief Test-only helper that forces the log descriptor closed.
+         * @brief SCOPE_TIMER_LAP entry point: laps the thread's innermost LapScopeTimer, if any.
          */
-        static inline void closeLogFdForTests() noexcept {
-            closeLogFd();
+        template <std::size_t N>
+        static void lapCurrent(const char (&name)[N]) noexcept {
+            if (LapScopeTimer* timer = current()) {
+                timer->lap(std::string_view{name, N - 1U});
+            }
         }
 
-        static inline bool labelUsesLocalBufferForTests(const ScopeTimer& timer) noexcept {
-            const char* ptr = timer.label_.data();
-            const char* begin = timer.labelBuffer_.data();
-            const char* end = begin + timer.labelBuffer_.size();
-            return ptr >= begin && ptr < end;
+    private:
+        void lap(std::string_view name) noexcept {
+            if (laps_.count == ScopeTimer::LapSplits::Capacity) {
+                ++laps_.dropped;
+                return;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            laps_.splits[laps_.count++] = ScopeTimer::LapSplit{
+                name, std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastLap_).count()};
+            lastLap_ = now;
         }
 
-        static inline bool labelUsesHeapForTests(const ScopeTimer& timer) noexcept {
-            return !timer.labelHeapStorage_.empty() && timer.label_.data() == timer.labelHeapStorage_.data();
+        static LapScopeTimer*& current() noexcept {
+            static thread_local LapScopeTimer* timer = nullptr;
+            return timer;
         }
 
-        static inline bool labelUsesBorrowedStorageForTests(const ScopeTimer& timer) noexcept {
-            return !labelUsesLocalBufferForTests(timer) && !labelUsesHeapForTests(timer);
+        // Declared before timer_ so the splits outlive the record written by its destructor.
+        ScopeTimer::LapSplits laps_{};
+        std::chrono::steady_clock::time_point lastLap_{};
+        LapScopeTimer* previous_{nullptr};
+        bool registered_{false};
+        ScopeTimer timer_;
+    };
+
+    /**
+     * @brief Timer for a hot loop: counts iterations and times every Nth one.
+     *
+     * The loop scope writes one record with iterations= and iter-mean= (scope
+     * time over iterations), plus the sampled min, p50, p90, p99 and max when
+     * sampleEvery is non-zero. An iteration that is not sampled costs a
+     * counter update, and a sampled one costs two clock reads. Samples go
+     * into fixed inline storage. When it fills, every other sample is dropped
+     * and the stride doubles, so long loops stay evenly sampled without
+     * allocating.
+     */
+    class LoopScopeTimer {
+    public:
+        static constexpr std::size_t SampleCapacity = 256U;
+
+        /**
+         * @brief Guard for one iteration; declare it first in the loop body (SCOPE_TIMER_ITERATION).
+         */
+        class Iteration {
+        public:
+            explicit Iteration(LoopScopeTimer& loop) noexcept : loop_(loop) {
+                ++loop.iterations_;
+                if (loop.sampleEvery_ != 0U && --loop.untilSample_ == 0U) {
+                    loop.untilSample_ = loop.sampleEvery_;
+                    start_ = std::chrono::steady_clock::now();
+                    sampled_ = true;
+                }
+            }
+
+            ~Iteration() {
+                if (sampled_) {
+                    loop_.addSample(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_).count());
+                }
+            }
+
+            Iteration(const Iteration&) = delete;
+            Iteration& operator=(const Iteration&) = delete;
+            Iteration(Iteration&&) = delete;
+            Iteration& operator=(Iteration&&) = delete;
+
+        private:
+            LoopScopeTimer& loop_;
+            std::chrono::steady_clock::time_point start_{};
+            bool sampled_{false};
+        };
+
+        explicit LoopScopeTimer(const ScopeTimer::CallSite& site, std::uint32_t sampleEvery,
+                                detail::LabelData labelData = detail::LabelData{}) noexcept
+            : timer_(site, std::move(labelData)) {
+            if (!timer_.disabled_) {
+                sampleEvery_ = sampleEvery;
+                untilSample_ = sampleEvery;
+            }
         }
 
         /**
-         * I store both a steady_clock (startSteady_) and a system_clock (startWall_) timestamp:
-         * - startSteady_: Used for computing precise elapsed durations, immune to system clock changes.
-         * - startWall_: Used for logging human-readable absolute start times for contextual information.
-         * This dual tracking ensures logs contain meaningful wall times while preserving accurate duration measurements.
+         * @brief Summarizes the loop so the record written by timer_ can carry it.
          */
-        static constexpr std::size_t TimestampBufSize = 32;
+        ~LoopScopeTimer() {
+            if (timer_.disabled_) {
+                return;
+            }
+            stats_.iterations = iterations_;
+            if (iterations_ != 0U) {
+                const std::int64_t scopeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - timer_.startSteady_).count();
+                stats_.meanNs = scopeNs / static_cast<std::int64_t>(iterations_);
+            }
+            if (sampleCount_ != 0U) {
+                std::sort(samples_.begin(), samples_.begin() + static_cast<std::ptrdiff_t>(sampleCount_));
+                stats_.p50Ns = percentile(50U);
+                stats_.p90Ns = percentile(90U);
+                stats_.p99Ns = percentile(99U);
+            }
+            timer_.loop_ = &stats_;
+        }
 
-        std::chrono::steady_clock::time_point startSteady_; ///< Start time for high-resolution elapsed duration.
+        LoopScopeTimer(const LoopScopeTimer&) = delete;
+        LoopScopeTimer& operator=(const LoopScopeTimer&) = delete;
+        LoopScopeTimer(LoopScopeTimer&&) = delete;
+        LoopScopeTimer& operator=(LoopScopeTimer&&) = delete;
+
+    private:
+        void addSample(std::int64_t ns) noexcept {
+            if (stats_.sampled++ == 0U) {
+                stats_.minNs = ns;
+                stats_.maxNs = ns;
+            } else {
+                stats_.minNs = std::min(stats_.minNs, ns);
+                stats_.maxNs = std::max(stats_.maxNs, ns);
+            }
+            if (sampleCount_ == SampleCapacity) {
+                // Keep the samples at even positions of the doubled stride; this
+                // one sits at an odd position, so it only counts toward min/max.
+                for (std::size_t i = 0; i < SampleCapacity / 2U; ++i) {
+                    samples_[i] = samples_[(2U * i) + 1U];
+                }
+                sampleCount_ = SampleCapacity / 2U;
+                if (sampleEvery_ <= std::numeric_limits<std::uint32_t>::max() / 2U) {
+                    sampleEvery_ *= 2U;
+                }
+                return;
+            }
+            samples_[sampleCount_++] = ns;
+        }
 
         /**
-         * @brief Stores the real-world wall clock timestamp at timer start.
-         *
-         * This is useful for logging absolute times in human-readable form (e.g., for log file timestamps).
-         * Unlike startSteady_ (which uses steady_clock for precise elapsed timing unaffected by system clock changes),
-         * startWall_ captures the actual wall clock time for contextual/logging purposes.
+         * @brief Nearest-rank percentile of the sorted samples.
          */
-        std::chrono::system_clock::time_point startWall_;
-        char startWallFormatted_[TimestampBufSize]{};
-        std::uint8_t startWallFormattedLen_{0};
+        std::int64_t percentile(std::size_t pct) const noexcept {
+            const std::size_t rank = ((sampleCount_ * pct) + 99U) / 100U;
+            return samples_[rank == 0U ? 0U : rank - 1U];
+        }
+
+        // Declared before timer_ so the summary outlives the record written by its destructor.
+        ScopeTimer::LoopStats stats_{};
+        std::array<std::int64_t, SampleCapacity> samples_{};
+        std::size_t sampleCount_{0U};
+        std::uint64_t iterations_{0U};
+        std::uint32_t sampleEvery_{0U};
+        std::uint32_t untilSample_{0U};
+        ScopeTimer timer_;
+    };
+
+    /**
+     * @brief Small timer for the common literal-label case (SCOPE_TIMER_COMPACT).
+     *
+     * Holds only the callsite descriptor, the label and the start tick, so a
+     * deep stack of instrumented frames keeps one cache line per timer instead
+     * of a full ScopeTimer. The full object is built only for the moment the
+     * record is written. Records carry no cpu=, perf or allocation fields, and
+     * dynamic labels still need SCOPE_TIMER.
+     */
+    class CompactScopeTimer {
+    public:
+        template <std::size_t N>
+        explicit CompactScopeTimer(const ScopeTimer::CallSite& site, const char (&label)[N]) noexcept
+            : label_(label), labelSize_(N ? static_cast<std::uint32_t>(N - 1U) : 0U) {
+            if (!ScopeTimer::isDisabled()) {
+                site_ = &site;
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~CompactScopeTimer() {
+            if (site_ != nullptr) {
+                ScopeTimer timer(ScopeTimer::CompactTag{}, *site_, std::string_view{label_, labelSize_}, start_);
+            }
+        }
+
+        CompactScopeTimer(const CompactScopeTimer&) = delete;
+        CompactScopeTimer& operator=(const CompactScopeTimer&) = delete;
+        CompactScopeTimer(CompactScopeTimer&&) = delete;
+        CompactScopeTimer& operator=(CompactScopeTimer&&) = delete;
+
+    private:
+        const ScopeTimer::CallSite* site_{nullptr}; ///< Null while timing is disabled.
+        const char* label_;
+        std::chrono::steady_clock::time_point start_{};
+        std::uint32_t labelSize_;
+    };
+
+    static_assert(sizeof(CompactScopeTimer) <= 32U, "CompactScopeTimer must stay within half a cache line");
+
+    /**
+     * @brief BasicScopeTimer clock policy reading std::chrono::steady_clock.
+     *
+     * A clock policy provides tick_type, now(), and elapsedNs(start, end).
+     */
+    struct SteadyClockPolicy {
+        using tick_type = std::chrono::steady_clock::time_point;
+
+        static tick_type now() noexcept {
+            return std::chrono::steady_clock::now();
+        }
+
+        static std::int64_t elapsedNs(tick_type start, tick_type end) noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        }
+    };
+
+#if defined(SCOPE_TIMER_HAS_TSC_CLOCK)
+    /**
+     * @brief BasicScopeTimer clock policy reading the x86 time-stamp counter.
+     *
+     * Assumes an invariant TSC, as on current x86-64 parts. Ticks are scaled to
+     * nanoseconds with a ratio measured against steady_clock on first use,
+     * which takes a few milliseconds once per process.
+     */
+    struct TscClockPolicy {
+        using tick_type = std::uint64_t;
+
+        static tick_type now() noexcept {
+            return __rdtsc();
+        }
 
         /**
-         * @brief Indicates if this timer instance is disabled.
-         *
-         * In Debug builds, this is set to true if the SCOPE_TIMER environment variable disables timing
-         * (i.e., set to "OFF", "FALSE", "NO", or "0", case-insensitive). This check is performed once
-         * in the constructor to avoid repeated environment variable lookups for every timing event.
-         *
-         * In Release builds, this field is always unused and the timer is a no-op.
-         *
-         * This mechanism allows runtime control of timing/logging overhead in Debug builds, while ensuring
-         * no performance impact in Release builds.
+         * @brief Zero when @p end reads earlier than @p start, as a migration between unsynchronized cores can.
          */
-        bool disabled_{ false };
-        bool hotPathMode_{ false };
+        static std::int64_t elapsedNs(tick_type start, tick_type end) noexcept {
+            const auto ticks = static_cast<std::int64_t>(end - start);
+            if (ticks <= 0) {
+                return 0;
+            }
+            return static_cast<std::int64_t>(static_cast<double>(ticks) * nsPerTick());
+        }
+
+        static double nsPerTick() noexcept {
+            static const double ratio = [] {
+                const auto steadyStart = std::chrono::steady_clock::now();
+                const tick_type tscStart = now();
+                auto steadyEnd = steadyStart;
+                while (steadyEnd - steadyStart < std::chrono::milliseconds(5)) {
+                    steadyEnd = std::chrono::steady_clock::now();
+                }
+                const tick_type ticks = now() - tscStart;
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(steadyEnd - steadyStart).count();
+                return ticks == 0U ? 1.0 : static_cast<double>(ns) / static_cast<double>(ticks);
+            }();
+            return ratio;
+        }
+    };
+#endif
+
+    /**
+     * @brief BasicScopeTimer sink policy that writes through ScopeTimer's configured sinks.
+     *
+     * A sink policy provides a static write(const ScopeTimer::ElapsedSample&).
+     * This one rebuilds a ScopeTimer at scope end, as CompactScopeTimer does,
+     * so text lines, record sinks and pipelines see an ordinary record.
+     */
+    struct ScopeTimerSinkPolicy {
+        static void write(const ScopeTimer::ElapsedSample& sample) noexcept {
+            ScopeTimer timer(ScopeTimer::CompactTag{}, *sample.site, sample.label, {});
+            // Anchored after construction so the record's elapsed stays close to the policy clock's.
+            timer.startSteady_ = std::chrono::steady_clock::now() - std::chrono::nanoseconds(sample.elapsedNs);
+        }
+    };
+
+    /**
+     * @brief BasicScopeTimer sink policy keeping the latest Capacity samples per thread.
+     *
+     * A write is one thread-local store with no locks, atomics or formatting.
+     * drain() visits the calling thread's samples oldest first and empties
+     * its ring; older samples are overwritten once the ring is full.
+     */
+    template <std::size_t Capacity>
+    struct ThreadRingSinkPolicy {
+        static_assert(Capacity != 0U && (Capacity & (Capacity - 1U)) == 0U, "Capacity must be a power of two");
+
+        struct Ring {
+            std::array<ScopeTimer::ElapsedSample, Capacity> samples{};
+            std::uint64_t written{0U}; ///< Total writes since the last drain, including overwritten ones.
+        };
+
+        static Ring& ring() noexcept {
+            thread_local Ring threadRing;
+            return threadRing;
+        }
+
+        static void write(const ScopeTimer::ElapsedSample& sample) noexcept {
+            Ring& r = ring();
+            r.samples[r.written++ & (Capacity - 1U)] = sample;
+        }
+
+        template <typename Fn>
+        static std::size_t drain(Fn&& fn) {
+            Ring& r = ring();
+            const std::uint64_t kept = std::min<std::uint64_t>(r.written, Capacity);
+            for (std::uint64_t i = r.written - kept; i != r.written; ++i) {
+                fn(static_cast<const ScopeTimer::ElapsedSample&>(r.samples[i & (Capacity - 1U)]));
+            }
+            r.written = 0U;
+            return static_cast<std::size_t>(kept);
+        }
+    };
+
+    /**
+     * @brief Literal-label timer whose clock and sink are chosen at compile time (SCOPE_TIMER_WITH).
+     *
+     * Capture and delivery call the policies directly, so a timer pinned to
+     * TscClockPolicy and a ThreadRingSinkPolicy inlines down to two counter
+     * reads and a store. BasicScopeTimer<> reads steady_clock and writes
+     * through ScopeTimer's configured sinks. SCOPE_TIMER=OFF still disables
+     * it. Formatting is left to the sink: ScopeTimerSinkPolicy follows the
+     * runtime line settings, and ring samples are never formatted.
+     */
+    template <typename ClockPolicy, typename SinkPolicy>
+    class BasicScopeTimer {
+    public:
+        template <std::size_t N>
+        explicit BasicScopeTimer(const ScopeTimer::CallSite& site, const char (&label)[N]) noexcept
+            : label_(label), labelSize_(N ? static_cast<std::uint32_t>(N - 1U) : 0U) {
+            if (!ScopeTimer::isDisabled()) {
+                site_ = &site;
+                start_ = ClockPolicy::now();
+            }
+        }
+
+        ~BasicScopeTimer() {
+            if (site_ != nullptr) {
+                const auto end = ClockPolicy::now();
+                SinkPolicy::write(ScopeTimer::ElapsedSample{
+                    site_, std::string_view{label_, labelSize_}, ClockPolicy::elapsedNs(start_, end)});
+            }
+        }
+
+        BasicScopeTimer(const BasicScopeTimer&) = delete;
+        BasicScopeTimer& operator=(const BasicScopeTimer&) = delete;
+        BasicScopeTimer(BasicScopeTimer&&) = delete;
+        BasicScopeTimer& operator=(BasicScopeTimer&&) = delete;
+
+    private:
+        const ScopeTimer::CallSite* site_{nullptr}; ///< Null while timing is disabled.
+        const char* label_;
+        typename ClockPolicy::tick_type start_{};
+        std::uint32_t labelSize_;
     };
 
+#if defined(SCOPE_TIMER_HAS_COROUTINES)
     namespace detail {
-        class ConditionalScopeTimer {
-        public:
-            template <typename LabelFactory>
-            ConditionalScopeTimer(bool enabled, std::string_view where, LabelFactory&& labelFactory) noexcept {
-                if (enabled) {
-                    timer_.emplace(where, labelFactory());
-                } else {
-                    (void)where;
-                }
+        template <typename Awaitable>
+        decltype(auto) getAwaiter(Awaitable&& awaitable) {
+            if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); }) {
+                return std::forward<Awaitable>(awaitable).operator co_await();
+            } else if constexpr (requires { operator co_await(std::forward<Awaitable>(awaitable)); }) {
+                return operator co_await(std::forward<Awaitable>(awaitable));
+            } else {
+                return std::forward<Awaitable>(awaitable);
             }
+        }
+    } // namespace detail
+
+    /**
+     * @brief Awaiter that suspends an AsyncScopeTimer around the wrapped awaiter.
+     *
+     * suspend() runs before the inner await_suspend() hands the coroutine to
+     * another thread, so the resuming thread never races the bookkeeping.
+     */
+    template <typename Awaiter>
+    class TimedAwaiter {
+    public:
+        TimedAwaiter(AsyncScopeTimer& scope, Awaiter&& awaiter)
+            : scope_(scope), awaiter_(std::forward<Awaiter>(awaiter)) {}
+
+        bool await_ready() {
+            return awaiter_.await_ready();
+        }
+
+        template <typename Promise>
+        decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+            scope_.suspend();
+            return awaiter_.await_suspend(handle);
+        }
+
+        decltype(auto) await_resume() {
+            scope_.resume();
+            return awaiter_.await_resume();
+        }
 
-            ~ConditionalScopeTimer() = default;
-            ConditionalScopeTimer(const ConditionalScopeTimer&) = delete;
-            ConditionalScopeTimer& operator=(const ConditionalScopeTimer&) = delete;
-            ConditionalScopeTimer(ConditionalScopeTimer&&) = delete;
-            ConditionalScopeTimer& operator=(ConditionalScopeTimer&&) = delete;
+    private:
+        AsyncScopeTimer& scope_;
+        Awaiter awaiter_;
+    };
 
-        private:
-            std::optional<ScopeTimer> timer_;
-        };
-    } // namespace detail
+    /**
+     * @brief co_await timedAwait(scope, awaitable) times awaitable as suspended time of scope.
+     */
+    template <typename Awaitable>
+    auto timedAwait(AsyncScopeTimer& scope, Awaitable&& awaitable) {
+        using Result = decltype(detail::getAwaiter(std::forward<Awaitable>(awaitable)));
+        using Awaiter = std::conditional_t<std::is_lvalue_reference_v<Result>, Result, std::remove_cvref_t<Result>>;
+        return TimedAwaiter<Awaiter>(scope, detail::getAwaiter(std::forward<Awaitable>(awaitable)));
+    }
+#endif
 
 
 // -----------------------------------------------------------------------------
@@ -1967,10 +6087,71 @@ namespace xyzzy::scopetimer {
 #endif
 
 
+// Each timer macro expands through an *_IMPL_ helper so one ST_UNIQ value names
+// both the timer and its constant-initialized CallSite descriptor.
+#define SCOPE_TIMER_CALLSITE_(id)                                                    \
+    static ::xyzzy::scopetimer::ScopeTimer::CallSite ST_CAT(scopeTimerSite__, id){   \
+        SCOPE_FUNCTION, __FILE__, static_cast<unsigned>(__LINE__),                   \
+        ::xyzzy::scopetimer::detail::shortFunctionName(SCOPE_FUNCTION)}
+
 #ifndef SCOPE_TIMER
-#define SCOPE_TIMER(...)                                                             \
-    ::xyzzy::scopetimer::ScopeTimer ST_CAT(scopeTimerInstance__, ST_UNIQ)( \
-        SCOPE_FUNCTION, ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_IMPL_(id, ...)                                                   \
+    SCOPE_TIMER_CALLSITE_(id);                                                       \
+    ::xyzzy::scopetimer::ScopeTimer ST_CAT(scopeTimerInstance__, id)(                \
+        ST_CAT(scopeTimerSite__, id), ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER(...) SCOPE_TIMER_IMPL_(ST_UNIQ, __VA_ARGS__)
+#endif
+
+/**
+ * @brief Starts a ScopeTimer whose label is a printf format filled in only when the record is written.
+ *
+ * Arguments are arithmetic values or pointers, copied into the timer's inline
+ * label storage; the compiler checks them against the format as for printf.
+ * With no arguments the format is used as written, like SCOPE_TIMER.
+ *
+ * @code
+ * SCOPE_TIMER_FMT("shard=%u req=%llu", shard, requestId);
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_FMT
+// The format travels inside __VA_ARGS__ so a format with no arguments leaves no trailing comma.
+#define SCOPE_TIMER_FMT_IMPL_(id, ...)                                                       \
+    static_cast<void>(sizeof(std::snprintf(nullptr, 0, __VA_ARGS__)));                      \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::ScopeTimer ST_CAT(scopeTimerInstance__, id)(                        \
+        ST_CAT(scopeTimerSite__, id), ::xyzzy::scopetimer::detail::makeFormattedLabel(__VA_ARGS__))
+#define SCOPE_TIMER_FMT(...) SCOPE_TIMER_FMT_IMPL_(ST_UNIQ, __VA_ARGS__)
+#endif
+
+/**
+ * @brief Starts a CompactScopeTimer for a string-literal label.
+ *
+ * @code
+ * SCOPE_TIMER_COMPACT("parse:token");
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_COMPACT
+#define SCOPE_TIMER_COMPACT_IMPL_(id, label)                                                 \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::CompactScopeTimer ST_CAT(scopeTimerInstance__, id)(                 \
+        ST_CAT(scopeTimerSite__, id), label)
+#define SCOPE_TIMER_COMPACT(label) SCOPE_TIMER_COMPACT_IMPL_(ST_UNIQ, label)
+#endif
+
+/**
+ * @brief Starts a BasicScopeTimer instantiation @p TimerType for a string-literal label.
+ *
+ * @code
+ * using KernelTimer = xyzzy::scopetimer::BasicScopeTimer<
+ *     xyzzy::scopetimer::TscClockPolicy, xyzzy::scopetimer::ThreadRingSinkPolicy<4096>>;
+ * SCOPE_TIMER_WITH(KernelTimer, "fft:butterfly");
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_WITH
+#define SCOPE_TIMER_WITH_IMPL_(id, TimerType, label)                                         \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    TimerType ST_CAT(scopeTimerInstance__, id)(ST_CAT(scopeTimerSite__, id), label)
+#define SCOPE_TIMER_WITH(TimerType, label) SCOPE_TIMER_WITH_IMPL_(ST_UNIQ, TimerType, label)
 #endif
 
 /**
@@ -1992,11 +6173,59 @@ namespace xyzzy::scopetimer {
  * @endcode
  */
 #ifndef SCOPE_TIMER_IF
-#define SCOPE_TIMER_IF(cond, ...)                                                          \
+#define SCOPE_TIMER_IF_IMPL_(id, cond, ...)                                                \
+    SCOPE_TIMER_CALLSITE_(id);                                                             \
+    ::xyzzy::scopetimer::detail::ConditionalScopeTimer                                       \
+        ST_CAT(scopeTimerConditional__, id)((cond), ST_CAT(scopeTimerSite__, id), [&]() noexcept { \
+            return ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__);                  \
+        })
+#define SCOPE_TIMER_IF(cond, ...) SCOPE_TIMER_IF_IMPL_(ST_UNIQ, cond, __VA_ARGS__)
+#endif
+
+/**
+ * @brief Times the current scope when @p sampler (a ScopeTimer::Sampler lvalue) admits the call.
+ *
+ * Rejected calls cost one sampling decision and no clock read. The next
+ * admitted record reports how many calls were skipped as suppressed=.
+ * SCOPE_TIMER_EVERY_N, SCOPE_TIMER_PROBABILITY and SCOPE_TIMER_RATE_LIMITED
+ * keep a function-local static Sampler built from their first argument on
+ * the first call; calls it skipped after the last admitted record are
+ * written by ScopeTimer::flushSuppressedSamples() at exit.
+ *
+ * @code
+ * void onPacket() {
+ *     SCOPE_TIMER_EVERY_N(100, "net:packet");        // 1st, 101st, 201st, ... call
+ *     SCOPE_TIMER_RATE_LIMITED(50, "net:packet:slow"); // at most 50 records per second
+ * }
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_SAMPLED
+#define SCOPE_TIMER_SAMPLED_IMPL_(id, sampler, ...)                                          \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::detail::ConditionalScopeTimer                                       \
+        ST_CAT(scopeTimerSampled__, id)((sampler), ST_CAT(scopeTimerSite__, id), [&]() noexcept { \
+            return ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__);                  \
+        })
+#define SCOPE_TIMER_SAMPLED(sampler, ...) SCOPE_TIMER_SAMPLED_IMPL_(ST_UNIQ, sampler, __VA_ARGS__)
+#endif
+
+#ifndef SCOPE_TIMER_EVERY_N
+#define SCOPE_TIMER_STATIC_SAMPLER_IMPL_(id, factory, ...)                                   \
+    static ::xyzzy::scopetimer::ScopeTimer::Sampler ST_CAT(scopeTimerSampler__, id) =        \
+        ::xyzzy::scopetimer::ScopeTimer::Sampler::factory;                                   \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
     ::xyzzy::scopetimer::detail::ConditionalScopeTimer                                       \
-        ST_CAT(scopeTimerConditional__, ST_UNIQ)((cond), SCOPE_FUNCTION, [&]() noexcept {  \
+        ST_CAT(scopeTimerSampled__, id)(::xyzzy::scopetimer::detail::StaticSamplerTag{},     \
+                                        ST_CAT(scopeTimerSampler__, id),                     \
+                                        ST_CAT(scopeTimerSite__, id), [&]() noexcept {       \
             return ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__);                  \
         })
+#define SCOPE_TIMER_EVERY_N(n, ...) \
+    SCOPE_TIMER_STATIC_SAMPLER_IMPL_(ST_UNIQ, oneIn(n), __VA_ARGS__)
+#define SCOPE_TIMER_PROBABILITY(p, ...) \
+    SCOPE_TIMER_STATIC_SAMPLER_IMPL_(ST_UNIQ, withProbability(p), __VA_ARGS__)
+#define SCOPE_TIMER_RATE_LIMITED(rate, ...) \
+    SCOPE_TIMER_STATIC_SAMPLER_IMPL_(ST_UNIQ, perSecond(rate), __VA_ARGS__)
 #endif
 
 #ifndef SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK
@@ -2009,21 +6238,181 @@ namespace xyzzy::scopetimer {
     do { ::xyzzy::scopetimer::ScopeTimer::disableThreadBufferedSink(); } while(0)
 #endif
 
+#ifndef SCOPE_TIMER_ENABLE_PER_THREAD_FILE_SINK
+#define SCOPE_TIMER_ENABLE_PER_THREAD_FILE_SINK(...) \
+    do { ::xyzzy::scopetimer::ScopeTimer::enablePerThreadFileSink(__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_DISABLE_PER_THREAD_FILE_SINK
+#define SCOPE_TIMER_DISABLE_PER_THREAD_FILE_SINK() \
+    do { ::xyzzy::scopetimer::ScopeTimer::disableThreadBufferedSink(); } while(0)
+#endif
+
 #ifndef SCOPE_TIMER_ENABLE_ASYNC_SINK
 #define SCOPE_TIMER_ENABLE_ASYNC_SINK(...) \
     do { ::xyzzy::scopetimer::ScopeTimer::enableAsyncSink(__VA_ARGS__); } while(0)
 #endif
 
+#ifndef SCOPE_TIMER_INSTALL_CRASH_FLUSH
+#define SCOPE_TIMER_INSTALL_CRASH_FLUSH() \
+    do { (void)::xyzzy::scopetimer::ScopeTimer::installCrashFlushHandler(); } while(0)
+#endif
+
 #ifndef SCOPE_TIMER_DISABLE_ASYNC_SINK
 #define SCOPE_TIMER_DISABLE_ASYNC_SINK() \
     do { ::xyzzy::scopetimer::ScopeTimer::disableAsyncSink(); } while(0)
 #endif
 
+/**
+ * @brief Times the current scope and reports it while still open past @p deadline.
+ *
+ * The report comes from the watchdog thread (see ScopeTimer::startWatchdog);
+ * the normal record is still written when the scope ends.
+ *
+ * @code
+ * SCOPE_TIMER_DEADLINE(std::chrono::milliseconds(50), "db:commit");
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_DEADLINE
+#define SCOPE_TIMER_DEADLINE_IMPL_(id, deadline, ...)                                        \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::ScopeTimer ST_CAT(scopeTimerDeadlineInstance__, id)(                \
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline), ST_CAT(scopeTimerSite__, id), \
+        ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_DEADLINE(deadline, ...) SCOPE_TIMER_DEADLINE_IMPL_(ST_UNIQ, deadline, __VA_ARGS__)
+#endif
+
+/**
+ * @brief Times the current scope and records the thread's page faults and
+ * context switches across it (getrusage(RUSAGE_THREAD), Linux only).
+ *
+ * Costs two extra system calls, so use it on coarse scopes where faults or
+ * preemption may explain an outlier; plain SCOPE_TIMER callsites are unaffected.
+ *
+ * @code
+ * SCOPE_TIMER_RUSAGE("load:index");
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_RUSAGE
+#define SCOPE_TIMER_RUSAGE_IMPL_(id, ...)                                                    \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::ScopeTimer ST_CAT(scopeTimerRusageInstance__, id)(                  \
+        ::xyzzy::scopetimer::ScopeTimer::ResourceUsageTag{}, ST_CAT(scopeTimerSite__, id),   \
+        ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_RUSAGE(...) SCOPE_TIMER_RUSAGE_IMPL_(ST_UNIQ, __VA_ARGS__)
+#endif
+
+/**
+ * @brief Times the current scope and collects SCOPE_TIMER_LAP checkpoints into its record.
+ *
+ * @code
+ * void handle(const Request& req) {
+ *     SCOPE_TIMER_LAPS("handle");
+ *     parse(req);
+ *     SCOPE_TIMER_LAP("parse");
+ *     decode(req);
+ *     SCOPE_TIMER_LAP("decode");
+ * }
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_LAPS
+#define SCOPE_TIMER_LAPS_IMPL_(id, ...)                                                      \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::LapScopeTimer ST_CAT(scopeTimerLapInstance__, id)(                  \
+        ST_CAT(scopeTimerSite__, id), ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_LAPS(...) SCOPE_TIMER_LAPS_IMPL_(ST_UNIQ, __VA_ARGS__)
+#endif
+
+#ifndef SCOPE_TIMER_LAP
+#define SCOPE_TIMER_LAP(name) ::xyzzy::scopetimer::LapScopeTimer::lapCurrent(name)
+#endif
+
+/**
+ * @brief Declares a LoopScopeTimer named @p name that times every @p sampleEvery-th iteration (0: count only).
+ *
+ * @code
+ * SCOPE_TIMER_LOOP(loop, 64, "ingest:batch");
+ * for (const auto& record : batch) {
+ *     SCOPE_TIMER_ITERATION(loop);
+ *     ingest(record);
+ * }
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_LOOP
+#define SCOPE_TIMER_LOOP_IMPL_(id, name, sampleEvery, ...)                                   \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::LoopScopeTimer name(                                                \
+        ST_CAT(scopeTimerSite__, id), static_cast<std::uint32_t>(sampleEvery),               \
+        ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_LOOP(name, sampleEvery, ...) SCOPE_TIMER_LOOP_IMPL_(ST_UNIQ, name, sampleEvery, __VA_ARGS__)
+#endif
+
+#ifndef SCOPE_TIMER_ITERATION
+#define SCOPE_TIMER_ITERATION_IMPL_(id, name) \
+    ::xyzzy::scopetimer::LoopScopeTimer::Iteration ST_CAT(scopeTimerIteration__, id)(name)
+#define SCOPE_TIMER_ITERATION(name) SCOPE_TIMER_ITERATION_IMPL_(ST_UNIQ, name)
+#endif
+
+/**
+ * @brief Starts a ScopeSpan named @p name; move it wherever the work finishes.
+ *
+ * @code
+ * SCOPE_TIMER_SPAN(span, "rpc:handle");
+ * span.setCorrelationId(request.id);
+ * pool.post([span = std::move(span)]() mutable { process(); span.finish(); });
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_SPAN
+#define SCOPE_TIMER_SPAN_IMPL_(id, name, ...)                                                \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::ScopeSpan name(                                                     \
+        ST_CAT(scopeTimerSite__, id), ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_SPAN(name, ...) SCOPE_TIMER_SPAN_IMPL_(ST_UNIQ, name, __VA_ARGS__)
+#endif
+
+/**
+ * @brief Declares an AsyncScopeTimer named @p name for a scope that suspends.
+ *
+ * In a C++20 coroutine, await through SCOPE_TIMER_AWAIT so suspended time and
+ * thread migrations are attributed:
+ *
+ * @code
+ * Task<Row> fetch(Db& db) {
+ *     SCOPE_TIMER_ASYNC(timer, "db:fetch");
+ *     auto row = co_await SCOPE_TIMER_AWAIT(timer, db.query());
+ *     co_return row;
+ * }
+ * @endcode
+ */
+#ifndef SCOPE_TIMER_ASYNC
+#define SCOPE_TIMER_ASYNC_IMPL_(id, name, ...)                                               \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::AsyncScopeTimer name(                                               \
+        ST_CAT(scopeTimerSite__, id), ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_ASYNC(name, ...) SCOPE_TIMER_ASYNC_IMPL_(ST_UNIQ, name, __VA_ARGS__)
+#endif
+
+#if defined(SCOPE_TIMER_HAS_COROUTINES) && !defined(SCOPE_TIMER_AWAIT)
+#define SCOPE_TIMER_AWAIT(name, ...) ::xyzzy::scopetimer::timedAwait(name, __VA_ARGS__)
+#endif
+
+#ifndef SCOPE_TIMER_START_WATCHDOG
+#define SCOPE_TIMER_START_WATCHDOG(...) \
+    do { ::xyzzy::scopetimer::ScopeTimer::startWatchdog(__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_STOP_WATCHDOG
+#define SCOPE_TIMER_STOP_WATCHDOG() \
+    do { ::xyzzy::scopetimer::ScopeTimer::stopWatchdog(); } while(0)
+#endif
+
 #ifndef SCOPE_TIMER_HOT_PATH
-#define SCOPE_TIMER_HOT_PATH(...)                                                            \
-    ::xyzzy::scopetimer::ScopeTimer ST_CAT(scopeTimerHotPathInstance__, ST_UNIQ)(            \
-        ::xyzzy::scopetimer::ScopeTimer::HotPathTag{},                                       \
+#define SCOPE_TIMER_HOT_PATH_IMPL_(id, ...)                                                  \
+    SCOPE_TIMER_CALLSITE_(id);                                                               \
+    ::xyzzy::scopetimer::ScopeTimer ST_CAT(scopeTimerHotPathInstance__, id)(                 \
+        ::xyzzy::scopetimer::ScopeTimer::HotPathTag{}, ST_CAT(scopeTimerSite__, id),         \
         ::xyzzy::scopetimer::detail::makeLabelData(__VA_ARGS__))
+#define SCOPE_TIMER_HOT_PATH(...) SCOPE_TIMER_HOT_PATH_IMPL_(ST_UNIQ, __VA_ARGS__)
 #endif
 
 #else // Release build -> no-op
@@ -2036,13 +6425,216 @@ namespace xyzzy::scopetimer {
      */
     class ScopeTimer {
     public:
+        struct SinkSlice {
+            const char* data{nullptr};
+            std::size_t size{0U};
+        };
+
         class LogSink {
         public:
             virtual ~LogSink() = default;
             virtual void write(const char*, std::size_t) noexcept = 0;
+            virtual void writeBatch(const SinkSlice*, std::size_t) noexcept {}
+            virtual void flush() noexcept {}
+        };
+
+        struct SinkSpan {
+            char* data{nullptr};
+            std::size_t size{0U};
+        };
+
+        class ReservingLogSink : public LogSink {
+        public:
+            virtual SinkSpan reserve(std::size_t maxLen) noexcept = 0;
+            virtual void commit(std::size_t len) noexcept = 0;
+            void write(const char*, std::size_t) noexcept override {}
+            void writeBatch(const SinkSlice*, std::size_t) noexcept override {}
+            std::uint64_t dropped() const noexcept { return 0U; }
+        };
+
+        struct CallSite {
+            std::string_view where;
+            const char* file{nullptr};
+            unsigned line{0U};
+            std::string_view shortWhere{};
+        };
+
+        class Sampler {
+        public:
+            static Sampler oneIn(std::uint32_t) noexcept { return Sampler{}; }
+            static Sampler withProbability(double) noexcept { return Sampler{}; }
+            static Sampler perSecond(double, std::uint32_t = 1U) noexcept { return Sampler{}; }
+            bool admit() noexcept { return false; }
+            std::uint64_t suppressed() const noexcept { return 0U; }
+            std::uint64_t takeSuppressed() noexcept { return 0U; }
+            bool admitEnlisting(const CallSite&) noexcept { return false; }
+        };
+
+        struct PerfCounts {
+            std::uint64_t instructions{0U};
+            std::uint64_t cycles{0U};
+            std::uint64_t cacheMisses{0U};
+            std::uint64_t branchMisses{0U};
+            std::uint64_t contextSwitches{0U};
+            std::uint64_t pageFaults{0U};
+            std::uint64_t timeEnabledNs{0U};
+            std::uint64_t timeRunningNs{0U};
+            bool hardware{false};
+
+            PerfCounts& operator+=(const PerfCounts&) noexcept { return *this; }
+        };
+
+        struct ResourceUsage {
+            std::int64_t minorFaults{0};
+            std::int64_t majorFaults{0};
+            std::int64_t voluntarySwitches{0};
+            std::int64_t involuntarySwitches{0};
+
+            ResourceUsage& operator+=(const ResourceUsage&) noexcept { return *this; }
+        };
+
+        struct AllocationCounts {
+            std::uint64_t count{0U};
+            std::uint64_t bytes{0U};
+
+            AllocationCounts& operator+=(const AllocationCounts&) noexcept { return *this; }
+        };
+
+        struct LapSplit {
+            std::string_view name;
+            std::int64_t ns{0};
+        };
+
+        struct LapSplits {
+            static constexpr std::size_t Capacity = 8U;
+            std::array<LapSplit, Capacity> splits{};
+            std::uint32_t count{0U};
+            std::uint32_t dropped{0U};
+        };
+
+        struct LoopStats {
+            std::uint64_t iterations{0U};
+            std::uint64_t sampled{0U};
+            std::int64_t meanNs{0};
+            std::int64_t minNs{0};
+            std::int64_t p50Ns{0};
+            std::int64_t p90Ns{0};
+            std::int64_t p99Ns{0};
+            std::int64_t maxNs{0};
+        };
+
+        struct ElapsedSample {
+            const CallSite* site{nullptr};
+            std::string_view label;
+            std::int64_t elapsedNs{0};
+        };
+
+        struct Record {
+            const CallSite* site{nullptr};
+            std::string_view where;
+            std::string_view label;
+            std::uint32_t threadNum{0U};
+            std::int64_t startSteadyNs{0};
+            std::int64_t endSteadyNs{0};
+            std::int64_t startWallNs{0};
+            std::int64_t endWallNs{0};
+            std::int64_t cpuNs{0};
+            PerfCounts perf{};
+            ResourceUsage rusage{};
+            AllocationCounts allocations{};
+            std::int64_t suspendedNs{0};
+            std::uint32_t migrations{0U};
+            std::uint64_t correlationId{0U};
+            std::uint64_t suppressed{0U};
+            const LapSplits* laps{nullptr};
+            const LoopStats* loop{nullptr};
+            bool hasWallTime{false};
+            bool hasCpuTime{false};
+            bool hasPerfCounts{false};
+            bool hasResourceUsage{false};
+            bool hasAllocations{false};
+            bool hasSuspendedTime{false};
+            bool hotPath{false};
+            bool stillRunning{false};
+        };
+
+        class RecordSink {
+        public:
+            virtual ~RecordSink() = default;
+            virtual void record(const Record&) noexcept = 0;
             virtual void flush() noexcept {}
         };
 
+        enum class RecordSinkMode {
+            Exclusive,
+            AlongsideText,
+        };
+
+        static constexpr std::size_t MaxSinkRoutes = 32U;
+
+        struct SinkRoute {
+            enum class Target {
+                DefaultFile,
+                Log,
+                Record,
+            };
+
+            static SinkRoute toDefaultFile() noexcept { return SinkRoute{}; }
+            static SinkRoute toLogSink(LogSink&) noexcept { return SinkRoute{}; }
+            static SinkRoute toRecordSink(RecordSink&) noexcept { return SinkRoute{}; }
+            SinkRoute withMinElapsed(std::chrono::nanoseconds) const noexcept { return *this; }
+            SinkRoute withSampleEvery(std::uint32_t) const noexcept { return *this; }
+            template <typename Filter>
+            SinkRoute withCallSiteFilter(Filter&&) const noexcept { return *this; }
+        };
+
+        class StatsRecordSink final : public RecordSink {
+        public:
+            struct Entry {
+                const CallSite* site{nullptr};
+                std::string where;
+                std::string label;
+                std::uint64_t count{0U};
+                std::int64_t totalNs{0};
+                std::int64_t minNs{0};
+                std::int64_t maxNs{0};
+                std::uint64_t cpuCount{0U};
+                std::int64_t cpuTotalNs{0};
+                std::int64_t cpuElapsedTotalNs{0};
+                std::uint64_t perfCount{0U};
+                PerfCounts perfTotal{};
+                std::uint64_t rusageCount{0U};
+                ResourceUsage rusageTotal{};
+                std::uint64_t allocRecordCount{0U};
+                AllocationCounts allocTotal{};
+                std::uint64_t suspendableCount{0U};
+                std::int64_t suspendedTotalNs{0};
+                std::uint64_t suppressedTotal{0U};
+            };
+
+            void record(const Record&) noexcept override {}
+            std::vector<Entry> snapshot() const { return {}; }
+            void clear() noexcept {}
+        };
+
+        class FlightRecorderSink final : public RecordSink {
+        public:
+            enum class Layout {
+                PerThread,
+                Shared,
+            };
+
+            explicit FlightRecorderSink(std::size_t = 1024U, Layout = Layout::PerThread,
+                                        std::chrono::nanoseconds = std::chrono::seconds(10)) noexcept {}
+            void setTriggerLatency(std::chrono::nanoseconds) noexcept {}
+            static constexpr std::chrono::milliseconds SignalPollInterval{50};
+
+            bool dumpOnSignal(int) noexcept { return false; }
+            void record(const Record&) noexcept override {}
+            std::size_t dump() noexcept { return 0U; }
+            std::size_t dump(LogSink&) noexcept { return 0U; }
+        };
+
         /**
          * @brief Constructs a no-op ScopeTimer.
          *
@@ -2052,19 +6644,138 @@ namespace xyzzy::scopetimer {
         inline explicit ScopeTimer(std::string_view, std::string_view = "ScopeTimer") noexcept {}
         static inline void setLogSink(LogSink&) noexcept {}
         static inline void resetLogSink() noexcept {}
+        static inline void setRecordSink(RecordSink&, RecordSinkMode = RecordSinkMode::Exclusive) noexcept {}
+        static inline void resetRecordSink() noexcept {}
+        static inline void setSinkPipeline(const std::vector<SinkRoute>&) noexcept {}
+        static inline void resetSinkPipeline() noexcept {}
+        static inline bool installCrashFlushHandler() noexcept { return false; }
+        static inline void uninstallCrashFlushHandler() noexcept {}
+        static inline void startWatchdog(std::chrono::nanoseconds = std::chrono::milliseconds(10)) noexcept {}
+        static inline void stopWatchdog() noexcept {}
+        template <typename Callback>
+        static inline void setWatchdogCallback(Callback&&) noexcept {}
+        static inline void flushSuppressedSamples() noexcept {}
+        static inline void noteAllocation(std::size_t) noexcept {}
+        static inline void markAllocationHooksLinked() noexcept {}
+        static inline bool allocationTrackingEnabled() noexcept { return false; }
+    };
+
+    class AsyncScopeTimer {
+    public:
+        template <typename... Args>
+        explicit AsyncScopeTimer(Args&&...) noexcept {}
+        void suspend() noexcept {}
+        void resume() noexcept {}
+        bool suspended() const noexcept { return false; }
+    };
+
+    class ScopeSpan {
+    public:
+        ScopeSpan() noexcept = default;
+        template <typename... Args>
+        explicit ScopeSpan(Args&&...) noexcept {}
+        ScopeSpan(ScopeSpan&&) noexcept = default;
+        ScopeSpan& operator=(ScopeSpan&&) noexcept = default;
+        void finish() noexcept {}
+        void cancel() noexcept {}
+        void setCorrelationId(std::uint64_t) noexcept {}
+        bool active() const noexcept { return false; }
+    };
+
+    class LapScopeTimer {
+    public:
+        template <typename... Args>
+        explicit LapScopeTimer(Args&&...) noexcept {}
+        void lap(const char*) noexcept {}
+        static void lapCurrent(const char*) noexcept {}
+    };
+
+    class LoopScopeTimer {
+    public:
+        static constexpr std::size_t SampleCapacity = 256U;
+
+        class Iteration {
+        public:
+            explicit Iteration(LoopScopeTimer&) noexcept {}
+        };
+
+        template <typename... Args>
+        explicit LoopScopeTimer(Args&&...) noexcept {}
+    };
+
+    class CompactScopeTimer {
+    public:
+        template <typename... Args>
+        explicit CompactScopeTimer(Args&&...) noexcept {}
+    };
+
+    struct SteadyClockPolicy {};
+#if defined(SCOPE_TIMER_HAS_TSC_CLOCK)
+    struct TscClockPolicy {};
+#endif
+    struct ScopeTimerSinkPolicy {};
+
+    template <std::size_t Capacity>
+    struct ThreadRingSinkPolicy {
+        template <typename Fn>
+        static std::size_t drain(Fn&&) noexcept { return 0U; }
+    };
+
+    template <typename ClockPolicy, typename SinkPolicy>
+    class BasicScopeTimer {
+    public:
+        template <typename... Args>
+        explicit BasicScopeTimer(Args&&...) noexcept {}
     };
 
+#if defined(SCOPE_TIMER_HAS_COROUTINES)
+    template <typename Awaitable>
+    decltype(auto) timedAwait(AsyncScopeTimer&, Awaitable&& awaitable) noexcept {
+        return std::forward<Awaitable>(awaitable);
+    }
+#endif
+
  #ifndef SCOPE_TIMER
 #define SCOPE_TIMER(...) \
     do { (void)sizeof(#__VA_ARGS__); } while(0)
 #endif
 
+#ifndef SCOPE_TIMER_FMT
+// Unevaluated: keeps the format check and marks the arguments used
+#define SCOPE_TIMER_FMT(...) \
+    do { (void)sizeof(std::snprintf(nullptr, 0, __VA_ARGS__)); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_COMPACT
+#define SCOPE_TIMER_COMPACT(label) \
+    do { (void)sizeof(label); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_WITH
+#define SCOPE_TIMER_WITH(TimerType, label) \
+    do { (void)sizeof(TimerType); (void)sizeof(label); } while(0)
+#endif
+
 #ifndef SCOPE_TIMER_IF
 // Do not evaluate 'cond' or variadic args (avoid side effects); silences unused warnings
 #define SCOPE_TIMER_IF(cond, ...) \
     do { (void)sizeof(cond); (void)sizeof(#__VA_ARGS__); } while(0)
 #endif
 
+#ifndef SCOPE_TIMER_SAMPLED
+#define SCOPE_TIMER_SAMPLED(sampler, ...) \
+    do { (void)sizeof(sampler); (void)sizeof(#__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_EVERY_N
+#define SCOPE_TIMER_EVERY_N(n, ...) \
+    do { (void)sizeof(n); (void)sizeof(#__VA_ARGS__); } while(0)
+#define SCOPE_TIMER_PROBABILITY(p, ...) \
+    do { (void)sizeof(p); (void)sizeof(#__VA_ARGS__); } while(0)
+#define SCOPE_TIMER_RATE_LIMITED(rate, ...) \
+    do { (void)sizeof(rate); (void)sizeof(#__VA_ARGS__); } while(0)
+#endif
+
 #ifndef SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK
 #define SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(...) \
     do { (void)sizeof(#__VA_ARGS__); } while(0)
@@ -2075,11 +6786,26 @@ namespace xyzzy::scopetimer {
     do { } while(0)
 #endif
 
+#ifndef SCOPE_TIMER_ENABLE_PER_THREAD_FILE_SINK
+#define SCOPE_TIMER_ENABLE_PER_THREAD_FILE_SINK(...) \
+    do { (void)sizeof(#__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_DISABLE_PER_THREAD_FILE_SINK
+#define SCOPE_TIMER_DISABLE_PER_THREAD_FILE_SINK() \
+    do { } while(0)
+#endif
+
 #ifndef SCOPE_TIMER_ENABLE_ASYNC_SINK
 #define SCOPE_TIMER_ENABLE_ASYNC_SINK(...) \
     do { (void)sizeof(#__VA_ARGS__); } while(0)
 #endif
 
+#ifndef SCOPE_TIMER_INSTALL_CRASH_FLUSH
+#define SCOPE_TIMER_INSTALL_CRASH_FLUSH() \
+    do { } while(0)
+#endif
+
 #ifndef SCOPE_TIMER_DISABLE_ASYNC_SINK
 #define SCOPE_TIMER_DISABLE_ASYNC_SINK() \
     do { } while(0)
@@ -2090,6 +6816,60 @@ namespace xyzzy::scopetimer {
     do { (void)sizeof(#__VA_ARGS__); } while(0)
 #endif
 
+#ifndef SCOPE_TIMER_DEADLINE
+#define SCOPE_TIMER_DEADLINE(deadline, ...) \
+    do { (void)sizeof(deadline); (void)sizeof(#__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_RUSAGE
+#define SCOPE_TIMER_RUSAGE(...) \
+    do { (void)sizeof(#__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_LAPS
+#define SCOPE_TIMER_LAPS(...) \
+    do { (void)sizeof(#__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_LAP
+#define SCOPE_TIMER_LAP(name) \
+    do { (void)sizeof(name); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_LOOP
+#define SCOPE_TIMER_LOOP(name, sampleEvery, ...) \
+    [[maybe_unused]] ::xyzzy::scopetimer::LoopScopeTimer name
+#endif
+
+#ifndef SCOPE_TIMER_ITERATION
+#define SCOPE_TIMER_ITERATION(name) \
+    do { (void)(name); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_SPAN
+#define SCOPE_TIMER_SPAN(name, ...) \
+    [[maybe_unused]] ::xyzzy::scopetimer::ScopeSpan name
+#endif
+
+#ifndef SCOPE_TIMER_ASYNC
+#define SCOPE_TIMER_ASYNC(name, ...) \
+    [[maybe_unused]] ::xyzzy::scopetimer::AsyncScopeTimer name
+#endif
+
+#ifndef SCOPE_TIMER_AWAIT
+#define SCOPE_TIMER_AWAIT(name, ...) ((void)(name), (__VA_ARGS__))
+#endif
+
+#ifndef SCOPE_TIMER_START_WATCHDOG
+#define SCOPE_TIMER_START_WATCHDOG(...) \
+    do { (void)sizeof(#__VA_ARGS__); } while(0)
+#endif
+
+#ifndef SCOPE_TIMER_STOP_WATCHDOG
+#define SCOPE_TIMER_STOP_WATCHDOG() \
+    do { } while(0)
+#endif
+
 #endif // NDEBUG
 
 } // namespace xyzzy::scopetimer
@@ -2146,17 +6926,18 @@ inline void xyzzy::scopetimer::ScopeTimer::threadBufferedSinkWrite(const char* d
 
     if (len >= flushBytes) {
         flushThreadBuffer(buffer);
-        publishBufferedSinkPayload(data, len);
+        publishBufferedSinkPayload(data, len, BufferedSinkFlushMode::Deferred, &buffer);
         return;
     }
 
-    if (buffer.size + len > flushBytes) {
+    if (buffer.size.load(std::memory_order_relaxed) + len > flushBytes) {
         flushThreadBuffer(buffer);
     }
 
-    std::memcpy(buffer.data.data() + buffer.size, data, len);
-    buffer.size += len;
-    if (buffer.size >= flushBytes) {
+    const std::size_t used = buffer.size.load(std::memory_order_relaxed) + len;
+    std::memcpy(buffer.data.data() + used - len, data, len);
+    buffer.size.store(used, std::memory_order_release);
+    if (used >= flushBytes) {
         flushThreadBuffer(buffer);
     }
 }
@@ -2178,6 +6959,7 @@ inline void xyzzy::scopetimer::ScopeTimer::asyncSinkWrite(const char* data, std:
     {
         std::lock_guard lock(state.mutex);
         notifyWorker = state.queue.empty();
+        publishCrashAsyncBatch(batch);
         state.queue.emplace_back(std::move(batch));
     }
     if (notifyWorker) {
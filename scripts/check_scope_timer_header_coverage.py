@@ -92,6 +92,7 @@ def main() -> int:
     repo_root = Path(args.repo_root).resolve()
     build_dir = Path(args.build_dir).resolve()
     source = repo_root / "test" / "ScopeTimerTest.cpp"
+    alloc_hooks = repo_root / "src" / "ScopeTimerAllocHooks.cpp"
     header = repo_root / "include" / "ScopeTimer.hpp"
     include_dir = repo_root / "include"
 
@@ -141,6 +142,7 @@ def main() -> int:
         str(include_dir),
         f'-DSCOPETIMER_SOURCE_DIR="{repo_root}"',
         str(source),
+        str(alloc_hooks),
         "-o",
         str(binary),
     ]
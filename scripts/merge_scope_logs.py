@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Merge per-thread ScopeTimer logs into one stream ordered by end timestamp.
+
+Per-thread file mode writes one `ScopeTimer.<pid>.<tid>.log` per thread. Each
+file is already in emission order, so the files are k-way merged on the
+`end=` timestamp of every record. Lines without an `end=` field (hot-path
+records, SCOPE_TIMER_WALLTIME=0) keep the position of the last timestamped
+line in their own file.
+
+Timestamps compare as text, which orders every SCOPE_TIMER_TIMESTAMP mode
+correctly as long as all merged files were written with the same mode.
+Compact lines (SCOPE_TIMER_LINE_FORMAT=COMPACT) are keyed on start + elapsed.
+
+Usage:
+  merge_scope_logs.py [-o OUTPUT] PATH [PATH ...]
+
+A PATH may be a log file or a directory; directories contribute every
+`ScopeTimer.<pid>.<tid>.log` they contain.
+"""
+
+from __future__ import annotations
+
+import argparse
+import heapq
+import re
+import sys
+from pathlib import Path
+from typing import Iterator, TextIO
+
+PER_THREAD_LOG = re.compile(r"^ScopeTimer\.\d+\.\d+\.log$")
+END_FIELD = re.compile(r"\| end=([^|]+?)\s*\|")
+COMPACT_TIMES = re.compile(r"^[^\t]*\t[0-9]+\t[^\t]*\t([0-9]+)\t([0-9]+)")
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("paths", nargs="+", help="per-thread log files or directories containing them")
+    parser.add_argument("-o", "--output", help="write the merged stream here instead of stdout")
+    return parser.parse_args()
+
+
+def collect_logs(paths: list[str]) -> list[Path]:
+    logs: list[Path] = []
+    for raw in paths:
+        path = Path(raw)
+        if path.is_dir():
+            logs.extend(sorted(p for p in path.iterdir() if PER_THREAD_LOG.match(p.name)))
+        else:
+            logs.append(path)
+    return logs
+
+
+def keyed_lines(index: int, path: Path) -> Iterator[tuple[str, int, int, str]]:
+    last_key = ""
+    with path.open("r", encoding="utf-8", errors="replace") as handle:
+        for seq, line in enumerate(handle):
+            if not line.endswith("\n"):
+                line += "\n"
+            match = END_FIELD.search(line)
+            if match:
+                last_key = match.group(1)
+            elif compact := COMPACT_TIMES.match(line):
+                last_key = f"{int(compact.group(1)) + int(compact.group(2)):020d}"
+            yield (last_key, index, seq, line)
+
+
+def merge(logs: list[Path], out: TextIO) -> int:
+    streams = [keyed_lines(index, path) for index, path in enumerate(logs)]
+    count = 0
+    for _key, _index, _seq, line in heapq.merge(*streams):
+        out.write(line)
+        count += 1
+    return count
+
+
+def main() -> int:
+    args = parse_args()
+    logs = collect_logs(args.paths)
+    if not logs:
+        print("merge_scope_logs.py: no per-thread logs found", file=sys.stderr)
+        return 1
+
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as out:
+            merge(logs, out)
+    else:
+        merge(logs, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -23,8 +23,11 @@
 # -----------------------------------------------------------------------------
 #
 # Strip "| start=... | end=..." timestamp segments from ScopeTimer lines.
-# Matches timestamps in the format: YYYY-MM-DD HH:MM:SS[.fractions] where the fractional
-# seconds are optional and may contain 1-9 digits.
+# Matches every SCOPE_TIMER_TIMESTAMP mode: local YYYY-MM-DD HH:MM:SS[.fractions],
+# UTC YYYY-MM-DDTHH:MM:SS[.fractions]Z, and integer epoch nanoseconds. The
+# fractional seconds are optional and may contain 1-9 digits.
+# Compact lines (SCOPE_TIMER_LINE_FORMAT=COMPACT) keep their five tab-separated
+# columns with the TID and start columns emptied.
 #
 # Usage:
 #   ./process_scope_times.sh [ScopeTimer.log] > ScopeTimer.log.cleaned
@@ -38,16 +41,22 @@ set -euo pipefail
 
 # Regex pieces:
 #   - Date:      [0-9]{4}-[0-9]{2}-[0-9]{2}
+#   - Separator: [ T]              # space for local time, T for UTC
 #   - Time:      [0-9]{2}:[0-9]{2}:[0-9]{2}
 #   - Fraction:  (\.[0-9]{1,9})?   # optional, 1 to 9 digits (e.g., .7, .73, .735, .735123456)
+#   - Zone:      Z?                # UTC suffix
+#   - Epoch:     [0-9]+            # alternative: nanoseconds since the Unix epoch
 #
 # Full match we remove:
-#   | start=YYYY-MM-DD HH:MM:SS[.fraction] | end=YYYY-MM-DD HH:MM:SS[.fraction]
+#   | start=<timestamp> | end=<timestamp>
 #
 # We use extended regex (-E). The pipes are escaped to match literal '|'.
 
 input="${1:-/dev/stdin}"
 
-script='s# TID=[0-9]+ \| ##g; s# \| start=[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}(\.[0-9]{1,9})? \| end=[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}(\.[0-9]{1,9})? ##g'
+ts='([0-9]{4}-[0-9]{2}-[0-9]{2}[ T][0-9]{2}:[0-9]{2}:[0-9]{2}(\.[0-9]{1,9})?Z?|[0-9]+)'
+tab=$'\t'
+script="s# TID=[0-9]+ \\| ##g; s# \\| start=${ts} \\| end=${ts} ##g"
+script+="; s#^([^${tab}]*)${tab}[0-9]+${tab}([^${tab}]*)${tab}([0-9]+|-)${tab}#\\1${tab}${tab}\\2${tab}${tab}#"
 
 sed -E "$script" "$input"
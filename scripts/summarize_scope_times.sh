@@ -22,11 +22,20 @@
 # code of your version.
 # -----------------------------------------------------------------------------
 #
-# Group by the prefix (everything before "| elapsed=") and show:
+# Group by the prefix (everything before "| elapsed=", or label and callsite
+# for SCOPE_TIMER_LINE_FORMAT=COMPACT lines) and show:
 #   1) Per-key two-line block:
 #        <key>
 #        <v1> <v2> <v3> ...   (all elapsed values in order seen)
 #   2) Per-key summary: count, min, avg, max, trend (↑ = increasing, ↓ = decreasing, - = stable)
+#      plus average cpu/offcpu when the lines carry them (SCOPE_TIMER_CPU_TIME=1),
+#      average active/suspended time for async scopes (SCOPE_TIMER_ASYNC),
+#      average split per lap name (SCOPE_TIMER_LAPS / SCOPE_TIMER_LAP),
+#      loop iteration counts and per-iteration times (SCOPE_TIMER_LOOP)
+#      and calls skipped by the sampling macros (suppressed=)
+#      and IPC / average counter deltas when they carry perf counters
+#      (SCOPE_TIMER_PERF_COUNTERS=1), resource usage (SCOPE_TIMER_RUSAGE) or
+#      allocation counts (src/ScopeTimerAllocHooks.cpp linked in)
 #
 # Usage:
 #   ./summarize_scope_times.sh [ScopeTimer.log.cleaned]
@@ -52,6 +61,27 @@ function fmt_us(us,   x) {
   if (x >= 1000)    return sprintf("%.3fms", x/1000.0)
   return sprintf("%.0fus", x)
 }
+function parse_us(text,   unit, num) {
+  # First token only: later fields such as "| cpu=..." follow the value.
+  sub(/[[:space:]|].*$/, "", text)
+  unit = ""
+  if (text ~ /ns$/)      unit = "ns"
+  else if (text ~ /us$/) unit = "us"
+  else if (text ~ /ms$/) unit = "ms"
+  else if (text ~ /s$/)  unit = "s"
+  if (unit == "") return -1
+  num = text
+  sub(/(ns|us|ms|s)$/, "", num)   # strip unit
+  if (num !~ /^[0-9]+(\.[0-9]+)?$/) return -1
+  return to_us(num, unit)
+}
+function field_num(text, name,   v) {
+  # Integer value of "| name=<n>", or -1 when the field is absent.
+  if (!match(text, "\\|[[:space:]]*" name "=[0-9]+")) return -1
+  v = substr(text, RSTART, RLENGTH)
+  sub(/^.*=/, "", v)
+  return v + 0
+}
 function print_block(k, s, e,   i, col) {
   col = 0
   for (i = s; i <= e; i++) {
@@ -71,38 +101,108 @@ function print_block(k, s, e,   i, col) {
 
 # Collect
 {
-  # Find split point at: optional spaces, literal pipe, optional spaces, then "elapsed="
-  if (match($0, /[[:space:]]*\|[[:space:]]*elapsed=/)) {
+  key = ""
+  if (split($0, cols, "\t") >= 5 && cols[5] ~ /^[0-9]+/) {
+    # Compact line (SCOPE_TIMER_LINE_FORMAT=COMPACT): label, TID, callsite,
+    # start, elapsed ns. Group by label and callsite, as for cleaned logs.
+    key  = "[" cols[1] "] " cols[3]
+    rest = cols[5]
+    sub(/^[0-9]+/, "&ns", rest)
+  } else if (match($0, /[[:space:]]*\|[[:space:]]*elapsed=/)) {
+    # Find split point at: optional spaces, literal pipe, optional spaces, then "elapsed="
     key  = substr($0, 1, RSTART - 1)
-    rest = substr($0, RSTART + RLENGTH)  # e.g. "8us", "5.194ms", "15.059s"
-
-    # Determine unit (BSD awk-safe)
-    unit = ""
-    if (rest ~ /ns$/)      unit = "ns"
-    else if (rest ~ /us$/) unit = "us"
-    else if (rest ~ /ms$/) unit = "ms"
-    else if (rest ~ /s$/)  unit = "s"
-
-    if (unit != "") {
-      num = rest
-      sub(/(ns|us|ms|s)$/, "", num)   # strip unit
-      if (num ~ /^[0-9]+(\.[0-9]+)?$/) {
-        us = to_us(num, unit)
-
-        if (!(key in kseen)) {
-          kseen[key] = 1
-          korder[++kcnt] = key     # remember first-seen order
-          c[key] = 0
-          sum[key] = 0
-          min[key] = us
-          max[key] = us
+    rest = substr($0, RSTART + RLENGTH)  # e.g. "8us", "5.194ms | cpu=1.2ms | offcpu=4ms"
+  }
+  if (key != "") {
+    us = parse_us(rest)
+    if (us >= 0) {
+      if (!(key in kseen)) {
+        kseen[key] = 1
+        korder[++kcnt] = key     # remember first-seen order
+        c[key] = 0
+        sum[key] = 0
+        min[key] = us
+        max[key] = us
+      }
+
+      seq = ++c[key]
+      series[key, seq] = us
+      sum[key] += us
+      if (us < min[key]) min[key] = us
+      if (us > max[key]) max[key] = us
+
+      if (match(rest, /\|[[:space:]]*cpu=/)) {
+        cpu = parse_us(substr(rest, RSTART + RLENGTH))
+        if (cpu >= 0) {
+          ccount[key]++
+          csum[key] += cpu
+          coff[key] += (us > cpu ? us - cpu : 0)
+        }
+      }
+
+      if (match(rest, /\|[[:space:]]*suspended=/)) {
+        suspended = parse_us(substr(rest, RSTART + RLENGTH))
+        if (suspended >= 0) {
+          scount[key]++
+          ssum[key] += suspended
+          sactive[key] += (us > suspended ? us - suspended : 0)
+          smigrations[key] += (field_num(rest, "migrations") > 0 ? field_num(rest, "migrations") : 0)
         }
+      }
 
-        seq = ++c[key]
-        series[key, seq] = us
-        sum[key] += us
-        if (us < min[key]) min[key] = us
-        if (us > max[key]) max[key] = us
+      if ((faults = field_num(rest, "page-faults")) >= 0) {
+        pcount[key]++
+        pfaults[key] += faults
+        pctxsw[key] += field_num(rest, "ctx-sw")
+        if ((instr = field_num(rest, "instr")) >= 0) {
+          hcount[key]++
+          hinstr[key] += instr
+          hcycles[key] += field_num(rest, "cycles")
+          hcache[key] += field_num(rest, "cache-miss")
+          hbranch[key] += field_num(rest, "branch-miss")
+        }
+      }
+
+      if ((minflt = field_num(rest, "minflt")) >= 0) {
+        rcount[key]++
+        rminflt[key] += minflt
+        rmajflt[key] += field_num(rest, "majflt")
+        rnvcsw[key] += field_num(rest, "nvcsw")
+        rnivcsw[key] += field_num(rest, "nivcsw")
+      }
+
+      if ((allocs = field_num(rest, "allocs")) >= 0) {
+        acount[key]++
+        aallocs[key] += allocs
+        abytes[key] += field_num(rest, "alloc-bytes")
+      }
+
+      if ((suppressed = field_num(rest, "suppressed")) > 0) {
+        skipped[key] += suppressed
+      }
+
+      if ((iterations = field_num(rest, "iterations")) >= 0) {
+        icount[key]++
+        iiters[key] += iterations
+        if (match(rest, /\|[[:space:]]*iter-mean=/)) imean[key] += parse_us(substr(rest, RSTART + RLENGTH))
+        if (match(rest, /\|[[:space:]]*iter-p99=/)) {
+          p99 = parse_us(substr(rest, RSTART + RLENGTH))
+          if (p99 > ip99[key]) ip99[key] = p99
+        }
+      }
+
+      laps = rest
+      while (match(laps, /\|[[:space:]]*lap:[^=|[:space:]]+=/)) {
+        lap = substr(laps, RSTART, RLENGTH)
+        sub(/^\|[[:space:]]*lap:/, "", lap)
+        sub(/=$/, "", lap)
+        laps = substr(laps, RSTART + RLENGTH)
+        split_us = parse_us(laps)
+        if (split_us >= 0) {
+          if (!((key, lap) in lapcount)) laporder[key, ++lapnames[key]] = lap
+          lapcount[key, lap]++
+          lapsum[key, lap] += split_us
+        }
       }
     }
   }
@@ -134,8 +234,46 @@ END {
       else                                trend = "→"
     }
 
-    printf("%s\n  count=%d  min=%s  avg=%s  max=%s  %s\n\n",
+    printf("%s\n  count=%d  min=%s  avg=%s  max=%s  %s\n",
            k, n, fmt_us(min[k]), fmt_us(avg), fmt_us(max[k]), trend)
+    if (ccount[k] > 0) {
+      printf("  cpu avg=%s  offcpu avg=%s\n", fmt_us(csum[k] / ccount[k]), fmt_us(coff[k] / ccount[k]))
+    }
+    if (scount[k] > 0) {
+      printf("  active avg=%s  suspended avg=%s  migrations avg=%.1f\n",
+             fmt_us(sactive[k] / scount[k]), fmt_us(ssum[k] / scount[k]), smigrations[k] / scount[k])
+    }
+    if (hcount[k] > 0) {
+      printf("  ipc=%.2f  cache-miss avg=%.0f  branch-miss avg=%.0f\n",
+             (hcycles[k] > 0 ? hinstr[k] / hcycles[k] : 0), hcache[k] / hcount[k], hbranch[k] / hcount[k])
+    }
+    if (pcount[k] > 0) {
+      printf("  ctx-sw avg=%.1f  page-faults avg=%.1f\n", pctxsw[k] / pcount[k], pfaults[k] / pcount[k])
+    }
+    if (rcount[k] > 0) {
+      printf("  minflt avg=%.1f  majflt avg=%.1f  nvcsw avg=%.1f  nivcsw avg=%.1f\n",
+             rminflt[k] / rcount[k], rmajflt[k] / rcount[k], rnvcsw[k] / rcount[k], rnivcsw[k] / rcount[k])
+    }
+    if (acount[k] > 0) {
+      printf("  allocs avg=%.1f  alloc-bytes avg=%.0f\n", aallocs[k] / acount[k], abytes[k] / acount[k])
+    }
+    if (skipped[k] > 0) {
+      printf("  suppressed total=%d  calls=%d\n", skipped[k], n + skipped[k])
+    }
+    if (icount[k] > 0) {
+      printf("  iterations avg=%.0f  iter-mean avg=%s", iiters[k] / icount[k], fmt_us(imean[k] / icount[k]))
+      if (ip99[k] > 0) printf("  iter-p99 max=%s", fmt_us(ip99[k]))
+      print ""
+    }
+    if (lapnames[k] > 0) {
+      printf("  laps avg:")
+      for (li = 1; li <= lapnames[k]; li++) {
+        lap = laporder[k, li]
+        printf(" %s=%s", lap, fmt_us(lapsum[k, lap] / lapcount[k, lap]))
+      }
+      print ""
+    }
+    print ""
   }
 }
 ' "$input"
@@ -0,0 +1,206 @@
+/*
+ * ScopeTimer - lightweight C++17 scope timing utility
+ * Copyright (C) 2025 Steve Clarke <stephenlclarke@mac.com> https://xyzzy.tools
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * In accordance with section 13 of the AGPL, if you modify this program,
+ * your modified version must prominently offer all users interacting with it
+ * remotely through a computer network an opportunity to receive the source
+ * code of your version.
+ *
+ * Optional allocation hooks for ScopeTimer.
+ * -----------------------------------------
+ * Link this file into exactly one binary to replace the global operator
+ * new/delete family. Every allocation is counted into thread-local counters,
+ * and each ScopeTimer reports the allocations and bytes made on its thread
+ * between construction and destruction (`allocs=` and `alloc-bytes=`).
+ *
+ * Memory still comes from malloc/free. In Release builds (NDEBUG) this file
+ * compiles to nothing and the standard operators stay in place.
+ */
+
+#ifndef NDEBUG
+
+#include "ScopeTimer.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace {
+
+    using ::xyzzy::scopetimer::ScopeTimer;
+
+    /**
+     * @brief Announces the hooks before main() so timers start attaching counts.
+     */
+    const bool hooksLinked = [] {
+        ScopeTimer::markAllocationHooksLinked();
+        return true;
+    }();
+
+    void* allocateCounted(std::size_t size) noexcept {
+        if (size == 0U) {
+            size = 1U;
+        }
+        void* ptr = std::malloc(size);
+        if (ptr != nullptr) {
+            ScopeTimer::noteAllocation(size);
+        }
+        return ptr;
+    }
+
+    void* allocateAlignedCounted(std::size_t size, std::size_t alignment) noexcept {
+        if (size == 0U) {
+            size = 1U;
+        }
+        if (alignment < sizeof(void*)) {
+            alignment = sizeof(void*);
+        }
+        void* ptr = nullptr;
+#if defined(_WIN32)
+        ptr = ::_aligned_malloc(size, alignment);
+#else
+        if (::posix_memalign(&ptr, alignment, size) != 0) {
+            ptr = nullptr;
+        }
+#endif
+        if (ptr != nullptr) {
+            ScopeTimer::noteAllocation(size);
+        }
+        return ptr;
+    }
+
+    /**
+     * @brief operator new semantics: retry through the new-handler, then throw.
+     */
+    template <typename Allocate>
+    void* allocateOrThrow(Allocate allocate) {
+        for (;;) {
+            if (void* ptr = allocate()) {
+                return ptr;
+            }
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    template <typename Allocate>
+    void* allocateOrNull(Allocate allocate) noexcept {
+        try {
+            return allocateOrThrow(allocate);
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    void freeAligned(void* ptr) noexcept {
+#if defined(_WIN32)
+        ::_aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    return allocateOrThrow([size] { return allocateCounted(size); });
+}
+
+void* operator new[](std::size_t size) {
+    return allocateOrThrow([size] { return allocateCounted(size); });
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocateOrNull([size] { return allocateCounted(size); });
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocateOrNull([size] { return allocateCounted(size); });
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow([size, alignment] { return allocateAlignedCounted(size, static_cast<std::size_t>(alignment)); });
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow([size, alignment] { return allocateAlignedCounted(size, static_cast<std::size_t>(alignment)); });
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocateOrNull([size, alignment] { return allocateAlignedCounted(size, static_cast<std::size_t>(alignment)); });
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocateOrNull([size, alignment] { return allocateAlignedCounted(size, static_cast<std::size_t>(alignment)); });
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    freeAligned(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    freeAligned(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    freeAligned(ptr);
+}
+
+#endif // NDEBUG
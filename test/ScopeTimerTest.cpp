@@ -22,7 +22,10 @@
  */
 #include "ScopeTimer.hpp"
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <future>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include <cstdio>
@@ -36,6 +39,8 @@
 #include <fstream>
 #include <iterator>
 #include <cerrno>
+#include <csignal>
+#include <sys/wait.h>
 #include <fcntl.h>
 
 using namespace std::chrono_literals;
@@ -73,11 +78,45 @@ public:
         test_public_log_sink_supports_buffered_mode();
         test_public_log_sink_supports_async_mode();
         test_public_log_sink_supports_zero_flush_thresholds();
+        test_log_sink_write_batch_default_forwards_to_write();
+        test_async_sink_hands_custom_sink_whole_batches();
+        test_buffered_flush_hands_custom_sink_one_batch();
+        test_reserving_log_sink_formats_in_place();
+        test_reserving_log_sink_declined_slot_falls_back_to_write();
+        test_reserving_log_sink_commits_every_reservation();
+        test_reserving_log_sink_supports_buffered_mode();
+        test_record_sink_exclusive_skips_text_output();
+        test_record_sink_alongside_text_keeps_text_output();
+        test_async_scope_timer_tracks_suspension_and_migration();
+        test_scope_span_moves_across_threads();
+        test_lap_timer_collects_checkpoints_in_one_record();
+        test_loop_timer_summarizes_sampled_iterations();
+        test_sampling_macros_count_suppressed_calls();
+        test_formatted_label_is_built_at_delivery();
+        test_compact_timer_delivers_literal_label();
+        test_basic_timer_dispatches_to_static_policies();
+        test_record_sink_hot_path_and_callsite_identity();
+        test_sink_pipeline_fans_out_with_thresholds();
+        test_sink_pipeline_samples_and_caches_callsite_filters();
+        test_sink_pipeline_keeps_active_sink_mode_and_flush_interval();
+        test_flight_recorder_keeps_latest_records_in_memory();
+        test_flight_recorder_dumps_on_signal_and_latency();
+        test_watchdog_reports_scopes_past_deadline();
+        test_watchdog_callback_runs_without_scope_locks();
         test_memory_sink_captures_output();
         test_memory_sink_output_is_plain_text();
         test_memory_sink_without_flush();
         test_long_log_line_truncates_but_still_emits();
         test_summarize_script_handles_nanos();
+        test_summarize_script_reports_cpu_time();
+        test_summarize_script_reads_compact_lines();
+        test_summarize_script_reports_perf_counters();
+        test_summarize_script_reports_resource_usage();
+        test_summarize_script_reports_allocations();
+        test_summarize_script_reports_suspended_time();
+        test_summarize_script_reports_laps();
+        test_summarize_script_reports_loop_iterations();
+        test_summarize_script_reports_suppressed_calls();
         test_default_sink_write_short_circuits();
         test_ensure_log_fd_reuses_existing_handle();
         test_default_sink_write_handles_closed_fd();
@@ -97,6 +136,7 @@ public:
         test_thread_buffered_sink_defers_target_flush_until_disable();
         test_thread_buffered_sink_flushes_on_disable();
         test_thread_buffered_sink_flushes_on_thread_exit();
+        test_per_thread_file_sink_writes_one_file_per_thread();
         test_async_sink_flushes_on_disable();
         test_async_sink_flush_calls_custom_sink();
         test_async_sink_reconfiguration_keeps_worker_running();
@@ -108,6 +148,9 @@ public:
         test_format_elapsed_impl_covers_small_buffer_failures();
         test_fmt_nanos_handles_truncation_and_zero_buffer();
         test_log_line_builders_handle_zero_buffers();
+        test_timestamp_modes_format_utc_and_epoch();
+        test_compact_log_line_drops_field_names();
+        test_short_function_names_trim_signatures();
         test_sink_write_helpers_ignore_empty_payloads();
         test_conditional_timer_direct_true_branch();
         test_flush_active_sink_covers_all_sink_kinds();
@@ -117,7 +160,17 @@ public:
         test_hot_path_disabled_via_env_child_process();
         test_thread_buffered_sink_flushes_on_process_exit();
         test_async_sink_flushes_on_process_exit();
+        test_crash_flush_writes_buffered_records_on_abort();
+        test_crash_flush_chains_previous_handler();
+        test_crash_flush_sees_queued_async_batches_without_locking();
+        test_async_sink_survives_fork();
         test_walltime_disable_omits_timestamps();
+        test_cpu_time_splits_on_and_off_cpu();
+        test_log_line_formats_perf_counters();
+        test_perf_counters_report_page_faults();
+        test_rusage_timer_reports_faults_and_switches();
+        test_allocation_hooks_count_scope_allocations();
+        test_sampler_tail_is_reported_at_exit();
         test_disabled_case_insensitivity_child_process();
         test_bad_env_values_child_process();
         test_flushN_variants_child_process();
@@ -221,8 +274,91 @@ private:
         }
     };
 
+    // Counts batch deliveries separately from single-line writes.
+    class BatchingLogSink final : public ::xyzzy::scopetimer::ScopeTimer::LogSink {
+    public:
+        void write(const char* data, std::size_t len) noexcept override {
+            ++writeCalls;
+            text.append(data, len);
+        }
+
+        void writeBatch(const ::xyzzy::scopetimer::ScopeTimer::SinkSlice* slices, std::size_t count) noexcept override {
+            ++batchCalls;
+            sliceCount += count;
+            for (std::size_t i = 0U; i < count; ++i) {
+                text.append(slices[i].data, slices[i].size);
+            }
+        }
+
+        std::string text;
+        std::size_t writeCalls{0U};
+        std::size_t batchCalls{0U};
+        std::size_t sliceCount{0U};
+    };
+
+    // Fixed-arena sink used to exercise the reserve()/commit() zero-copy path.
+    class ArenaLogSink final : public ::xyzzy::scopetimer::ScopeTimer::ReservingLogSink {
+    public:
+        ::xyzzy::scopetimer::ScopeTimer::SinkSpan reserve(std::size_t maxLen) noexcept override {
+            ++reserveCalls;
+            if (declineReservations || used + maxLen > arena.size()) {
+                return {};
+            }
+            reservedAt = arena.data() + used;
+            return {reservedAt, reservationCap != 0U ? std::min(maxLen, reservationCap) : maxLen};
+        }
+
+        void commit(std::size_t len) noexcept override {
+            ++commitCalls;
+            used += len;
+        }
+
+        std::string contents() const {
+            return std::string(arena.data(), used);
+        }
+
+        std::array<char, 8192> arena{};
+        std::size_t used{0U};
+        std::size_t reserveCalls{0U};
+        std::size_t commitCalls{0U};
+        char* reservedAt{nullptr};
+        std::size_t reservationCap{0U};
+        bool declineReservations{false};
+    };
+
+    // Collects structured records; copies the borrowed views before record() returns.
+    class CapturingRecordSink final : public ::xyzzy::scopetimer::ScopeTimer::RecordSink {
+    public:
+        struct Captured {
+            ::xyzzy::scopetimer::ScopeTimer::Record rec;
+            std::string where;
+            std::string label;
+            // Copies of the timer-owned summaries behind rec.laps and rec.loop.
+            ::xyzzy::scopetimer::ScopeTimer::LapSplits laps{};
+            ::xyzzy::scopetimer::ScopeTimer::LoopStats loop{};
+        };
+
+        void record(const ::xyzzy::scopetimer::ScopeTimer::Record& rec) noexcept override {
+            std::lock_guard lock(mutex);
+            records.push_back(Captured{rec, std::string(rec.where), std::string(rec.label),
+                                       rec.laps != nullptr ? *rec.laps : ::xyzzy::scopetimer::ScopeTimer::LapSplits{},
+                                       rec.loop != nullptr ? *rec.loop : ::xyzzy::scopetimer::ScopeTimer::LoopStats{}});
+        }
+
+        void flush() noexcept override {
+            ++flushes;
+        }
+
+        std::mutex mutex;
+        std::vector<Captured> records;
+        std::size_t flushes{0U};
+    };
+
     static double parseElapsedMillis(const std::string& line) {
-        const std::string needle = "elapsed=";
+        return parseMillisField(line, "elapsed=");
+    }
+
+    static double parseMillisField(const std::string& line, const std::string& needle) {
         const auto pos = line.find(needle);
         if (pos == std::string::npos) {
             return -1.0;
@@ -544,59 +680,1150 @@ private:
                "public log sink receives async output");
     }
 
-    static void test_public_log_sink_supports_zero_flush_thresholds() {
-        sinkCaptureBuffer().clear();
-        CapturingLogSink sink;
-        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+    static void test_public_log_sink_supports_zero_flush_thresholds() {
+        sinkCaptureBuffer().clear();
+        CapturingLogSink sink;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+
+        SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(0U);
+        {
+            SCOPE_TIMER("tests:public_sink:buffered_zero");
+            busyFor(25us);
+        }
+        SCOPE_TIMER_DISABLE_THREAD_BUFFERED_SINK();
+
+        SCOPE_TIMER_ENABLE_ASYNC_SINK(0U);
+        {
+            SCOPE_TIMER("tests:public_sink:async_zero");
+            busyFor(25us);
+        }
+        SCOPE_TIMER_DISABLE_ASYNC_SINK();
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        expect(sinkCaptureBuffer().find("tests:public_sink:buffered_zero") != std::string::npos,
+               "thread-buffered sink accepts zero flush threshold by using the default");
+        expect(sinkCaptureBuffer().find("tests:public_sink:async_zero") != std::string::npos,
+               "async sink accepts zero flush threshold by using the default");
+    }
+
+    static void test_log_sink_write_batch_default_forwards_to_write() {
+        sinkCaptureBuffer().clear();
+        CapturingLogSink sink;
+        const std::array<::xyzzy::scopetimer::ScopeTimer::SinkSlice, 3> slices{{
+            {"one\n", 4U},
+            {"", 0U},
+            {"two\n", 4U},
+        }};
+        static_cast<::xyzzy::scopetimer::ScopeTimer::LogSink&>(sink).writeBatch(slices.data(), slices.size());
+        expect(sinkCaptureBuffer() == "one\ntwo\n", "default writeBatch forwards each slice to write()");
+    }
+
+    static void test_async_sink_hands_custom_sink_whole_batches() {
+        BatchingLogSink sink;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+        // A tiny threshold turns every line into its own async batch.
+        SCOPE_TIMER_ENABLE_ASYNC_SINK(1U);
+        for (int i = 0; i < 32; ++i) {
+            SCOPE_TIMER("tests:batch_sink:async");
+        }
+        SCOPE_TIMER_DISABLE_ASYNC_SINK();
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        std::size_t lines = 0U;
+        for (std::size_t pos = sink.text.find("tests:batch_sink:async"); pos != std::string::npos;
+             pos = sink.text.find("tests:batch_sink:async", pos + 1U)) {
+            ++lines;
+        }
+        expect(lines == 32U, "async worker delivers every line through writeBatch()");
+        expect(sink.writeCalls == 0U && sink.batchCalls != 0U && sink.batchCalls <= sink.sliceCount,
+               "async worker uses one writeBatch() call per drained queue");
+    }
+
+    static void test_buffered_flush_hands_custom_sink_one_batch() {
+        BatchingLogSink sink;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+        SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(64U * 1024U);
+
+        std::promise<void> recorded;
+        std::promise<void> release;
+        std::thread worker([&recorded, releaseFuture = release.get_future()]() mutable {
+            {
+                SCOPE_TIMER("tests:batch_sink:buffered_worker");
+            }
+            recorded.set_value();
+            releaseFuture.wait();
+        });
+        recorded.get_future().wait();
+        {
+            SCOPE_TIMER("tests:batch_sink:buffered_main");
+        }
+        SCOPE_TIMER_DISABLE_THREAD_BUFFERED_SINK();
+        release.set_value();
+        worker.join();
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        expect(sink.batchCalls == 1U && sink.sliceCount == 2U && sink.writeCalls == 0U,
+               "cross-thread buffered flush hands every pending thread buffer over in one batch");
+        expect(sink.text.find("tests:batch_sink:buffered_worker") != std::string::npos
+                   && sink.text.find("tests:batch_sink:buffered_main") != std::string::npos,
+               "batched buffered flush keeps every line");
+    }
+
+    static void test_reserving_log_sink_formats_in_place() {
+        ArenaLogSink sink;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+        {
+            SCOPE_TIMER("tests:reserving_sink:in_place");
+            busyFor(10us);
+        }
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        const std::string out = sink.contents();
+        expect(out.find("tests:reserving_sink:in_place") != std::string::npos,
+               "reserving log sink receives records formatted in its own memory");
+        expect(sink.reserveCalls == 1U && sink.commitCalls == 1U,
+               "reserving log sink sees one reserve/commit pair per direct record");
+        expect(sink.reservedAt == sink.arena.data() && !out.empty() && out.back() == '\n',
+               "reserving log sink commit covers one complete line");
+        expect(::xyzzy::scopetimer::ScopeTimer::customReservingSinkStorage() == nullptr,
+               "resetLogSink clears the reserving sink registration");
+    }
+
+    static void test_reserving_log_sink_declined_slot_falls_back_to_write() {
+        ArenaLogSink sink;
+        sink.declineReservations = true;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+        {
+            SCOPE_TIMER("tests:reserving_sink:declined");
+        }
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        expect(sink.used == 0U && sink.commitCalls == 0U,
+               "declined reservation does not commit any bytes");
+        expect(sink.reserveCalls == 2U,
+               "declined reservation falls back to write(), which retries reserve()");
+        expect(sink.dropped() == 1U, "record declined by write() too is counted as dropped");
+    }
+
+    static void test_reserving_log_sink_commits_every_reservation() {
+        ArenaLogSink sink;
+        sink.reservationCap = 1U;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+        {
+            SCOPE_TIMER("tests:reserving_sink:short_slot");
+        }
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+        sink.write("abc", 3U);
+
+        expect(sink.reserveCalls == 3U && sink.commitCalls == 3U,
+               "reserving log sink gets a commit() for every non-empty reservation");
+        expect(sink.used == 0U && sink.dropped() == 2U,
+               "short reservations are declined instead of truncating the line");
+    }
+
+    static void test_reserving_log_sink_supports_buffered_mode() {
+        ArenaLogSink sink;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(sink);
+        SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(64U * 1024U);
+        {
+            SCOPE_TIMER("tests:reserving_sink:buffered");
+        }
+        SCOPE_TIMER_DISABLE_THREAD_BUFFERED_SINK();
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        expect(sink.contents().find("tests:reserving_sink:buffered") != std::string::npos,
+               "reserving log sink default write() copies buffered batches through reserve()/commit()");
+    }
+
+    static void test_record_sink_exclusive_skips_text_output() {
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        CapturingRecordSink recordSink;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(textSink);
+        ::xyzzy::scopetimer::ScopeTimer::setRecordSink(recordSink);
+        const int expectedLine = __LINE__ + 2;
+        {
+            SCOPE_TIMER("tests:record_sink:exclusive");
+            busyFor(50us);
+        }
+        ::xyzzy::scopetimer::ScopeTimer::resetRecordSink();
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        expect(sinkCaptureBuffer().empty(), "exclusive record sink suppresses text output");
+        expect(recordSink.records.size() == 1U, "exclusive record sink receives one record");
+        expect(recordSink.flushes == 1U, "resetRecordSink flushes the outgoing record sink");
+        if (recordSink.records.size() != 1U) {
+            return;
+        }
+        const auto& captured = recordSink.records.front();
+        expect(captured.label == "tests:record_sink:exclusive", "record carries the label");
+        expect(captured.where.find("test_record_sink_exclusive_skips_text_output") != std::string::npos,
+               "record carries the enclosing function");
+        expect(captured.rec.site != nullptr && captured.rec.site->line == static_cast<unsigned>(expectedLine)
+                   && std::string_view(captured.rec.site->file).find("ScopeTimerTest.cpp") != std::string_view::npos,
+               "record points at the macro callsite descriptor");
+        expect(captured.rec.endSteadyNs - captured.rec.startSteadyNs >= 50'000,
+               "record steady timestamps span the timed work");
+        expect(captured.rec.hasWallTime && captured.rec.endWallNs >= captured.rec.startWallNs && captured.rec.startWallNs > 0,
+               "record carries wall-clock timestamps by default");
+        const auto wallNowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::system_clock::now().time_since_epoch())
+                                   .count();
+        expect(captured.rec.endWallNs - captured.rec.startWallNs == captured.rec.endSteadyNs - captured.rec.startSteadyNs
+                   && captured.rec.endWallNs <= wallNowNs + 1'000'000'000 && captured.rec.endWallNs >= wallNowNs - 1'000'000'000,
+               "wall timestamps are derived from the steady stamps and track the system clock");
+        expect(!captured.rec.hotPath && captured.rec.threadNum != 0U, "record carries thread number and mode");
+    }
+
+    static void test_async_scope_timer_tracks_suspension_and_migration() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        CapturingRecordSink recordSink;
+        ScopeTimer::setLogSink(textSink);
+        ScopeTimer::setRecordSink(recordSink, ScopeTimer::RecordSinkMode::AlongsideText);
+
+        static const ScopeTimer::CallSite site{"asyncOperation()", __FILE__, static_cast<unsigned>(__LINE__)};
+        auto timer = std::make_unique<::xyzzy::scopetimer::AsyncScopeTimer>(
+            site, ::xyzzy::scopetimer::detail::makeLabelData("tests:async_scope"));
+        busyFor(2ms);
+        timer->suspend();
+        std::thread resumer([&timer] {
+            // Stands in for an executor resuming the coroutine on another thread.
+            std::this_thread::sleep_for(20ms);
+            timer->resume();
+            busyFor(2ms);
+            timer.reset();
+        });
+        resumer.join();
+        ScopeTimer::resetRecordSink();
+        ScopeTimer::resetLogSink();
+
+        expect(recordSink.records.size() == 1U, "async scope emits one record when destroyed");
+        if (recordSink.records.size() != 1U) {
+            return;
+        }
+        const auto& rec = recordSink.records.front().rec;
+        const std::int64_t elapsedNs = rec.endSteadyNs - rec.startSteadyNs;
+        expect(rec.hasSuspendedTime && rec.suspendedNs >= 18'000'000 && rec.suspendedNs < elapsedNs,
+               "async scope reports the suspended stretch separately");
+        expect(elapsedNs - rec.suspendedNs >= 4'000'000, "async scope active time covers both running stretches");
+        expect(rec.migrations == 1U, "resume on another thread counts as a migration");
+        const std::string text = sinkCaptureBuffer();
+        expect(text.find(" | active=") != std::string::npos && text.find(" | suspended=") != std::string::npos
+                   && text.find(" | migrations=1") != std::string::npos,
+               "async scope text line carries active, suspended and migrations");
+    }
+
+    static void test_scope_span_moves_across_threads() {
+        using ::xyzzy::scopetimer::ScopeSpan;
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        CapturingRecordSink recordSink;
+        ScopeTimer::setLogSink(textSink);
+        ScopeTimer::setRecordSink(recordSink, ScopeTimer::RecordSinkMode::AlongsideText);
+
+        const std::string longLabel = "tests:span:" + std::string(300, 'x');
+        static const ScopeTimer::CallSite site{"handleRequest()", __FILE__, static_cast<unsigned>(__LINE__)};
+        ScopeSpan span(site, ::xyzzy::scopetimer::detail::makeLabelData(longLabel), 42U);
+        ScopeSpan cancelled(site, ::xyzzy::scopetimer::detail::makeLabelData("tests:span:cancelled"));
+        cancelled.cancel();
+        busyFor(2ms);
+        std::thread finisher([moved = std::move(span)]() mutable {
+            busyFor(2ms);
+            moved.finish();
+            moved.finish();
+        });
+        finisher.join();
+        expect(!span.active(), "moved-from span is inactive");
+        span.finish();
+
+        SCOPE_TIMER_SPAN(reassigned, "tests:span:first");
+        reassigned = ScopeSpan(site, ::xyzzy::scopetimer::detail::makeLabelData("tests:span:second"), 7U);
+        reassigned.finish();
+        ScopeTimer::resetRecordSink();
+        ScopeTimer::resetLogSink();
+
+        expect(recordSink.records.size() == 3U, "spans emit one record each and cancelled spans none");
+        if (recordSink.records.size() != 3U) {
+            return;
+        }
+        const auto& moved = recordSink.records[0];
+        expect(moved.label == longLabel, "span label survives the move to another thread");
+        expect(moved.rec.correlationId == 42U, "span carries its correlation id");
+        expect(moved.rec.endSteadyNs - moved.rec.startSteadyNs >= 4'000'000, "span covers both threads");
+        expect(!moved.rec.hasCpuTime && !moved.rec.hasAllocations,
+               "span finished on another thread drops per-thread counters");
+        expect(recordSink.records[1].label == "tests:span:first" && recordSink.records[1].rec.correlationId == 0U,
+               "move assignment finishes the span it replaces");
+        expect(recordSink.records[2].label == "tests:span:second" && recordSink.records[2].rec.correlationId == 7U,
+               "move-assigned span reports under its own label");
+        const std::string text = sinkCaptureBuffer();
+        expect(text.find(" | corr=42") != std::string::npos, "span text line carries corr=");
+        expect(text.find("tests:span:cancelled") == std::string::npos, "cancelled span writes nothing");
+    }
+
+    static void lapDecodePhase() {
+        busyFor(2ms);
+        SCOPE_TIMER_LAP("decode");
+    }
+
+    static void test_lap_timer_collects_checkpoints_in_one_record() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        CapturingRecordSink recordSink;
+        ScopeTimer::setLogSink(textSink);
+        ScopeTimer::setRecordSink(recordSink, ScopeTimer::RecordSinkMode::AlongsideText);
+        SCOPE_TIMER_LAP("ignored"); // no lap timer on this thread yet
+        {
+            SCOPE_TIMER_LAPS("tests:laps");
+            busyFor(1ms);
+            SCOPE_TIMER_LAP("parse");
+            lapDecodePhase();
+            {
+                SCOPE_TIMER_LAPS("tests:laps:inner");
+                SCOPE_TIMER_LAP("inner");
+            }
+            for (std::size_t i = 0; i < ScopeTimer::LapSplits::Capacity; ++i) {
+                SCOPE_TIMER_LAP("extra");
+            }
+        }
+        ScopeTimer::resetRecordSink();
+        ScopeTimer::resetLogSink();
+
+        expect(recordSink.records.size() == 2U, "lap timers emit one record each");
+        if (recordSink.records.size() != 2U) {
+            return;
+        }
+        const auto& inner = recordSink.records[0];
+        expect(inner.rec.laps != nullptr && inner.laps.count == 1U && inner.laps.splits[0].name == "inner",
+               "SCOPE_TIMER_LAP laps the innermost lap timer");
+        const auto& outer = recordSink.records[1];
+        expect(outer.rec.laps != nullptr && outer.laps.count == ScopeTimer::LapSplits::Capacity
+                   && outer.laps.dropped == 2U,
+               "laps past capacity are counted as dropped");
+        expect(outer.laps.splits[0].name == "parse" && outer.laps.splits[0].ns >= 1'000'000,
+               "first lap measures from the start of the scope");
+        expect(outer.laps.splits[1].name == "decode" && outer.laps.splits[1].ns >= 2'000'000
+                   && outer.laps.splits[1].ns < outer.rec.endSteadyNs - outer.rec.startSteadyNs,
+               "later laps measure from the previous lap");
+        const std::string text = sinkCaptureBuffer();
+        expect(text.find(" | lap:parse=") != std::string::npos && text.find(" | lap:decode=") != std::string::npos
+                   && text.find(" | laps-dropped=2") != std::string::npos,
+               "lap timer text line carries one field per lap");
+        expect(text.find("lap:ignored") == std::string::npos, "SCOPE_TIMER_LAP without a lap timer does nothing");
+    }
+
+    static void test_loop_timer_summarizes_sampled_iterations() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        CapturingRecordSink recordSink;
+        ScopeTimer::setLogSink(textSink);
+        ScopeTimer::setRecordSink(recordSink, ScopeTimer::RecordSinkMode::AlongsideText);
+        {
+            // More samples than SampleCapacity, so the buffer is thinned out twice.
+            SCOPE_TIMER_LOOP(loop, 1, "tests:loop:sampled");
+            for (int i = 0; i < 1000; ++i) {
+                SCOPE_TIMER_ITERATION(loop);
+                if (i % 10 == 9) {
+                    busyFor(100us);
+                }
+            }
+        }
+        {
+            SCOPE_TIMER_LOOP(loop, 0, "tests:loop:counted");
+            for (int i = 0; i < 50; ++i) {
+                SCOPE_TIMER_ITERATION(loop);
+            }
+        }
+        ScopeTimer::resetRecordSink();
+        ScopeTimer::resetLogSink();
+
+        expect(recordSink.records.size() == 2U, "loop timers emit one record per loop");
+        if (recordSink.records.size() != 2U) {
+            return;
+        }
+        expect(recordSink.records[0].rec.loop != nullptr && recordSink.records[1].rec.loop != nullptr,
+               "loop timer records carry the loop summary");
+        const auto& sampled = recordSink.records[0].loop;
+        expect(sampled.iterations == 1000U, "loop timer counts every iteration");
+        expect(sampled.sampled > ::xyzzy::scopetimer::LoopScopeTimer::SampleCapacity && sampled.sampled < 1000U,
+               "loop timer widens the sampling stride once the buffer fills");
+        expect(sampled.minNs <= sampled.p50Ns && sampled.p50Ns <= sampled.p90Ns && sampled.p90Ns <= sampled.p99Ns
+                   && sampled.p99Ns <= sampled.maxNs,
+               "loop percentiles are ordered");
+        expect(sampled.p50Ns < 100'000 && sampled.p99Ns >= 100'000 && sampled.maxNs >= 100'000,
+               "loop percentiles separate slow iterations from fast ones");
+        expect(sampled.meanNs > 0 && sampled.meanNs < sampled.maxNs, "loop mean is scope time over iterations");
+        const auto& counted = recordSink.records[1].loop;
+        expect(counted.iterations == 50U && counted.sampled == 0U, "loop timer without sampling only counts");
+        const std::string text = sinkCaptureBuffer();
+        expect(text.find(" | iterations=1000 | iter-mean=") != std::string::npos
+                   && text.find(" | sampled=") != std::string::npos && text.find(" | iter-min=") != std::string::npos
+                   && text.find(" | iter-p99=") != std::string::npos,
+               "loop timer text line carries the iteration summary");
+        expect(text.find(" | iterations=50 | iter-mean=") != std::string::npos
+                   && text.find(" | sampled=0") == std::string::npos,
+               "loop timer without sampling leaves out sampled fields");
+    }
+
+    static void test_formatted_label_is_built_at_delivery() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        CapturingRecordSink recordSink;
+        ScopeTimer::setRecordSink(recordSink);
+        const unsigned shard = 7U;
+        const unsigned long long requestId = 12345ULL;
+        {
+            SCOPE_TIMER_FMT("shard=%u req=%llu", shard, requestId);
+        }
+        {
+            static const ScopeTimer::CallSite site{"fmt()", __FILE__, static_cast<unsigned>(__LINE__)};
+            ScopeTimer timer(site, ::xyzzy::scopetimer::detail::makeFormattedLabel("who=%s n=%d", "ada", 3));
+            expect(timer.label_ == "who=%s n=%d" && timer.labelFormatter_ != nullptr,
+                   "SCOPE_TIMER_FMT leaves the label unformatted while the scope runs");
+        }
+        const std::string longArg(200U, 'x');
+        {
+            SCOPE_TIMER_FMT("long=%s", longArg.c_str());
+        }
+        {
+            SCOPE_TIMER_FMT("static");
+        }
+        ScopeTimer::resetRecordSink();
+
+        expect(recordSink.records.size() == 4U, "SCOPE_TIMER_FMT timers deliver one record each");
+        if (recordSink.records.size() != 4U) {
+            return;
+        }
+        expect(recordSink.records[0].label == "shard=7 req=12345", "SCOPE_TIMER_FMT formats captured arguments at delivery");
+        expect(recordSink.records[1].label == "who=ada n=3", "SCOPE_TIMER_FMT accepts string pointers");
+        expect(recordSink.records[2].label.size() == ::xyzzy::scopetimer::detail::InlineLabelCapacity - 1U
+                   && recordSink.records[2].label.compare(0U, 8U, "long=xxx") == 0,
+               "SCOPE_TIMER_FMT truncates to the inline label storage");
+        expect(recordSink.records[3].label == "static", "SCOPE_TIMER_FMT without arguments uses the format as the label");
+    }
+
+    static void test_compact_timer_delivers_literal_label() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        static_assert(sizeof(::xyzzy::scopetimer::CompactScopeTimer) <= 32U);
+        static_assert(sizeof(::xyzzy::scopetimer::CompactScopeTimer) < sizeof(ScopeTimer));
+        CapturingRecordSink recordSink;
+        ScopeTimer::setRecordSink(recordSink);
+        const auto before = std::chrono::steady_clock::now();
+        {
+            SCOPE_TIMER_COMPACT("tests:compact:outer");
+            {
+                SCOPE_TIMER_COMPACT("tests:compact:inner");
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+        const auto after = std::chrono::steady_clock::now();
+        ScopeTimer::resetRecordSink();
+
+        expect(recordSink.records.size() == 2U, "SCOPE_TIMER_COMPACT delivers one record per scope");
+        if (recordSink.records.size() != 2U) {
+            return;
+        }
+        const auto& inner = recordSink.records[0];
+        const auto& outer = recordSink.records[1];
+        expect(inner.label == "tests:compact:inner" && outer.label == "tests:compact:outer",
+               "SCOPE_TIMER_COMPACT reports its literal label");
+        expect(inner.rec.site != nullptr && outer.rec.site != nullptr && inner.rec.site != outer.rec.site
+                   && inner.rec.site->line == outer.rec.site->line + 2U,
+               "SCOPE_TIMER_COMPACT carries its own callsite descriptor");
+        expect(inner.where.find("test_compact_timer_delivers_literal_label") != std::string::npos,
+               "SCOPE_TIMER_COMPACT reports the enclosing function");
+        expect(inner.rec.threadNum == ScopeTimer::getThreadIdNumber(), "SCOPE_TIMER_COMPACT records the thread number");
+        const std::int64_t innerNs = inner.rec.endSteadyNs - inner.rec.startSteadyNs;
+        const std::int64_t outerNs = outer.rec.endSteadyNs - outer.rec.startSteadyNs;
+        expect(innerNs >= 2000000 && outerNs >= innerNs
+                   && outerNs <= std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count(),
+               "SCOPE_TIMER_COMPACT times from construction to scope end");
+        expect(!inner.rec.hasCpuTime && !inner.rec.hasAllocations && !inner.rec.hasPerfCounts,
+               "SCOPE_TIMER_COMPACT records carry no start-time counters");
+    }
+
+    struct StepClockPolicy {
+        using tick_type = std::int64_t;
+        static inline tick_type ticks = 0;
+
+        static tick_type now() noexcept {
+            ticks += 10;
+            return ticks;
+        }
+
+        static std::int64_t elapsedNs(tick_type start, tick_type end) noexcept {
+            return (end - start) * 100;
+        }
+    };
+
+    static void test_basic_timer_dispatches_to_static_policies() {
+        using namespace ::xyzzy::scopetimer;
+        using Ring = ThreadRingSinkPolicy<4>;
+        using RingTimer = BasicScopeTimer<StepClockPolicy, Ring>;
+        static_assert(sizeof(RingTimer) <= 32U);
+        Ring::drain([](const ScopeTimer::ElapsedSample&) {});
+
+        for (int i = 0; i < 6; ++i) {
+            SCOPE_TIMER_WITH(RingTimer, "tests:basic:ring");
+        }
+        std::vector<ScopeTimer::ElapsedSample> drained;
+        const std::size_t kept = Ring::drain([&drained](const ScopeTimer::ElapsedSample& s) { drained.push_back(s); });
+        expect(kept == 4U && drained.size() == 4U, "ThreadRingSinkPolicy keeps the latest Capacity samples");
+        expect(!drained.empty() && drained.front().label == "tests:basic:ring" && drained.front().site != nullptr
+                   && drained.front().elapsedNs == 1000,
+               "BasicScopeTimer hands the sink its label, callsite and policy-clock elapsed time");
+        expect(Ring::drain([](const ScopeTimer::ElapsedSample&) {}) == 0U, "ThreadRingSinkPolicy::drain empties the ring");
+
+        std::size_t otherThreadKept = 0U;
+        std::thread([&otherThreadKept] {
+            SCOPE_TIMER_WITH(RingTimer, "tests:basic:ring:other");
+            // Still open here, so this thread's ring is empty.
+            otherThreadKept = Ring::drain([](const ScopeTimer::ElapsedSample&) {});
+        }).join();
+        expect(otherThreadKept == 0U && Ring::drain([](const ScopeTimer::ElapsedSample&) {}) == 0U,
+               "ThreadRingSinkPolicy keeps one ring per thread");
+
+        CapturingRecordSink recordSink;
+        ScopeTimer::setRecordSink(recordSink);
+        {
+            SCOPE_TIMER_WITH(BasicScopeTimer<>, "tests:basic:default");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+#if defined(SCOPE_TIMER_HAS_TSC_CLOCK)
+        {
+            using TscTimer = BasicScopeTimer<TscClockPolicy>;
+            SCOPE_TIMER_WITH(TscTimer, "tests:basic:tsc");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        expect(TscClockPolicy::elapsedNs(1000U, 999U) == 0 && TscClockPolicy::elapsedNs(1000U, 1000U) == 0,
+               "TSC readings that go backwards clamp to zero");
+#endif
+        ScopeTimer::resetRecordSink();
+
+        expect(!recordSink.records.empty() && recordSink.records[0].label == "tests:basic:default"
+                   && recordSink.records[0].rec.site != nullptr,
+               "BasicScopeTimer<> writes through ScopeTimer's sinks");
+        for (const auto& captured : recordSink.records) {
+            const std::int64_t ns = captured.rec.endSteadyNs - captured.rec.startSteadyNs;
+            expect(ns >= 1500000 && ns < 1000000000, "BasicScopeTimer clock policies measure the scope");
+        }
+    }
+
+    static void test_sampling_macros_count_suppressed_calls() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        CapturingRecordSink recordSink;
+        ScopeTimer::StatsRecordSink stats;
+        ScopeTimer::setLogSink(textSink);
+        ScopeTimer::setSinkPipeline({
+            ScopeTimer::SinkRoute::toLogSink(textSink),
+            ScopeTimer::SinkRoute::toRecordSink(recordSink),
+            ScopeTimer::SinkRoute::toRecordSink(stats),
+        });
+        ScopeTimer::Sampler everyFourth = ScopeTimer::Sampler::oneIn(4U);
+        ScopeTimer::Sampler burstOfThree = ScopeTimer::Sampler::perSecond(0.001, 3U);
+        ScopeTimer::Sampler never = ScopeTimer::Sampler::withProbability(0.0);
+        ScopeTimer::Sampler always = ScopeTimer::Sampler::withProbability(1.0);
+        std::string labelBuilt;
+        for (int i = 0; i < 10; ++i) {
+            SCOPE_TIMER_SAMPLED(everyFourth, "tests:sampled:one_in_4");
+            SCOPE_TIMER_SAMPLED(burstOfThree, "tests:sampled:rate");
+            SCOPE_TIMER_SAMPLED(never, (labelBuilt += "x", "tests:sampled:never"));
+            SCOPE_TIMER_SAMPLED(always, "tests:sampled:always");
+        }
+        ScopeTimer::Sampler half = ScopeTimer::Sampler::withProbability(0.5);
+        int halfAdmitted = 0;
+        for (int i = 0; i < 4000; ++i) {
+            halfAdmitted += half.admit() ? 1 : 0;
+        }
+        for (int i = 0; i < 3; ++i) {
+            SCOPE_TIMER_EVERY_N(2, "tests:sampled:every_n_macro");
+        }
+        ScopeTimer::resetSinkPipeline();
+        ScopeTimer::resetLogSink();
+
+        const auto suppressedFor = [&recordSink](std::string_view label) {
+            std::vector<std::uint64_t> out;
+            for (const auto& captured : recordSink.records) {
+                if (captured.label == label) {
+                    out.push_back(captured.rec.suppressed);
+                }
+            }
+            return out;
+        };
+        expect(suppressedFor("tests:sampled:one_in_4") == std::vector<std::uint64_t>{0U, 3U, 3U},
+               "1-in-N sampling admits the first and every N-th call");
+        expect(everyFourth.suppressed() == 1U, "calls after the last admitted record stay pending");
+        expect(suppressedFor("tests:sampled:rate") == std::vector<std::uint64_t>{0U, 0U, 0U} && burstOfThree.suppressed() == 7U,
+               "rate limiter admits its burst, then suppresses");
+        expect(suppressedFor("tests:sampled:never").empty() && never.suppressed() == 10U,
+               "zero probability admits nothing");
+        expect(labelBuilt.empty(), "rejected calls do not build their label");
+        expect(suppressedFor("tests:sampled:always").size() == 10U, "probability one admits every call");
+        expect(halfAdmitted > 1600 && halfAdmitted < 2400, "probabilistic sampling admits about p of the calls");
+        expect(suppressedFor("tests:sampled:every_n_macro") == std::vector<std::uint64_t>{0U, 1U},
+               "SCOPE_TIMER_EVERY_N keeps one sampler per callsite");
+        expect(sinkCaptureBuffer().find("[tests:sampled:one_in_4]") != std::string::npos
+                   && sinkCaptureBuffer().find(" | suppressed=3") != std::string::npos,
+               "admitted records carry suppressed= in text");
+
+        const auto entries = stats.snapshot();
+        const auto oneIn4 = std::find_if(entries.begin(), entries.end(),
+                                         [](const auto& e) { return e.label == "tests:sampled:one_in_4"; });
+        expect(oneIn4 != entries.end() && oneIn4->count == 3U && oneIn4->suppressedTotal == 6U,
+               "stats sink keeps suppressed calls so count + suppressed equals calls seen");
+    }
+
+    static void test_record_sink_alongside_text_keeps_text_output() {
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        CapturingRecordSink recordSink;
+        ::xyzzy::scopetimer::ScopeTimer::setLogSink(textSink);
+        ::xyzzy::scopetimer::ScopeTimer::setRecordSink(
+            recordSink, ::xyzzy::scopetimer::ScopeTimer::RecordSinkMode::AlongsideText);
+        {
+            SCOPE_TIMER("tests:record_sink:alongside");
+        }
+        ::xyzzy::scopetimer::ScopeTimer::resetRecordSink();
+        {
+            SCOPE_TIMER("tests:record_sink:after_reset");
+        }
+        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+
+        expect(sinkCaptureBuffer().find("tests:record_sink:alongside") != std::string::npos,
+               "alongside-text record sink keeps text output");
+        expect(sinkCaptureBuffer().find("start=") != std::string::npos,
+               "alongside-text record sink keeps wall timestamps in text");
+        expect(sinkCaptureBuffer().find("tests:record_sink:after_reset") != std::string::npos,
+               "text output continues after resetRecordSink");
+        expect(recordSink.records.size() == 1U, "reset record sink no longer receives records");
+    }
+
+    static void test_record_sink_hot_path_and_callsite_identity() {
+        CapturingRecordSink recordSink;
+        ::xyzzy::scopetimer::ScopeTimer::setRecordSink(recordSink);
+        for (int i = 0; i < 2; ++i) {
+            SCOPE_TIMER_HOT_PATH("tests:record_sink:hot"); SCOPE_TIMER_IF(true, "tests:record_sink:conditional");
+        }
+        {
+            // Text disabled at construction, re-enabled before the timer ends:
+            // wall stamps are derived at render time, so start= is still filled in.
+            sinkCaptureBuffer().clear();
+            CapturingLogSink textSink;
+            ::xyzzy::scopetimer::ScopeTimer::setLogSink(textSink);
+            {
+                SCOPE_TIMER("tests:record_sink:late_start");
+                ::xyzzy::scopetimer::ScopeTimer::setRecordSink(
+                    recordSink, ::xyzzy::scopetimer::ScopeTimer::RecordSinkMode::AlongsideText);
+            }
+            ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+            const std::string& out = sinkCaptureBuffer();
+            expect(out.find("tests:record_sink:late_start") != std::string::npos
+                       && out.find("start= |") == std::string::npos,
+                   "start stamp is rendered when text output resumes mid-scope");
+        }
+        ::xyzzy::scopetimer::ScopeTimer::resetRecordSink();
+
+        expect(recordSink.records.size() == 5U, "record sink sees hot-path and conditional timers");
+        if (recordSink.records.size() != 5U) {
+            return;
+        }
+        // Timers in one scope end in reverse order: conditional first, then hot path.
+        const auto& cond0 = recordSink.records[0];
+        const auto& hot0 = recordSink.records[1];
+        const auto& hot1 = recordSink.records[3];
+        expect(hot0.rec.hotPath && !hot0.rec.hasWallTime, "hot-path records skip wall time");
+        expect(hot0.rec.site != nullptr && hot0.rec.site == hot1.rec.site,
+               "one macro expansion keeps one callsite across iterations");
+        expect(cond0.rec.site != nullptr && cond0.rec.site != hot0.rec.site && cond0.rec.site->line == hot0.rec.site->line,
+               "two timers on one line get distinct callsites");
+    }
+
+    static void test_sink_pipeline_fans_out_with_thresholds() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink slowSink;
+        ScopeTimer::StatsRecordSink stats;
+        ScopeTimer::setSinkPipeline({
+            ScopeTimer::SinkRoute::toLogSink(slowSink).withMinElapsed(2ms),
+            ScopeTimer::SinkRoute::toRecordSink(stats),
+        });
+        for (int i = 0; i < 3; ++i) {
+            SCOPE_TIMER("tests:pipeline:fast");
+        }
+        {
+            SCOPE_TIMER("tests:pipeline:slow");
+            busyFor(3000us);
+        }
+        const std::size_t flushesBefore = sinkFlushCount();
+        ScopeTimer::resetSinkPipeline();
+
+        expect(sinkCaptureBuffer().find("tests:pipeline:slow") != std::string::npos,
+               "pipeline threshold route receives slow records as text");
+        expect(sinkCaptureBuffer().find("tests:pipeline:fast") == std::string::npos,
+               "pipeline threshold route drops fast records");
+        expect(sinkFlushCount() == flushesBefore + 1U, "replacing the pipeline flushes its log sinks");
+
+        const auto entries = stats.snapshot();
+        const auto find = [&entries](std::string_view label) {
+            return std::find_if(entries.begin(), entries.end(), [label](const auto& e) { return e.label == label; });
+        };
+        const auto fast = find("tests:pipeline:fast");
+        const auto slow = find("tests:pipeline:slow");
+        expect(entries.size() == 2U && fast != entries.end() && slow != entries.end(),
+               "stats sink aggregates one entry per callsite and label");
+        if (fast != entries.end() && slow != entries.end()) {
+            expect(fast->count == 3U && fast->minNs <= fast->maxNs && fast->totalNs >= fast->maxNs,
+                   "stats sink tracks count/total/min/max");
+            expect(slow->count == 1U && slow->minNs >= 3'000'000 && slow->site != nullptr && slow->site != fast->site,
+                   "stats sink keys entries by callsite");
+        }
+    }
+
+    static void test_sink_pipeline_samples_and_caches_callsite_filters() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        static int filterCalls = 0;
+        filterCalls = 0;
+        CapturingRecordSink sampled;
+        CapturingRecordSink filtered;
+        const auto onlyThisTest = [](const ScopeTimer::CallSite& site) {
+            ++filterCalls;
+            return site.where.find("test_sink_pipeline_samples_and_caches_callsite_filters") != std::string_view::npos;
+        };
+        const auto install = [&] {
+            ScopeTimer::setSinkPipeline({
+                ScopeTimer::SinkRoute::toRecordSink(sampled).withSampleEvery(3U),
+                ScopeTimer::SinkRoute::toRecordSink(filtered).withCallSiteFilter(onlyThisTest),
+            });
+        };
+        install();
+        for (int i = 0; i < 9; ++i) {
+            SCOPE_TIMER("tests:pipeline:sampled");
+        }
+        expect(filterCalls == 1, "callsite filter runs once per callsite and pipeline");
+        install();
+        for (int i = 0; i < 2; ++i) {
+            SCOPE_TIMER("tests:pipeline:sampled_again");
+        }
+        {
+            ScopeTimer adHoc("elsewhere", "tests:pipeline:adhoc");
+        }
+        ScopeTimer::resetSinkPipeline();
+
+        expect(sampled.records.size() == 4U, "sampling route keeps every Nth record");
+        expect(filtered.records.size() == 11U, "callsite filter accepts matching callsites");
+        expect(filterCalls == 3, "new pipeline invalidates cached routes; ad-hoc timers evaluate per record");
+        for (const auto& captured : filtered.records) {
+            expect(captured.label != "tests:pipeline:adhoc", "callsite filter rejects non-matching ad-hoc timers");
+        }
+    }
+
+    static void test_sink_pipeline_keeps_active_sink_mode_and_flush_interval() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink sink;
+        ScopeTimer::setLogSink(sink);
+        SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(64U * 1024U);
+        ScopeTimer::setSinkPipeline({ScopeTimer::SinkRoute::toDefaultFile()});
+        {
+            SCOPE_TIMER("tests:pipeline:buffered_default");
+        }
+        expect(sinkCaptureBuffer().empty(), "default-file route goes through the thread-buffered sink");
+        ScopeTimer::resetSinkPipeline();
+        SCOPE_TIMER_DISABLE_THREAD_BUFFERED_SINK();
+        ScopeTimer::resetLogSink();
+        expect(sinkCaptureBuffer().find("tests:pipeline:buffered_default") != std::string::npos,
+               "buffered default-file route output reaches the sink once drained");
+
+        CapturingLogSink logRoute;
+        ScopeTimer::setSinkPipeline({ScopeTimer::SinkRoute::toLogSink(logRoute)});
+        const std::size_t flushesBefore = sinkFlushCount();
+        for (unsigned i = 0U; i < ScopeTimer::flushInterval(); ++i) {
+            SCOPE_TIMER("tests:pipeline:flush_interval");
+        }
+        expect(sinkFlushCount() == flushesBefore + 1U, "SCOPE_TIMER_FLUSH_N flushes pipeline log routes");
+        ScopeTimer::setSinkPipeline({ScopeTimer::SinkRoute::toLogSink(logRoute)});
+        ScopeTimer::resetSinkPipeline();
+        expect(ScopeTimer::retiredSinkPipelines().empty() && !ScopeTimer::installedSinkPipeline(),
+               "replaced pipelines are freed once no timer is delivering");
+        sinkCaptureBuffer().clear();
+    }
+
+    static void test_flight_recorder_keeps_latest_records_in_memory() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        ScopeTimer::setLogSink(textSink);
+        ScopeTimer::FlightRecorderSink recorder(4U);
+        ScopeTimer::setRecordSink(recorder);
+        for (int i = 0; i < 10; ++i) {
+            SCOPE_TIMER("tests:flight:" + std::to_string(i));
+        }
+        ScopeTimer::resetRecordSink();
+        ScopeTimer::resetLogSink();
+        expect(sinkCaptureBuffer().empty(), "flight recorder performs no output until dumped");
+
+        BatchingLogSink dumped;
+        expect(recorder.dump(dumped) == 4U, "flight recorder ring keeps only its newest slots");
+        const auto six = dumped.text.find("[tests:flight:6]");
+        const auto nine = dumped.text.find("[tests:flight:9]");
+        expect(six != std::string::npos && nine != std::string::npos && six < nine
+                   && dumped.text.find("[tests:flight:5]") == std::string::npos,
+               "flight recorder dump overwrites oldest records and writes oldest first");
+        expect(dumped.text.find("test_flight_recorder_keeps_latest_records_in_memory() | start=") != std::string::npos
+                   && dumped.text.find(" | elapsed=") != std::string::npos,
+               "flight recorder dump uses the regular text line format");
+
+        ScopeTimer::FlightRecorderSink shared(64U, ScopeTimer::FlightRecorderSink::Layout::Shared,
+                                              std::chrono::milliseconds(2));
+        ScopeTimer::setRecordSink(shared);
+        {
+            SCOPE_TIMER("tests:flight:expired");
+        }
+        busyFor(5000us);
+        std::thread worker([] {
+            SCOPE_TIMER("tests:flight:worker");
+        });
+        worker.join();
+        {
+            SCOPE_TIMER("tests:flight:main");
+        }
+        ScopeTimer::resetRecordSink();
+        BatchingLogSink window;
+        expect(shared.dump(window) == 2U && window.text.find("tests:flight:worker") != std::string::npos
+                   && window.text.find("tests:flight:main") != std::string::npos,
+               "shared flight ring records every thread");
+        expect(window.text.find("tests:flight:expired") == std::string::npos,
+               "flight recorder dump skips records older than the window");
+    }
+
+    static inline volatile std::sig_atomic_t previousFlightSignalCalls = 0;
+
+    static void countPreviousFlightSignal(int) {
+        previousFlightSignalCalls = previousFlightSignalCalls + 1;
+    }
+
+    static bool waitForFile(const std::string& path, std::chrono::milliseconds timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline) {
+            if (::access(path.c_str(), F_OK) == 0) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+    static void test_flight_recorder_dumps_on_signal_and_latency() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        char templ[] = "/tmp/scopetimer_flightXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        if (!tdir) {
+            expect(false, "flight recorder test created a temp directory");
+            return;
+        }
+        const std::string tmpdir(tdir);
+        const std::string prefix = "ScopeTimer.flight." + std::to_string(::getpid()) + ".";
+        ScopeTimer::resetLogDirectoryForTests(tmpdir);
+        previousFlightSignalCalls = 0;
+        std::signal(SIGUSR2, &countPreviousFlightSignal);
+        {
+            ScopeTimer::FlightRecorderSink recorder;
+            recorder.setTriggerLatency(std::chrono::milliseconds(2));
+            expect(recorder.dumpOnSignal(SIGUSR2), "flight recorder installs its dump signal handler");
+            {
+                ScopeTimer::FlightRecorderSink refused;
+                expect(!refused.dumpOnSignal(SIGKILL), "flight recorder reports a handler it cannot install");
+            }
+            ScopeTimer::setRecordSink(recorder);
+            {
+                SCOPE_TIMER("tests:flight:before_signal");
+            }
+            std::raise(SIGUSR2);
+            expect(previousFlightSignalCalls == 1, "flight recorder chains to the handler it replaced");
+            expect(waitForFile(tmpdir + "/" + prefix + "001.log", std::chrono::seconds(2)),
+                   "signal dump runs without another recorded scope");
+            for (int i = 0; i < 2; ++i) {
+                SCOPE_TIMER("tests:flight:slow");
+                busyFor(3000us);
+            }
+            expect(waitForFile(tmpdir + "/" + prefix + "002.log", std::chrono::seconds(2)),
+                   "slow record hands its dump to the dumper thread");
+            ScopeTimer::resetRecordSink();
+        }
+        struct sigaction restored {};
+        ::sigaction(SIGUSR2, nullptr, &restored);
+        expect((restored.sa_flags & SA_SIGINFO) == 0 && restored.sa_handler == &countPreviousFlightSignal,
+               "flight recorder restores the previous handler when destroyed");
+        std::signal(SIGUSR2, SIG_DFL);
+        ScopeTimer::resetLogDirectoryForTests("/tmp");
+
+        std::vector<std::string> files;
+        if (DIR* dir = ::opendir(tmpdir.c_str())) {
+            while (const dirent* entry = ::readdir(dir)) {
+                const std::string name = entry->d_name;
+                if (name.rfind("ScopeTimer.", 0) == 0) {
+                    files.push_back(name);
+                }
+            }
+            ::closedir(dir);
+        }
+        std::sort(files.begin(), files.end());
+
+        expect(files.size() == 2U && files[0] == prefix + "001.log" && files[1] == prefix + "002.log",
+               "flight recorder writes one numbered file per dump and no shared log");
+        if (files.size() == 2U) {
+            const std::string onSignal = readFileContents(tmpdir + "/" + files[0]);
+            const std::string onLatency = readFileContents(tmpdir + "/" + files[1]);
+            expect(onSignal.find("tests:flight:before_signal") != std::string::npos
+                       && onSignal.find("tests:flight:slow") == std::string::npos,
+                   "signal dump writes the window as of the signal");
+            expect(onLatency.find("tests:flight:slow") != std::string::npos,
+                   "slow record triggers an automatic dump once per window");
+        }
+
+        for (const auto& name : files) {
+            std::remove((tmpdir + "/" + name).c_str());
+        }
+        ::rmdir(tmpdir.c_str());
+    }
+
+    static void test_watchdog_callback_runs_without_scope_locks() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        CapturingLogSink textSink;
+        ScopeTimer::setLogSink(textSink);
+        std::promise<void> scopeEnded;
+        std::shared_future<void> ended = scopeEnded.get_future().share();
+        std::atomic<int> calls{0};
+        bool endedBeforeCallbackReturned = false;
+        ScopeTimer::setWatchdogCallback([&](const ScopeTimer::Record&) {
+            ++calls;
+            // Blocks until the reported scope has closed, which needs its live-scope lock.
+            endedBeforeCallbackReturned = ended.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+            ScopeTimer::setWatchdogCallback(nullptr); // no watchdog lock is held here
+        });
+        SCOPE_TIMER_START_WATCHDOG(std::chrono::milliseconds(1));
+        const auto before = std::chrono::steady_clock::now();
+        {
+            SCOPE_TIMER_DEADLINE(std::chrono::milliseconds(1), "tests:watchdog:blocked_callback");
+            while (calls.load() == 0 && std::chrono::steady_clock::now() - before < std::chrono::seconds(5)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        const auto scopeCloseTime = std::chrono::steady_clock::now() - before;
+        scopeEnded.set_value();
+        SCOPE_TIMER_STOP_WATCHDOG();
+        ScopeTimer::setWatchdogCallback(nullptr);
+        ScopeTimer::resetLogSink();
+
+        expect(calls.load() == 1 && endedBeforeCallbackReturned && scopeCloseTime < std::chrono::seconds(4),
+               "a blocked watchdog callback does not hold up the scope it reports");
+    }
+
+    static void test_watchdog_reports_scopes_past_deadline() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        sinkCaptureBuffer().clear();
+        CapturingLogSink textSink;
+        ScopeTimer::setLogSink(textSink);
+        SCOPE_TIMER_START_WATCHDOG(std::chrono::milliseconds(1));
+        {
+            SCOPE_TIMER_DEADLINE(std::chrono::milliseconds(2), "tests:watchdog:stalled");
+            busyFor(20000us);
+        }
+        {
+            SCOPE_TIMER_DEADLINE(std::chrono::seconds(5), "tests:watchdog:fast");
+        }
+
+        std::mutex capturedMutex;
+        std::vector<std::pair<std::string, ScopeTimer::Record>> captured;
+        ScopeTimer::setWatchdogCallback([&](const ScopeTimer::Record& rec) {
+            std::lock_guard lock(capturedMutex);
+            captured.emplace_back(std::string(rec.label), rec);
+        });
+        {
+            SCOPE_TIMER_DEADLINE(std::chrono::milliseconds(2), "tests:watchdog:outer");
+            SCOPE_TIMER_DEADLINE(std::chrono::hours(1), "tests:watchdog:inner");
+            busyFor(20000us);
+        }
+        SCOPE_TIMER_STOP_WATCHDOG();
+        ScopeTimer::setWatchdogCallback(nullptr);
+        ScopeTimer::resetLogSink();
+
+        const std::string& out = sinkCaptureBuffer();
+        const auto report = out.find("[tests:watchdog:stalled]");
+        expect(report != std::string::npos && out.find("| deadline=", report) != std::string::npos
+                   && out.find("| running=", report) != std::string::npos,
+               "watchdog writes a still-running line for a scope past its deadline");
+        expect(out.find("[tests:watchdog:stalled]", report + 1U) != std::string::npos
+                   && out.find("[tests:watchdog:stalled]", out.find("[tests:watchdog:stalled]", report + 1U) + 1U) == std::string::npos,
+               "watchdog reports a stalled scope once, then the scope logs normally");
+        expect(out.find("tests:watchdog:fast") != std::string::npos
+                   && out.find("running=", out.find("tests:watchdog:fast")) == std::string::npos,
+               "scopes that finish before their deadline are not reported");
+        expect(out.find("tests:watchdog:outer] TID") == std::string::npos
+                   || out.find("tests:watchdog:outer] TID") == out.rfind("tests:watchdog:outer] TID"),
+               "watchdog callback replaces the still-running text line");
+        expect(captured.size() == 1U && captured.front().first == "tests:watchdog:outer"
+                   && captured.front().second.stillRunning && captured.front().second.site != nullptr
+                   && captured.front().second.endSteadyNs - captured.front().second.startSteadyNs >= 2'000'000,
+               "watchdog callback receives only the nested scope past its deadline");
+    }
+
+    static void test_long_log_line_truncates_but_still_emits() {
+        sinkCaptureBuffer().clear();
+        ::xyzzy::scopetimer::ScopeTimer::setLogSinkForTests(&testSinkWrite, &testSinkFlush);
+        const std::string longLabel(700, 'L');
+        {
+            ::xyzzy::scopetimer::ScopeTimer timer("tests:long_label_scope", longLabel);
+            busyFor(20us);
+        }
+        ::xyzzy::scopetimer::ScopeTimer::setLogSinkForTests(nullptr, nullptr);
+
+        expect(!sinkCaptureBuffer().empty(), "overlong log line still emits output");
+        expect(sinkCaptureBuffer().find(std::string(32, 'L')) != std::string::npos,
+               "overlong log line preserves the leading label prefix");
+        expect(sinkCaptureBuffer().find('\0') == std::string::npos,
+               "overlong log line remains plain text");
+    }
+
+    static void test_summarize_script_handles_nanos() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' '[ScopeTimer] fn | elapsed=500ns' | " + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
+
+        expect(output.find("count=1") != std::string::npos,
+               "summarize_scope_times.sh counts nanosecond entries");
+        expect(output.find("500ns") != std::string::npos,
+               "summarize_scope_times.sh preserves nanosecond formatting");
+    }
+
+    static void test_summarize_script_reads_compact_lines() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf 'parse\\t1\\tParser.cpp:42\\t1700000000000000000\\t2000000\\n"
+            "parse\\t2\\tParser.cpp:42\\t1700000000100000000\\t4000000 | cpu=1.000ms | offcpu=3.000ms\\n' | "
+            + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
+
+        expect(output.find("[parse] Parser.cpp:42") != std::string::npos,
+               "summarize_scope_times.sh groups compact lines by label and callsite across threads");
+        expect(output.find("count=2  min=2.000ms  avg=3.000ms  max=4.000ms") != std::string::npos,
+               "summarize_scope_times.sh reads compact elapsed nanoseconds");
+        expect(output.find("cpu avg=1.000ms") != std::string::npos,
+               "summarize_scope_times.sh reads opt-in fields after a compact elapsed");
+    }
+
+    static void test_summarize_script_reports_cpu_time() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' '[ScopeTimer] fn | elapsed=4.000ms | cpu=1.000ms | offcpu=3.000ms' | " + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
+
+        expect(output.find("avg=4.000ms") != std::string::npos,
+               "summarize_scope_times.sh reads the elapsed value ahead of later fields");
+        expect(output.find("cpu avg=1.000ms  offcpu avg=3.000ms") != std::string::npos,
+               "summarize_scope_times.sh averages cpu and off-cpu time");
+    }
+
+    static void test_summarize_script_reports_perf_counters() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' "
+            "'[ScopeTimer] fn | elapsed=2.000ms | instr=300 | cycles=200 | ipc=1.50 | cache-miss=4 | branch-miss=2 | ctx-sw=1 | page-faults=10' "
+            "'[ScopeTimer] fn | elapsed=4.000ms | instr=100 | cycles=200 | ipc=0.50 | cache-miss=6 | branch-miss=4 | ctx-sw=0 | page-faults=20' | "
+            + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
+
+        expect(output.find("avg=3.000ms") != std::string::npos,
+               "summarize_scope_times.sh reads elapsed ahead of perf counter fields");
+        expect(output.find("ipc=1.00  cache-miss avg=5  branch-miss avg=3") != std::string::npos,
+               "summarize_scope_times.sh reports aggregate ipc and average misses");
+        expect(output.find("ctx-sw avg=0.5  page-faults avg=15.0") != std::string::npos,
+               "summarize_scope_times.sh averages software counter deltas");
+    }
+
+    static void test_summarize_script_reports_resource_usage() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' "
+            "'[ScopeTimer] fn | elapsed=2.000ms | minflt=10 | majflt=0 | nvcsw=1 | nivcsw=0' "
+            "'[ScopeTimer] fn | elapsed=4.000ms | minflt=30 | majflt=1 | nvcsw=3 | nivcsw=2' | "
+            + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
+
+        expect(output.find("minflt avg=20.0  majflt avg=0.5  nvcsw avg=2.0  nivcsw avg=1.0") != std::string::npos,
+               "summarize_scope_times.sh averages resource usage deltas");
+    }
+
+    static void test_summarize_script_reports_allocations() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' "
+            "'[ScopeTimer] fn | elapsed=2.000ms | allocs=3 | alloc-bytes=300' "
+            "'[ScopeTimer] fn | elapsed=4.000ms | allocs=6 | alloc-bytes=900' | "
+            + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
+
+        expect(output.find("allocs avg=4.5  alloc-bytes avg=600") != std::string::npos,
+               "summarize_scope_times.sh averages allocation counts");
+    }
+
+    static void test_summarize_script_reports_suspended_time() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' "
+            "'[ScopeTimer] fn | elapsed=10.000ms | active=2.000ms | suspended=8.000ms | migrations=1' "
+            "'[ScopeTimer] fn | elapsed=20.000ms | active=4.000ms | suspended=16.000ms | migrations=0' | "
+            + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
 
-        SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(0U);
-        {
-            SCOPE_TIMER("tests:public_sink:buffered_zero");
-            busyFor(25us);
-        }
-        SCOPE_TIMER_DISABLE_THREAD_BUFFERED_SINK();
+        expect(output.find("active avg=3.000ms  suspended avg=12.000ms  migrations avg=0.5") != std::string::npos,
+               "summarize_scope_times.sh averages active and suspended time");
+    }
 
-        SCOPE_TIMER_ENABLE_ASYNC_SINK(0U);
-        {
-            SCOPE_TIMER("tests:public_sink:async_zero");
-            busyFor(25us);
-        }
-        SCOPE_TIMER_DISABLE_ASYNC_SINK();
-        ::xyzzy::scopetimer::ScopeTimer::resetLogSink();
+    static void test_summarize_script_reports_laps() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' "
+            "'[ScopeTimer] fn | elapsed=10.000ms | lap:parse=2.000ms | lap:decode=6.000ms' "
+            "'[ScopeTimer] fn | elapsed=20.000ms | lap:parse=4.000ms | lap:decode=14.000ms' | "
+            + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
 
-        expect(sinkCaptureBuffer().find("tests:public_sink:buffered_zero") != std::string::npos,
-               "thread-buffered sink accepts zero flush threshold by using the default");
-        expect(sinkCaptureBuffer().find("tests:public_sink:async_zero") != std::string::npos,
-               "async sink accepts zero flush threshold by using the default");
+        expect(output.find("laps avg: parse=3.000ms decode=10.000ms") != std::string::npos,
+               "summarize_scope_times.sh averages each lap by name");
     }
 
-    static void test_long_log_line_truncates_but_still_emits() {
-        sinkCaptureBuffer().clear();
-        ::xyzzy::scopetimer::ScopeTimer::setLogSinkForTests(&testSinkWrite, &testSinkFlush);
-        const std::string longLabel(700, 'L');
-        {
-            ::xyzzy::scopetimer::ScopeTimer timer("tests:long_label_scope", longLabel);
-            busyFor(20us);
-        }
-        ::xyzzy::scopetimer::ScopeTimer::setLogSinkForTests(nullptr, nullptr);
+    static void test_summarize_script_reports_loop_iterations() {
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
+        const std::string cmd =
+            "printf '%s\\n' "
+            "'[ScopeTimer] fn | elapsed=10.000ms | iterations=100 | iter-mean=100.000us | sampled=10 | iter-p99=300.000us' "
+            "'[ScopeTimer] fn | elapsed=30.000ms | iterations=300 | iter-mean=100.000us | sampled=30 | iter-p99=900.000us' | "
+            + shellEscape(script);
+        const std::string output = runShellCommandCapture(cmd);
 
-        expect(!sinkCaptureBuffer().empty(), "overlong log line still emits output");
-        expect(sinkCaptureBuffer().find(std::string(32, 'L')) != std::string::npos,
-               "overlong log line preserves the leading label prefix");
-        expect(sinkCaptureBuffer().find('\0') == std::string::npos,
-               "overlong log line remains plain text");
+        expect(output.find("iterations avg=200  iter-mean avg=100us  iter-p99 max=900us") != std::string::npos,
+               "summarize_scope_times.sh reports loop iteration summaries");
     }
 
-    static void test_summarize_script_handles_nanos() {
+    static void test_summarize_script_reports_suppressed_calls() {
         const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/summarize_scope_times.sh";
         const std::string cmd =
-            "printf '%s\\n' '[ScopeTimer] fn | elapsed=500ns' | " + shellEscape(script);
+            "printf '%s\\n' "
+            "'[ScopeTimer] fn | elapsed=2.000ms' "
+            "'[ScopeTimer] fn | elapsed=4.000ms | suppressed=9' | "
+            + shellEscape(script);
         const std::string output = runShellCommandCapture(cmd);
 
-        expect(output.find("count=1") != std::string::npos,
-               "summarize_scope_times.sh counts nanosecond entries");
-        expect(output.find("500ns") != std::string::npos,
-               "summarize_scope_times.sh preserves nanosecond formatting");
+        expect(output.find("suppressed total=9  calls=11") != std::string::npos,
+               "summarize_scope_times.sh adds suppressed calls back into the call count");
     }
 
     static void test_default_sink_write_short_circuits() {
@@ -879,6 +2106,85 @@ private:
         ::xyzzy::scopetimer::ScopeTimer::setBufferedSinkTargetForTests(nullptr);
     }
 
+    static std::string readFileContents(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::string content;
+        if (in) {
+            content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        return content;
+    }
+
+    static void test_per_thread_file_sink_writes_one_file_per_thread() {
+        char templ[] = "/tmp/scopetimer_per_threadXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        if (!tdir) {
+            expect(false, "per-thread file sink test created a temp directory");
+            return;
+        }
+        const std::string tmpdir(tdir);
+        ::xyzzy::scopetimer::ScopeTimer::setLogSinkForTests(nullptr, nullptr);
+        ::xyzzy::scopetimer::ScopeTimer::resetLogDirectoryForTests(tmpdir);
+        ::xyzzy::scopetimer::ScopeTimer::closeLogFdForTests();
+
+        SCOPE_TIMER_ENABLE_PER_THREAD_FILE_SINK(64U * 1024U);
+        {
+            SCOPE_TIMER("tests:per_thread:main_first");
+        }
+        std::thread worker([] {
+            SCOPE_TIMER("tests:per_thread:worker");
+            busyFor(2000us);
+        });
+        worker.join();
+        busyFor(5000us); // wall stamps have millisecond resolution
+        {
+            SCOPE_TIMER("tests:per_thread:main_last");
+        }
+        SCOPE_TIMER_DISABLE_PER_THREAD_FILE_SINK();
+
+        std::vector<std::string> files;
+        if (DIR* dir = ::opendir(tmpdir.c_str())) {
+            while (const dirent* entry = ::readdir(dir)) {
+                const std::string name = entry->d_name;
+                if (name.rfind("ScopeTimer.", 0) == 0) {
+                    files.push_back(name);
+                }
+            }
+            ::closedir(dir);
+        }
+        std::sort(files.begin(), files.end());
+
+        const std::string prefix = "ScopeTimer." + std::to_string(::getpid()) + ".";
+        expect(files.size() == 2U, "per-thread file sink writes one file per thread and no shared log");
+        std::string mainContent;
+        std::string workerContent;
+        for (const auto& name : files) {
+            expect(name.rfind(prefix, 0) == 0 && name.size() > 4U && name.compare(name.size() - 4U, 4U, ".log") == 0,
+                   "per-thread log files are named ScopeTimer.<pid>.<tid>.log");
+            const std::string content = readFileContents(tmpdir + "/" + name);
+            (content.find("tests:per_thread:worker") != std::string::npos ? workerContent : mainContent) = content;
+        }
+        expect(mainContent.find("tests:per_thread:main_first") != std::string::npos
+                   && mainContent.find("tests:per_thread:main_last") != std::string::npos
+                   && mainContent.find("tests:per_thread:worker") == std::string::npos,
+               "per-thread file keeps only its own thread's records");
+
+        const std::string script = std::string(SCOPETIMER_SOURCE_DIR) + "/scripts/merge_scope_logs.py";
+        const std::string merged = runShellCommandCapture("python3 " + shellEscape(script) + " " + shellEscape(tmpdir));
+        const auto first = merged.find("tests:per_thread:main_first");
+        const auto middle = merged.find("tests:per_thread:worker");
+        const auto last = merged.find("tests:per_thread:main_last");
+        expect(first != std::string::npos && middle != std::string::npos && last != std::string::npos
+                   && first < middle && middle < last,
+               "merge_scope_logs.py interleaves per-thread files by end timestamp");
+
+        for (const auto& name : files) {
+            std::remove((tmpdir + "/" + name).c_str());
+        }
+        ::rmdir(tmpdir.c_str());
+        ::xyzzy::scopetimer::ScopeTimer::resetLogDirectoryForTests("/tmp");
+    }
+
     static void test_async_sink_flushes_on_disable() {
         char templ[] = "/tmp/scopetimer_async_disableXXXXXX";
         char* tdir = ::mkdtemp(templ);
@@ -1240,9 +2546,14 @@ private:
 
     static void test_log_line_builders_handle_zero_buffers() {
         char ignored = 'x';
-        ::xyzzy::scopetimer::ScopeTimer::LogLineFields fields{
-            "label", 1001U, "where", "start", "end", "1us", true
-        };
+        ::xyzzy::scopetimer::ScopeTimer::LogLineFields fields;
+        fields.label = "label";
+        fields.threadNum = 1001U;
+        fields.where = "where";
+        fields.startWall = "start";
+        fields.endWall = "end";
+        fields.elapsed = "1us";
+        fields.wallTimeEnabled = true;
         std::size_t len = ::xyzzy::scopetimer::ScopeTimer::buildLogLine(&ignored, 0U, fields);
         expect(len == 0U, "buildLogLine returns zero for empty output buffers");
 
@@ -1254,6 +2565,73 @@ private:
         expect(len == 0U, "formatTime returns zero for empty output buffers");
     }
 
+    static void test_timestamp_modes_format_utc_and_epoch() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        char buf[40] = {};
+        std::size_t len = ScopeTimer::fmtUtcMicros(1'700'000'000'123'456'789LL, buf, sizeof(buf));
+        expect(std::string_view(buf, len) == "2023-11-14T22:13:20.123456Z", "UTC micros renders ISO-8601 with a Z suffix");
+        len = ScopeTimer::fmtUtcNanos(951'782'400'000'000'007LL, buf, sizeof(buf));
+        expect(std::string_view(buf, len) == "2000-02-29T00:00:00.000000007Z", "UTC nanos handles leap days");
+        len = ScopeTimer::fmtUtcNanos(-1LL, buf, sizeof(buf));
+        expect(std::string_view(buf, len) == "1969-12-31T23:59:59.999999999Z", "UTC rounds pre-epoch times toward the past");
+        len = ScopeTimer::fmtEpochNanos(1'700'000'000'123'456'789LL, buf, sizeof(buf));
+        expect(std::string_view(buf, len) == "1700000000123456789", "epoch mode prints raw nanoseconds");
+        len = ScopeTimer::fmtLocalTime(1'700'000'000'123'456'789LL, buf, sizeof(buf));
+        expect(len == 23U && std::string_view(buf, len).substr(19) == ".123", "local mode keeps milliseconds");
+
+        len = ScopeTimer::fmtUtcMicros(0, buf, 10U);
+        expect(len == 0U && buf[0] == '\0', "UTC formatting leaves an empty string when the buffer is too small");
+
+        expect(ScopeTimer::timestampFormatterFromSetting(nullptr) == &ScopeTimer::fmtLocalTime
+                   && ScopeTimer::timestampFormatterFromSetting(" utc ") == &ScopeTimer::fmtUtcMicros
+                   && ScopeTimer::timestampFormatterFromSetting("UTC_NANOS") == &ScopeTimer::fmtUtcNanos
+                   && ScopeTimer::timestampFormatterFromSetting("epoch") == &ScopeTimer::fmtEpochNanos
+                   && ScopeTimer::timestampFormatterFromSetting("bogus") == &ScopeTimer::fmtLocalTime,
+               "SCOPE_TIMER_TIMESTAMP values select their formatter");
+    }
+
+    static void test_compact_log_line_drops_field_names() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        static constexpr ScopeTimer::CallSite site{"void work()", "/src/app/Worker.cpp", 42U};
+        ScopeTimer::LogLineFields fields;
+        fields.label = "work";
+        fields.threadNum = 7U;
+        fields.where = "void work()";
+        fields.wallTimeEnabled = true;
+        fields.correlationId = 9U;
+        char line[128] = {};
+        std::size_t len = ScopeTimer::buildCompactLogLine(line, sizeof(line), fields, &site, 1'700'000'000'000'000'123LL, 1500LL);
+        expect(std::string_view(line, len) == "work\t7\tWorker.cpp:42\t1700000000000000123\t1500 | corr=9\n",
+               "compact line is tab-separated with a file:line callsite and integer nanoseconds");
+
+        fields.wallTimeEnabled = false;
+        fields.correlationId = 0U;
+        len = ScopeTimer::buildCompactLogLine(line, sizeof(line), fields, nullptr, 0, 1500LL);
+        expect(std::string_view(line, len) == "work\t7\tvoid work()\t-\t1500\n",
+               "compact line falls back to the signature and marks a missing start");
+    }
+
+    static void test_short_function_names_trim_signatures() {
+        using ::xyzzy::scopetimer::detail::shortFunctionName;
+        static_assert(shortFunctionName("int exampleFunction()") == "exampleFunction");
+        static_assert(shortFunctionName("static std::vector<int> ns::Pool::make(const std::string&)") == "ns::Pool::make");
+        static_assert(shortFunctionName("T ns::Box<T>::get(int) const [with T = std::map<int, int>]") == "ns::Box<T>::get");
+        static_assert(shortFunctionName("bool ns::S::operator()(int)") == "ns::S::operator()");
+        static_assert(shortFunctionName("bool ns::operator<(const A&, const A&)") == "ns::operator<");
+        static_assert(shortFunctionName("ns::S::operator bool() const") == "ns::S::operator bool");
+        static_assert(shortFunctionName("void (anonymous namespace)::run()") == "(anonymous namespace)::run");
+        static_assert(shortFunctionName("main()::<lambda()>") == "main");
+        static_assert(shortFunctionName("handler") == "handler");
+
+        SCOPE_TIMER_CALLSITE_(shortNameTest);
+        constexpr std::string_view expectedTail = "test_short_function_names_trim_signatures";
+        const std::string_view shortWhere = scopeTimerSite__shortNameTest.shortWhere;
+        expect(shortWhere.size() >= expectedTail.size()
+                   && shortWhere.substr(shortWhere.size() - expectedTail.size()) == expectedTail
+                   && shortWhere.find_first_of("( ") == std::string_view::npos,
+               "callsite macros carry the compile-time short function name");
+    }
+
     static void test_sink_write_helpers_ignore_empty_payloads() {
         ::xyzzy::scopetimer::ScopeTimer::threadBufferedSinkWrite("", 0U);
         ::xyzzy::scopetimer::ScopeTimer::asyncSinkWrite("", 0U);
@@ -1382,6 +2760,12 @@ private:
             busyFor(20000us);
             return 0;
         }
+        if (mode == "sampler_exit") {
+            for (int i = 0; i < 10; ++i) {
+                SCOPE_TIMER_EVERY_N(4, "tests:sampled:exit_tail"); // admits calls 1, 5 and 9
+            }
+            return 0;
+        }
         if (mode == "buffered_exit") {
             SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(64U * 1024U);
             {
@@ -1398,6 +2782,117 @@ private:
             }
             return 0;
         }
+        if (mode == "crash_buffered") {
+            SCOPE_TIMER_INSTALL_CRASH_FLUSH();
+            SCOPE_TIMER_ENABLE_THREAD_BUFFERED_SINK(64U * 1024U);
+            {
+                SCOPE_TIMER("tests:crash:buffered");
+            }
+            std::abort();
+        }
+        if (mode == "crash_async_chained") {
+            // A pre-existing handler must still run after the emergency flush.
+            std::signal(SIGTERM, [](int) { std::_Exit(7); });
+            SCOPE_TIMER_INSTALL_CRASH_FLUSH();
+            SCOPE_TIMER_ENABLE_ASYNC_SINK(64U * 1024U);
+            std::thread worker([] {
+                SCOPE_TIMER("tests:crash:async_worker");
+            });
+            worker.join();
+            {
+                SCOPE_TIMER("tests:crash:async_main");
+            }
+            std::raise(SIGTERM);
+            return 0;
+        }
+        if (mode == "fork_async") {
+            SCOPE_TIMER_ENABLE_ASYNC_SINK(4096U);
+            {
+                SCOPE_TIMER("tests:fork:before");
+            }
+            // Keep another thread logging across the fork so the hooks see live locks.
+            std::atomic<bool> stop{false};
+            std::thread background([&stop] {
+                while (!stop.load(std::memory_order_relaxed)) {
+                    SCOPE_TIMER("tests:fork:background");
+                    busyFor(50us);
+                }
+            });
+            busyFor(2000us);
+            const pid_t pid = ::fork();
+            if (pid == 0) {
+                {
+                    SCOPE_TIMER("tests:fork:child");
+                }
+                // exit() skips the inherited, now-threadless std::thread and drains via atexit.
+                std::exit(0);
+            }
+            stop.store(true, std::memory_order_relaxed);
+            background.join();
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+            {
+                SCOPE_TIMER("tests:fork:parent");
+            }
+            SCOPE_TIMER_DISABLE_ASYNC_SINK();
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                std::exit(3);
+            }
+            return 0;
+        }
+        if (mode == "cpu_time") {
+            {
+                SCOPE_TIMER("tests:cpu_time:busy");
+                // busyFor() sleeps; spin so the scope actually burns CPU.
+                const auto until = std::chrono::steady_clock::now() + 20ms;
+                volatile std::uint64_t spins = 0U;
+                while (std::chrono::steady_clock::now() < until) {
+                    spins = spins + 1U;
+                }
+            }
+            {
+                SCOPE_TIMER("tests:cpu_time:sleep");
+                std::this_thread::sleep_for(20ms);
+            }
+            return 0;
+        }
+        if (mode == "perf_counters") {
+            SCOPE_TIMER("tests:perf_counters");
+            // Fresh pages fault on first touch.
+            std::vector<char> pages(8U * 1024U * 1024U);
+            for (std::size_t i = 0U; i < pages.size(); i += 4096U) {
+                pages[i] = 1;
+            }
+            return pages[4096U] == 1 ? 0 : 1;
+        }
+        if (mode == "rusage") {
+            {
+                SCOPE_TIMER_RUSAGE("tests:rusage:touch");
+                std::vector<char> pages(8U * 1024U * 1024U);
+                for (std::size_t i = 0U; i < pages.size(); i += 4096U) {
+                    pages[i] = 1;
+                }
+                std::this_thread::sleep_for(1ms);
+            }
+            {
+                SCOPE_TIMER("tests:rusage:plain");
+            }
+            return 0;
+        }
+        if (mode == "allocations") {
+            {
+                SCOPE_TIMER("tests:allocations:ten");
+                std::vector<std::unique_ptr<std::array<char, 1000>>> blocks;
+                blocks.reserve(10U);
+                for (int i = 0; i < 10; ++i) {
+                    blocks.push_back(std::make_unique<std::array<char, 1000>>());
+                }
+            }
+            {
+                SCOPE_TIMER("tests:allocations:none");
+            }
+            return 0;
+        }
         if (mode == "walltime_off") {
             SCOPE_TIMER("tests:walltime:off");
             busyFor(100us);
@@ -1495,6 +2990,102 @@ private:
         }
     }
 
+    static void test_crash_flush_writes_buffered_records_on_abort() {
+        char templ[] = "/tmp/scopetimer_crashXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "crash_buffered"},
+            {"SCOPE_TIMER_DIR", tmpdir}
+        });
+        expect(rc != 0, "crash-flush child still dies from SIGABRT");
+        expect(readFileContents(logfile).find("tests:crash:buffered") != std::string::npos,
+               "crash flush writes thread-buffered records before the process dies");
+        struct stat info {};
+        expect(::stat(logfile.c_str(), &info) == 0 && (info.st_mode & 0077) == 0,
+               "crash flush creates the log readable by its owner only");
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
+    static void test_crash_flush_chains_previous_handler() {
+        char templ[] = "/tmp/scopetimer_crash_chainXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "crash_async_chained"},
+            {"SCOPE_TIMER_DIR", tmpdir}
+        });
+        expect(WIFEXITED(rc) && WEXITSTATUS(rc) == 7, "crash flush re-raises into the previous handler");
+        const std::string content = readFileContents(logfile);
+        expect(content.find("tests:crash:async_worker") != std::string::npos
+                   && content.find("tests:crash:async_main") != std::string::npos,
+               "crash flush writes async-mode records from every thread");
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
+    static void test_crash_flush_sees_queued_async_batches_without_locking() {
+        using ::xyzzy::scopetimer::ScopeTimer;
+        ScopeTimer::AsyncSinkBatch batch;
+        batch.data.assign({'q', 'u', 'e', 'u', 'e', 'd'});
+        batch.size = batch.data.size();
+        ScopeTimer::publishCrashAsyncBatch(batch);
+        expect(batch.crashSlot >= 0, "queued async batch claims a crash slot");
+        if (batch.crashSlot < 0) {
+            return;
+        }
+        const auto& slot = ScopeTimer::crashAsyncSlots_[static_cast<std::size_t>(batch.crashSlot)];
+        expect(slot.data.load() == batch.data.data() && slot.size.load() == batch.size,
+               "crash slot publishes the queued batch bytes");
+        ScopeTimer::retireCrashAsyncBatch(batch);
+        expect(slot.data.load() == nullptr && batch.crashSlot == -1,
+               "written async batch is withdrawn from the crash handler");
+    }
+
+    static void test_async_sink_survives_fork() {
+        char templ[] = "/tmp/scopetimer_forkXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "fork_async"},
+            {"SCOPE_TIMER_DIR", tmpdir}
+        });
+        expect(rc == 0, "forked async-sink child and parent both exit cleanly");
+
+        const std::string content = readFileContents(logfile);
+        const auto occurrences = [&content](const std::string& needle) {
+            std::size_t count = 0U;
+            for (auto pos = content.find(needle); pos != std::string::npos; pos = content.find(needle, pos + 1U)) {
+                ++count;
+            }
+            return count;
+        };
+        expect(occurrences("tests:fork:before") == 1U, "records queued before fork are written once, not duplicated");
+        expect(occurrences("tests:fork:child") == 1U, "forked child restarts the async sink and logs");
+        expect(occurrences("tests:fork:parent") == 1U, "parent keeps logging after fork");
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
     static void test_async_sink_flushes_on_process_exit() {
         char templ[] = "/tmp/scopetimer_asyncXXXXXX";
         char* tdir = ::mkdtemp(templ);
@@ -1556,6 +3147,223 @@ private:
         }
     }
 
+    static void test_cpu_time_splits_on_and_off_cpu() {
+        char templ[] = "/tmp/scopetimer_cpuXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "cpu_time"},
+            {"SCOPE_TIMER_DIR", tmpdir},
+            {"SCOPE_TIMER_CPU_TIME", "1"},
+            {"SCOPE_TIMER_FORMAT", "MILLIS"}
+        });
+        expect(rc == 0, "cpu-time child process exited cleanly");
+
+        std::string busyLine;
+        std::string sleepLine;
+        std::ifstream in(logfile);
+        for (std::string line; std::getline(in, line);) {
+            if (line.find("tests:cpu_time:busy") != std::string::npos) busyLine = line;
+            if (line.find("tests:cpu_time:sleep") != std::string::npos) sleepLine = line;
+        }
+        expect(busyLine.find(" | elapsed=") < busyLine.find(" | cpu=")
+                   && busyLine.find(" | cpu=") < busyLine.find(" | offcpu="),
+               "cpu and offcpu fields follow elapsed");
+        expect(parseMillisField(busyLine, "| cpu=") >= 10.0,
+               "busy scope reports most of its elapsed time as cpu");
+        expect(parseMillisField(sleepLine, "| cpu=") >= 0.0 && parseMillisField(sleepLine, "| cpu=") < 5.0
+                   && parseMillisField(sleepLine, "offcpu=") >= 15.0,
+               "sleeping scope reports its elapsed time as offcpu");
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
+    static void test_log_line_formats_perf_counters() {
+        ::xyzzy::scopetimer::ScopeTimer::PerfCounts perf;
+        perf.hardware = true;
+        perf.instructions = 2500U;
+        perf.cycles = 1000U;
+        perf.cacheMisses = 7U;
+        perf.branchMisses = 3U;
+        perf.contextSwitches = 1U;
+        perf.pageFaults = 2U;
+        ::xyzzy::scopetimer::ScopeTimer::LogLineFields fields;
+        fields.label = "label";
+        fields.threadNum = 1U;
+        fields.where = "where";
+        fields.elapsed = "1us";
+        fields.perf = &perf;
+        char line[256];
+        std::size_t len = ::xyzzy::scopetimer::ScopeTimer::buildLogLine(line, sizeof(line), fields);
+        expect(std::string_view(line, len) ==
+                   "[label] TID=001 | where | elapsed=1us | instr=2500 | cycles=1000 | ipc=2.50"
+                   " | cache-miss=7 | branch-miss=3 | ctx-sw=1 | page-faults=2\n",
+               "hardware perf counters render after elapsed with ipc");
+
+        perf = ::xyzzy::scopetimer::ScopeTimer::PerfCounts{};
+        perf.pageFaults = 5U;
+        len = ::xyzzy::scopetimer::ScopeTimer::buildLogLine(line, sizeof(line), fields);
+        expect(std::string_view(line, len) == "[label] TID=001 | where | elapsed=1us | ctx-sw=0 | page-faults=5\n",
+               "software-only perf counters omit the hardware fields");
+    }
+
+    static void test_perf_counters_report_page_faults() {
+        char templ[] = "/tmp/scopetimer_perfXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "perf_counters"},
+            {"SCOPE_TIMER_DIR", tmpdir},
+            {"SCOPE_TIMER_PERF_COUNTERS", "1"}
+        });
+        expect(rc == 0, "perf-counter child process exited cleanly");
+
+        const std::string content = readFileContents(logfile);
+        ::xyzzy::scopetimer::ScopeTimer::PerfCounts available;
+        if (!::xyzzy::scopetimer::ScopeTimer::readPerfCounters(available)) {
+            // perf_event_open is unavailable here (non-Linux, seccomp): lines stay plain.
+            expect(content.find("tests:perf_counters") != std::string::npos
+                       && content.find("page-faults=") == std::string::npos,
+                   "timers without perf support omit counter fields");
+        } else {
+            const std::size_t pos = content.find("page-faults=");
+            const unsigned long faults = pos == std::string::npos ? 0UL : std::strtoul(content.c_str() + pos + 12U, nullptr, 10);
+            expect(content.find(" | elapsed=") < content.find(" | ctx-sw="),
+                   "perf counter fields follow elapsed");
+            expect(faults >= 1000UL, "scope touching 8 MiB of fresh memory reports its page faults");
+        }
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
+    static void test_rusage_timer_reports_faults_and_switches() {
+        char templ[] = "/tmp/scopetimer_rusageXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "rusage"},
+            {"SCOPE_TIMER_DIR", tmpdir}
+        });
+        expect(rc == 0, "rusage child process exited cleanly");
+
+        std::string touchLine;
+        std::string plainLine;
+        std::ifstream in(logfile);
+        for (std::string line; std::getline(in, line);) {
+            if (line.find("tests:rusage:touch") != std::string::npos) touchLine = line;
+            if (line.find("tests:rusage:plain") != std::string::npos) plainLine = line;
+        }
+        expect(!plainLine.empty() && plainLine.find("minflt=") == std::string::npos,
+               "plain timers do not read resource usage");
+
+        ::xyzzy::scopetimer::ScopeTimer::ResourceUsage probe;
+        if (!::xyzzy::scopetimer::ScopeTimer::readResourceUsage(probe)) {
+            expect(!touchLine.empty() && touchLine.find("minflt=") == std::string::npos,
+                   "SCOPE_TIMER_RUSAGE without RUSAGE_THREAD omits the fields");
+        } else {
+            const std::size_t pos = touchLine.find("| minflt=");
+            const unsigned long minflt = pos == std::string::npos ? 0UL : std::strtoul(touchLine.c_str() + pos + 9U, nullptr, 10);
+            expect(touchLine.find(" | elapsed=") < pos && touchLine.find("| nvcsw=") != std::string::npos,
+                   "resource usage fields follow elapsed");
+            expect(minflt >= 1000UL, "SCOPE_TIMER_RUSAGE reports the minor faults of touching 8 MiB");
+            expect(touchLine.find("| nvcsw=0") == std::string::npos,
+                   "SCOPE_TIMER_RUSAGE counts the voluntary switch of a sleep");
+        }
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
+    static void test_allocation_hooks_count_scope_allocations() {
+        char templ[] = "/tmp/scopetimer_allocXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "allocations"},
+            {"SCOPE_TIMER_DIR", tmpdir}
+        });
+        expect(rc == 0, "allocation child process exited cleanly");
+
+        std::string tenLine;
+        std::string noneLine;
+        std::ifstream in(logfile);
+        for (std::string line; std::getline(in, line);) {
+            if (line.find("tests:allocations:ten") != std::string::npos) tenLine = line;
+            if (line.find("tests:allocations:none") != std::string::npos) noneLine = line;
+        }
+        if (!::xyzzy::scopetimer::ScopeTimer::allocationTrackingEnabled()) {
+            // Built without src/ScopeTimerAllocHooks.cpp.
+            expect(!tenLine.empty() && tenLine.find("allocs=") == std::string::npos,
+                   "records omit allocation counts without the hooks");
+        } else {
+            const std::size_t pos = tenLine.find("| allocs=");
+            const unsigned long allocs = pos == std::string::npos ? 0UL : std::strtoul(tenLine.c_str() + pos + 9U, nullptr, 10);
+            const std::size_t bytesPos = tenLine.find("| alloc-bytes=");
+            const unsigned long bytes = bytesPos == std::string::npos ? 0UL : std::strtoul(tenLine.c_str() + bytesPos + 14U, nullptr, 10);
+            expect(allocs == 11UL && bytes >= 10000UL,
+                   "scope reports its ten blocks plus the vector buffer");
+            expect(noneLine.find("| allocs=0 | alloc-bytes=0") != std::string::npos,
+                   "scope without allocations reports zero");
+        }
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
+    static void test_sampler_tail_is_reported_at_exit() {
+        char templ[] = "/tmp/scopetimer_samplerXXXXXX";
+        char* tdir = ::mkdtemp(templ);
+        std::string tmpdir = tdir ? std::string(tdir) : std::string("/tmp");
+        const std::string logfile = tmpdir + "/ScopeTimer.log";
+        std::remove(logfile.c_str());
+
+        const int rc = run_child_with_env({
+            {"SCOPETIMER_PROBE", "sampler_exit"},
+            {"SCOPE_TIMER_DIR", tmpdir}
+        });
+        expect(rc == 0, "sampler child process exited cleanly");
+
+        int records = 0;
+        std::string tailLine;
+        std::ifstream in(logfile);
+        for (std::string line; std::getline(in, line);) {
+            if (line.find("[tests:sampled:exit_tail]") != std::string::npos) ++records;
+            if (line.rfind("[sampler] ", 0) == 0) tailLine = line;
+        }
+        expect(records == 3, "1-in-4 sampler admits three of ten calls");
+        expect(tailLine.find("ScopeTimerTest.cpp:") != std::string::npos
+                   && tailLine.find("child_probe_main_if_requested") != std::string::npos
+                   && tailLine.find(" | suppressed=1") != std::string::npos,
+               "the call skipped after the last record is reported at exit");
+
+        std::remove(logfile.c_str());
+        if (tdir) {
+            ::rmdir(tmpdir.c_str());
+        }
+    }
+
     static void test_disabled_case_insensitivity_child_process() {
         const char* variants[] = {"off", "Off", "FALSE", "False", "nO", " off ", "\tFALSE\t"};
         for (const char* variant : variants) {
@@ -1666,6 +3474,7 @@ private:
 
     // --------- bootstrapping helpers ---------
     static void init_exe_path(int argc, char** argv) {
+        (void)argc;
         if (argv && argv[0]) {
             char buf[4096];
             if (::realpath(argv[0], buf)) s_exe_path = buf; else s_exe_path = argv[0];